@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BleAdvertisingBackend.h"
+
+#if defined(CONFIG_ARDUHAL_ESP_LOG)
+  #include "esp32-hal-log.h"
+  #define LOG_TAG ""
+#else
+  #include "esp_log.h"
+  static const char* LOG_TAG = "BLEDevice";
+#endif
+
+BleAdvertisingBackend::BleAdvertisingBackend(BLEAdvertising* advertising) : advertising(advertising) {
+}
+
+void BleAdvertisingBackend::rememberPeer(const esp_bd_addr_t addr){
+  memcpy(this->lastPeer, addr, sizeof(esp_bd_addr_t));
+  this->hasLastPeer = true;
+}
+
+// Looks up the host to aim directed advertising at: the last peer we saw if it is still bonded,
+// otherwise the most recently stored bond. Resolvable private addresses are swapped for the
+// identity address from the bond keys.
+bool BleAdvertisingBackend::findBondedPeer(esp_bd_addr_t addr, esp_ble_addr_type_t* type){
+  esp_ble_bond_dev_t* list = this->bonds;
+  int count = BLE_MAX_BONDS;
+  if (esp_ble_get_bond_device_num() <= 0 || esp_ble_get_bond_device_list(&count, list) != ESP_OK || count <= 0){
+    return false;
+  }
+
+  int match = count - 1;
+  if (this->hasLastPeer){
+    for (int i = 0; i < count; i++){
+      if (memcmp(list[i].bd_addr, this->lastPeer, sizeof(esp_bd_addr_t)) == 0){
+        match = i;
+        break;
+      }
+    }
+  }
+  if (list[match].bond_key.key_mask & ESP_BLE_ID_KEY_MASK){
+    memcpy(addr, list[match].bond_key.pid_key.static_addr, sizeof(esp_bd_addr_t));
+    *type = list[match].bond_key.pid_key.addr_type;
+  } else {
+    memcpy(addr, list[match].bd_addr, sizeof(esp_bd_addr_t));
+    *type = BLE_ADDR_TYPE_PUBLIC;
+  }
+  return true;
+}
+
+bool BleAdvertisingBackend::startDirected(){
+  esp_ble_adv_params_t params = {};
+  if (!this->findBondedPeer(params.peer_addr, &params.peer_addr_type)){
+    return false;
+  }
+  params.adv_int_min = RECONNECT_FAST_INTERVAL_MIN; // Ignored by the controller for high duty cycle
+  params.adv_int_max = RECONNECT_FAST_INTERVAL_MIN;
+  params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+  params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+  params.channel_map = ADV_CHNL_ALL;
+  params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
+  if (esp_ble_gap_start_advertising(&params) != ESP_OK){
+    ESP_LOGW(LOG_TAG, "Directed advertising failed");
+    return false;
+  }
+  return true;
+}
+
+void BleAdvertisingBackend::startUndirected(uint16_t minInterval, uint16_t maxInterval){
+  this->advertising->setMinInterval(minInterval);
+  this->advertising->setMaxInterval(maxInterval);
+  this->advertising->start();
+}
+
+void BleAdvertisingBackend::stop(){
+  esp_ble_gap_stop_advertising();
+}
@@ -0,0 +1,34 @@
+#ifndef ESP32_BLE_ADVERTISING_BACKEND_H
+#define ESP32_BLE_ADVERTISING_BACKEND_H
+#include "sdkconfig.h"
+#include "HidTransport.h"
+#if defined(CONFIG_BT_ENABLED) && defined(BLE_TRANSPORT_BLUEDROID)
+
+#include <BLEServer.h>
+#include "esp_gap_ble_api.h"
+#include "ReconnectManager.h"
+
+#if defined(CONFIG_BT_SMP_MAX_BONDS)
+#define BLE_MAX_BONDS CONFIG_BT_SMP_MAX_BONDS
+#else
+#define BLE_MAX_BONDS 15 //The stack's default bond limit
+#endif
+
+class BleAdvertisingBackend : public AdvertisingBackend
+{
+public:
+  BleAdvertisingBackend(BLEAdvertising* advertising);
+  bool startDirected();
+  void startUndirected(uint16_t minInterval, uint16_t maxInterval);
+  void stop();
+  void rememberPeer(const esp_bd_addr_t addr);
+private:
+  bool findBondedPeer(esp_bd_addr_t addr, esp_ble_addr_type_t* type);
+  BLEAdvertising* advertising;
+  esp_bd_addr_t lastPeer = {};
+  esp_ble_bond_dev_t bonds[BLE_MAX_BONDS]; // Bond list buffer, kept off the heap
+  bool hasLastPeer = false;
+};
+
+#endif // CONFIG_BT_ENABLED && BLE_TRANSPORT_BLUEDROID
+#endif // ESP32_BLE_ADVERTISING_BACKEND_H
@@ -1,30 +1,92 @@
+#include <arduino.h>
+
 #include "BleConnectionStatus.h"
 
-BleConnectionStatus::BleConnectionStatus(void) {
+void CccdState::attach(HidTransport* transport, uint8_t handle)
+{
+  this->transport = transport;
+  this->handle = handle;
 }
 
-void BleConnectionStatus::onConnect(BLEServer* pServer)
+void CccdState::written(bool enabled)
 {
-  this->connected = true;
-  BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
+  if (enabled && !this->subscribed){
+    this->resubscribed = true;
+  }
+  this->subscribed = enabled;
+  this->bondedValue = enabled;
+}
 
-  desc = (BLE2902*)this->inputMediaKeys->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
+void CccdState::connected(bool bonded)
+{
+  if (bonded && this->bondedValue){
+    this->transport->setSubscribed(this->handle, true);
+    this->subscribed = true;
+    this->resubscribed = true;
+  }
+}
 
-  desc = (BLE2902*)this->inputRadial->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(true);
-  
+void CccdState::disconnected(void)
+{
+  this->transport->setSubscribed(this->handle, false);
+  this->subscribed = false;
+  this->resubscribed = false;
+}
 
+// True once after every unsubscribed -> subscribed transition
+bool CccdState::takeResubscribed(void)
+{
+  if (!this->resubscribed){
+    return false;
+  }
+  this->resubscribed = false;
+  return this->subscribed;
 }
 
-void BleConnectionStatus::onDisconnect(BLEServer* pServer)
+void BleConnectionStatus::addCccd(uint8_t handle, CccdState* state)
+{
+  if (this->cccdCount < BLE_MAX_CCCD){
+    this->cccdHandle[this->cccdCount] = handle;
+    this->cccd[this->cccdCount++] = state;
+  }
+}
+
+// intervalUs is 0 when the stack didn't say
+void BleConnectionStatus::onConnect(bool bonded, uint32_t intervalUs)
+{
+  this->connected = true;
+  if (intervalUs != 0){
+    this->intervalUs = intervalUs;
+  }
+  for (int i = 0; i < this->cccdCount; i++){
+    this->cccd[i]->connected(bonded);
+  }
+
+  if (this->reconnectManager != nullptr){
+    this->reconnectManager->onConnected(millis());
+  }
+}
+
+void BleConnectionStatus::onDisconnect(void)
 {
   this->connected = false;
-  BLE2902* desc = (BLE2902*)this->inputKeyboard->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(false);
+  this->congested = false;
+  this->mtu = BLE_DEFAULT_MTU;
+  for (int i = 0; i < this->cccdCount; i++){
+    this->cccd[i]->disconnected();
+  }
 
-  desc = (BLE2902*)this->inputMediaKeys->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-  desc->setNotifications(false);
+  if (this->reconnectManager != nullptr){
+    this->reconnectManager->onDisconnected(millis());
+  }
+}
 
+// Writes to CCCDs the status doesn't track, such as vendor characteristics', are ignored
+void BleConnectionStatus::onSubscribe(uint8_t handle, bool enabled)
+{
+  for (int i = 0; i < this->cccdCount; i++){
+    if (this->cccdHandle[i] == handle){
+      this->cccd[i]->written(enabled);
+    }
+  }
 }
@@ -3,22 +3,50 @@
 #include "sdkconfig.h"
 #if defined(CONFIG_BT_ENABLED)
 
-#include <BLEServer.h>
-#include "BLE2902.h"
-#include "BLECharacteristic.h"
+#include "HidTransport.h"
+#include "ReconnectManager.h"
 
-class BleConnectionStatus : public BLEServerCallbacks
+// Subscription state of one input report, driven by the host's writes to its CCCD (0x2902).
+// Bonded hosts expect the CCCD to survive a reconnect, so the last written value is restored
+// for them; any other host starts unsubscribed until it writes the descriptor.
+class CccdState
+{
+public:
+  void attach(HidTransport* transport, uint8_t handle);
+  void written(bool enabled);
+  void connected(bool bonded);
+  void disconnected(void);
+  bool takeResubscribed(void);
+  volatile bool subscribed = false;
+private:
+  HidTransport* transport = nullptr;
+  uint8_t handle = TRANSPORT_NO_HANDLE;
+  volatile bool resubscribed = false;
+  bool bondedValue = true;
+};
+
+#define BLE_MAX_CCCD 8
+#define BLE_DEFAULT_INTERVAL_US 15000 //Assumed connection interval until the host sets one
+#define BLE_DEFAULT_MTU 23 //ATT MTU until the host exchanges a larger one
+#define BLE_MAX_MTU 517 //Largest ATT MTU we offer; the host picks what it actually uses
+
+// State of the link to the host, kept up to date by the transport from the stack's task
+class BleConnectionStatus
 {
 public:
-  BleConnectionStatus(void);
   bool connected = false;
-  void onConnect(BLEServer* pServer);
-  void onDisconnect(BLEServer* pServer);
-  BLECharacteristic* inputKeyboard;
-  BLECharacteristic* outputKeyboard;
-  BLECharacteristic* inputMediaKeys;
-  BLECharacteristic* inputRadial;
-  BLECharacteristic* outputRadial;
+  void onConnect(bool bonded, uint32_t intervalUs);
+  void onDisconnect(void);
+  void onSubscribe(uint8_t handle, bool enabled);
+  void addCccd(uint8_t handle, CccdState* state);
+  volatile uint32_t intervalUs = BLE_DEFAULT_INTERVAL_US; // Current connection interval
+  volatile bool congested = false; // The stack's transmit buffers are full
+  volatile uint16_t mtu = BLE_DEFAULT_MTU; // Current ATT MTU
+  ReconnectManager* reconnectManager = nullptr;
+private:
+  CccdState* cccd[BLE_MAX_CCCD];
+  uint8_t cccdHandle[BLE_MAX_CCCD];
+  int cccdCount = 0;
 };
 
 #endif // CONFIG_BT_ENABLED
@@ -1,10 +1,3 @@
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEServer.h>
-#include "BLE2902.h"
-#include "BLEHIDDevice.h"
-#include "HIDTypes.h"
-#include <driver/adc.h>
 #include "sdkconfig.h"
 
 #include <arduino.h>
@@ -12,327 +5,109 @@
 #include "BleConnectionStatus.h"
 #include "KeyboardOutputCallbacks.h"
 #include "BleKeyboard.h"
+#include "TypingEngine.h"
 
-#if defined(CONFIG_ARDUHAL_ESP_LOG)
-  #include "esp32-hal-log.h"
-  #define LOG_TAG ""
-#else
-  #include "esp_log.h"
-  static const char* LOG_TAG = "BLEDevice";
-#endif
-
-
-// Report IDs:
-#define KEYBOARD_ID 0x01
-#define MEDIA_KEYS_ID 0x02
-#define RADIAL_ID 0x03
-#define RADIAL_HAPTIC_ID 0x04
-
-static const uint8_t _hidReportDescriptor[] = {
-  USAGE_PAGE(1),      0x01,          // USAGE_PAGE (Generic Desktop Ctrls)
-  USAGE(1),           0x06,          // USAGE (Keyboard)
-  COLLECTION(1),      0x01,          // COLLECTION (Application)
-  // ------------------------------------------------- Keyboard
-  REPORT_ID(1),       KEYBOARD_ID,   //   REPORT_ID (1)
-  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0xE0,          //   USAGE_MINIMUM (0xE0)
-  USAGE_MAXIMUM(1),   0xE7,          //   USAGE_MAXIMUM (0xE7)
-  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
-  LOGICAL_MAXIMUM(1), 0x01,          //   Logical Maximum (1)
-  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
-  REPORT_COUNT(1),    0x08,          //   REPORT_COUNT (8)
-  HIDINPUT(1),        0x02,          //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x01,          //   REPORT_COUNT (1) ; 1 byte (Reserved)
-  REPORT_SIZE(1),     0x08,          //   REPORT_SIZE (8)
-  HIDINPUT(1),        0x01,          //   INPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  REPORT_COUNT(1),    0x05,          //   REPORT_COUNT (5) ; 5 bits (Num lock, Caps lock, Scroll lock, Compose, Kana)
-  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
-  USAGE_PAGE(1),      0x08,          //   USAGE_PAGE (LEDs)
-  USAGE_MINIMUM(1),   0x01,          //   USAGE_MINIMUM (0x01) ; Num Lock
-  USAGE_MAXIMUM(1),   0x05,          //   USAGE_MAXIMUM (0x05) ; Kana
-  HIDOUTPUT(1),       0x02,          //   OUTPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x01,          //   REPORT_COUNT (1) ; 3 bits (Padding)
-  REPORT_SIZE(1),     0x03,          //   REPORT_SIZE (3)
-  HIDOUTPUT(1),       0x01,          //   OUTPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-  REPORT_COUNT(1),    0x06,          //   REPORT_COUNT (6) ; 6 bytes (Keys)
-  REPORT_SIZE(1),     0x08,          //   REPORT_SIZE(8)
-  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM(0)
-  LOGICAL_MAXIMUM(1), 0x65,          //   LOGICAL_MAXIMUM(0x65) ; 101 keys
-  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
-  USAGE_MINIMUM(1),   0x00,          //   USAGE_MINIMUM (0)
-  USAGE_MAXIMUM(1),   0x65,          //   USAGE_MAXIMUM (0x65)
-  HIDINPUT(1),        0x00,          //   INPUT (Data,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  END_COLLECTION(0),                 // END_COLLECTION
-  // ------------------------------------------------- Media Keys
-  USAGE_PAGE(1),      0x0C,          // USAGE_PAGE (Consumer)
-  USAGE(1),           0x01,          // USAGE (Consumer Control)
-  COLLECTION(1),      0x01,          // COLLECTION (Application)
-  REPORT_ID(1),       MEDIA_KEYS_ID, //   REPORT_ID (3)
-  USAGE_PAGE(1),      0x0C,          //   USAGE_PAGE (Consumer)
-  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
-  LOGICAL_MAXIMUM(1), 0x01,          //   LOGICAL_MAXIMUM (1)
-  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
-  REPORT_COUNT(1),    0x10,          //   REPORT_COUNT (16)
-  USAGE(1),           0xB5,          //   USAGE (Scan Next Track)     ; bit 0: 1
-  USAGE(1),           0xB6,          //   USAGE (Scan Previous Track) ; bit 1: 2
-  USAGE(1),           0xB7,          //   USAGE (Stop)                ; bit 2: 4
-  USAGE(1),           0xCD,          //   USAGE (Play/Pause)          ; bit 3: 8
-  USAGE(1),           0xE2,          //   USAGE (Mute)                ; bit 4: 16
-  USAGE(1),           0xE9,          //   USAGE (Volume Increment)    ; bit 5: 32
-  USAGE(1),           0xEA,          //   USAGE (Volume Decrement)    ; bit 6: 64
-  USAGE(2),           0x23, 0x02,    //   Usage (WWW Home)            ; bit 7: 128
-  USAGE(2),           0x94, 0x01,    //   Usage (My Computer) ; bit 0: 1
-  USAGE(2),           0x92, 0x01,    //   Usage (Calculator)  ; bit 1: 2
-  USAGE(2),           0x2A, 0x02,    //   Usage (WWW fav)     ; bit 2: 4
-  USAGE(2),           0x21, 0x02,    //   Usage (WWW search)  ; bit 3: 8
-  USAGE(2),           0x26, 0x02,    //   Usage (WWW stop)    ; bit 4: 16
-  USAGE(2),           0x24, 0x02,    //   Usage (WWW back)    ; bit 5: 32
-  USAGE(2),           0x83, 0x01,    //   Usage (Media sel)   ; bit 6: 64
-  USAGE(2),           0x8A, 0x01,    //   Usage (Mail)        ; bit 7: 128
-  HIDINPUT(1),        0x02,          //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-  END_COLLECTION(0),                  // END_COLLECTION
-   
- 0x05, 0x01,                    // Usage Page (Generic Desktop)        0
- 0x09, 0x0e,                    // Usage (System Multi-Axis Controller) 2
- 0xa1, 0x01,                    // Collection (Application)            4
- 0x85, RADIAL_ID,                    //  Report ID (1)                      6
- 0x05, 0x0d,                    //  Usage Page (Digitizers)            8
- 0x09, 0x21,                    //  Usage (Puck)                       10
-
- 0xa1, 0x02,                    //  Collection (Logical)               12
- 0x15, 0x00,                    //   Logical Minimum (0)               14
- 0x25, 0x01,                    //   Logical Maximum (1)               16
- 0x75, 0x01,                    //   Report Size (1)                   18
- 0x95, 0x01,                    //   Report Count (1)                  20
- 0xa1, 0x00,                    //   Collection (Physical)             22
- 0x05, 0x09,                    //    Usage Page (Button)              24
- 0x09, 0x01,                    //    Usage (Vendor Usage 0x01)        26
- 0x81, 0x02,                    //    Input (Data,Var,Abs)             28
- 0x05, 0x0d,                    //    Usage Page (Digitizers)          30
- 0x09, 0x33,                    //    Usage (Touch)                    32
- 0x81, 0x02,                    //    Input (Data,Var,Abs)             34
- 0x95, 0x06,                    //    Report Count (6)                 36
- 0x81, 0x03,                    //    Input (Cnst,Var,Abs)             38
- 0xa1, 0x02,                    //    Collection (Logical)             40
- 0x05, 0x01,                    //     Usage Page (Generic Desktop)    42
- 0x09, 0x37,                    //     Usage (Dial)                    44
- 0x16, 0x01, 0x80,              //     Logical Minimum (-32767)        46
- 0x26, 0xff, 0x7f,              //     Logical Maximum (32767)         49
- 0x75, 0x10,                    //     Report Size (16)                52
- 0x95, 0x01,                    //     Report Count (1)                54
- 0x81, 0x06,                    //     Input (Data,Var,Rel)            56
- 0x35, 0x00,                    //     Physical Minimum (0)            58
- 0x46, 0x10, 0x0e,              //     Physical Maximum (3600)         60
- 0x15, 0x00,                    //     Logical Minimum (0)             63
- 0x26, 0x10, 0x0e,              //     Logical Maximum (3600)          65
- 0x09, 0x48,                    //     Usage (Resolution Multiplier)   68
- 0xb1, 0x02,                    //     Feature (Data,Var,Abs)          70
- 0x45, 0x00,                    //     Physical Maximum (0)            72
- 0xc0,                          //    End Collection                   74
- 
- 0x55, 0x0e,                    //    Unit Exponent (-2)               75
- 0x65, 0x11,                    //    Unit (Centimeter,SILinear)       77
- 0x46, 0x00, 0x00,              //    Physical Maximum (0)             79
- 0x26, 0x00, 0x00,              //    Logical Maximum (0)              82
- 0x09, 0x30,                    //    Usage (X)                        85
- 0x81, 0x42,                    //    Input (Data,Var,Abs,Null)        87
- 0x09, 0x31,                    //    Usage (Y)                        89
- 0x46, 0x00, 0x00,              //    Physical Maximum (0)             91
- 0x26, 0x00, 0x00,              //    Logical Maximum (0)              94
- 0x81, 0x42,                    //    Input (Data,Var,Abs,Null)        97
- 0x05, 0x0d,                    //    Usage Page (Digitizers)          99
- 0x09, 0x48,                    //    Usage (Width)                    101
- 0x15, 0x3a,                    //    Logical Minimum (58)             103
- 0x25, 0x3a,                    //    Logical Maximum (58)             105
- 0x75, 0x08,                    //    Report Size (8)                  107
- 0x55, 0x0f,                    //    Unit Exponent (-1)               109
- 0x35, 0x3a,                    //    Physical Minimum (58)            111
- 0x45, 0x3a,                    //    Physical Maximum (58)            113
- 0x81, 0x03,                    //    Input (Cnst,Var,Abs)             115
- 0x55, 0x00,                    //    Unit Exponent (0)                117
- 0x65, 0x00,                    //    Unit (None)                      119
- 0x35, 0x00,                    //    Physical Minimum (0)             121
- 0x45, 0x00,                    //    Physical Maximum (0)             123
-
- 0x05, 0x0e,                    //    Usage Page (Haptic)              125
- 0x09, 0x01,                    //    Usage (Simple Haptic Controller) 127
- 0xa1, 0x02,                    //    Collection (Logical)             129
- 0x15, 0x00,                    //     Logical Minimum (0)             131
- 0x26, 0xff, 0x00,              //     Logical Maximum (255)           133
- 0x09, 0x24,                    //     Usage (Repeat Count)            136
- 0xb1, 0x42,                    //     Feature (Data,Var,Abs,Null)     138
- 0x09, 0x24,                    //     Usage (Repeat Count)            140
- 0x91, 0x42,                    //     Output (Data,Var,Abs,Null)      142
- 0x15, 0x01,                    //     Logical Minimum (1)             144
- 0x25, 0x07,                    //     Logical Maximum (7)             146
- 0x09, 0x20,                    //     Usage (Auto Trigger)            148
- 0xb1, 0x42,                    //     Feature (Data,Var,Abs,Null)     150
- 0x09, 0x21,                    //     Usage (Manual Trigger)          152
- 0x91, 0x42,                    //     Output (Data,Var,Abs,Null)      154
- 0x25, 0x0a,                    //     Logical Maximum (10)            156
- 0x09, 0x28,                    //     Usage (Waveform Cutoff Time)    158
- 0xb1, 0x42,                    //     Feature (Data,Var,Abs,Null)     160
- 0x75, 0x10,                    //     Report Size (16)                162
- 0x26, 0xd0, 0x07,              //     Logical Maximum (2000)          164
- 0x09, 0x25,                    //     Usage (Retrigger Period)        167
- 0xb1, 0x42,                    //     Feature (Data,Var,Abs,Null)     169
- 0x09, 0x25,                    //     Usage (Retrigger Period)        171
- 0x91, 0x42,                    //     Output (Data,Var,Abs,Null)      173
- 0x85, RADIAL_HAPTIC_ID,                    //     Report ID (2)                   175
- 0x75, 0x20,                    //     Report Size (32)                177
- 0x17, 0x37, 0x00, 0x01, 0x00,  //     Logical Minimum (65591)         179
- 0x27, 0x37, 0x00, 0x01, 0x00,  //     Logical Maximum (65591)         184
- 0x09, 0x22,                    //     Usage (Auto Trigger Associated Control) 189
- 0xb1, 0x02,                    //     Feature (Data,Var,Abs)          191
- 0x09, 0x11,                    //     Usage (Duration)                193
- 0xa1, 0x02,                    //     Collection (Logical)            195
- 0x05, 0x0a,                    //      Usage Page (Ordinals)          197
- 0x95, 0x03,                    //      Report Count (3)               199
- 0x09, 0x03,                    //      Usage (Vendor Usage 0x03)      201
- 0x09, 0x04,                    //      Usage (Vendor Usage 0x04)      203
- 0x09, 0x05,                    //      Usage (Vendor Usage 0x05)      205
- 0x75, 0x08,                    //      Report Size (8)                207
- 0x15, 0x00,                    //      Logical Minimum (0)            209
- 0x25, 0xff,                    //      Logical Maximum (255)          211
- 0xb1, 0x02,                    //      Feature (Data,Var,Abs)         213
- 0xc0,                          //     End Collection                  215
- 0x05, 0x0e,                    //     Usage Page (Haptic)             216
- 0x09, 0x10,                    //     Usage (Waveform)                218
- 0xa1, 0x02,                    //     Collection (Logical)            220
- 0x05, 0x0a,                    //      Usage Page (Ordinals)          222
- 0x95, 0x01,                    //      Report Count (1)               224
- 0x15, 0x03,                    //      Logical Minimum (3)            226
- 0x25, 0x03,                    //      Logical Maximum (3)            228
- 0x36, 0x03, 0x10,              //      Physical Minimum (4099)        230
- 0x46, 0x03, 0x10,              //      Physical Maximum (4099)        233
- 0x09, 0x03,                    //      Usage (Vendor Usage 0x03)      236
- 0xb1, 0x02,                    //      Feature (Data,Var,Abs)         238
- 0x15, 0x04,                    //      Logical Minimum (4)            240
- 0x25, 0x04,                    //      Logical Maximum (4)            242
- 0x36, 0x04, 0x10,              //      Physical Minimum (4100)        244
- 0x46, 0x04, 0x10,              //      Physical Maximum (4100)        247
- 0x09, 0x04,                    //      Usage (Vendor Usage 0x04)      250
- 0xb1, 0x02,                    //      Feature (Data,Var,Abs)         252
- 0x15, 0x05,                    //      Logical Minimum (5)            254
- 0x25, 0x05,                    //      Logical Maximum (5)            256
- 0x36, 0x04, 0x10,              //      Physical Minimum (4100)        258
- 0x46, 0x04, 0x10,              //      Physical Maximum (4100)        261
- 0x09, 0x05,                    //      Usage (Vendor Usage 0x05)      264
- 0xb1, 0x02,                    //      Feature (Data,Var,Abs)         266
- 0x35, 0x00,                    //      Physical Minimum (0)           268
- 0x45, 0x00,                    //      Physical Maximum (0)           270
- 0xc0,                          //     End Collection                  272
- 0xc0,                          //    End Collection                   273
- 0xc0,                          //   End Collection                    274
- 0xc0,                          //  End Collection                     275
- 0xc0,                          // End Collection                      276
-  
-};
-
-BleKeyboard::BleKeyboard(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel) : hid(0)
+BleKeyboard::BleKeyboard(HidTransport* transport, std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel) : transport(transport), featureCallback(this), wheelCallback(this), reconnectManager(0), _keyReport(), _mediaKeyReport(), _radialReport()
 {
   this->deviceName = deviceName;
   this->deviceManufacturer = deviceManufacturer;
   this->batteryLevel = batteryLevel;
-  this->connectionStatus = new BleConnectionStatus();
 }
 
 void BleKeyboard::begin(void)
 {
-  BLEDevice::init(this->deviceName);
-  this->pServer = BLEDevice::createServer();
-  this->pServer->setCallbacks(this->connectionStatus);
-
-  this->hid = new BLEHIDDevice(this->pServer);
-  this->inputKeyboard = this->hid->inputReport(KEYBOARD_ID); // <-- input REPORTID from report map
-  this->outputKeyboard = this->hid->outputReport(KEYBOARD_ID);
-  this->inputMediaKeys = this->hid->inputReport(MEDIA_KEYS_ID);
-  this->inputRadial = this->hid->inputReport(RADIAL_ID);
-  this->outputRadial = this->hid->outputReport(RADIAL_ID);
-  this->featureRadial = this->hid->featureReport(RADIAL_ID);
-  
-  
-  
-  
-  this->connectionStatus->inputKeyboard = this->inputKeyboard;
-  this->connectionStatus->outputKeyboard = this->outputKeyboard;
-  this->connectionStatus->inputMediaKeys = this->inputMediaKeys;
-  this->connectionStatus->inputRadial = this->inputRadial;
-  
-  this->featureRadial->setCallbacks(new radialFeatureHapticCallback(this));
+  HidDeviceInfo info = {this->deviceName.c_str(), this->deviceManufacturer.c_str(),
+                        BleKeyboardChannels::descriptor::data, BleKeyboardChannels::descriptor::size,
+                        0xe502, 0xa111, 0x0210, this->batteryLevel};
+  this->transport->begin(info, &this->connectionStatus);
+  this->channels.create(this->transport);
+  this->channels.attach(&this->connectionStatus);
+  this->transport->start();
 
-  this->outputKeyboard->setCallbacks(new KeyboardOutputCallbacks());
+  // Fixed values from the descriptor, for hosts that read the haptic feature report
+  RadialHapticFeatureReport haptic = {0x00010037, {0, 0, 0}, {3, 4, 5}};
+  this->channels.get<RadialHapticFeatureReport>().setValue(&haptic);
 
-  this->hid->manufacturer()->setValue(this->deviceManufacturer);
+  this->channels.get<RadialFeatureReport>().setWriter(&this->featureCallback);
 
-  this->hid->pnp(0x02, 0xe502, 0xa111, 0x0210);
-  this->hid->hidInfo(0x00,0x01);
+  WheelFeatureReport wheelFeature = {};
+  this->channels.get<WheelFeatureReport>().setValue(&wheelFeature);
+  this->channels.get<WheelFeatureReport>().setWriter(&this->wheelCallback);
 
-  BLESecurity *pSecurity = new BLESecurity();
+  this->channels.get<KeyboardLedReport>().setWriter(&this->ledCallback);
 
-  pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+  this->onStarted(this->transport);
 
-  this->hid->reportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
-  this->hid->startServices();
+  this->reconnectManager = this->reconnectSlot.create(this->transport->advertising());
+  this->connectionStatus.reconnectManager = this->reconnectManager;
+  this->reconnectManager->start(millis());
+  //this->transport->setBatteryLevel(this->batteryLevel);
+}
 
+void BleKeyboard::end(void)
+{
+}
 
-  this->onStarted(this->pServer);
-  
-  BLEAdvertising *pAdvertising = this->pServer->getAdvertising();
-  pAdvertising->setAppearance(HID_KEYBOARD);
-  pAdvertising->addServiceUUID(this->hid->hidService()->getUUID());
-  pAdvertising->start();
-  //this->hid->setBatteryLevel(this->batteryLevel);
+// Advances the advertising schedule and resends state to newly subscribed reports; call from loop()
+void BleKeyboard::update(void)
+{
+  if (this->reconnectManager != nullptr)
+    this->reconnectManager->update(millis());
+  this->sendSnapshot();
+  this->sendWheel();
+  this->channels.pump();
 }
 
-void BleKeyboard::end(void)
+// Reports produced while a characteristic was unsubscribed are not queued. Instead, when the host
+// (re)subscribes it gets one report with the current state, so held keys and a held dial button
+// are not lost and nothing stays stuck on the host.
+void BleKeyboard::sendSnapshot(void)
 {
+  if (this->channels.get<KeyReport>().cccd.takeResubscribed())
+    this->sendReport(&_keyReport);
+  if (this->channels.get<MediaKeyReport>().cccd.takeResubscribed())
+    this->sendReport(&_mediaKeyReport);
+  if (this->channels.get<RadialReport>().cccd.takeResubscribed()){
+    _radialReport.rotation = 0;
+    this->sendReport(&_radialReport);
+  }
 }
 
-bool BleKeyboard::isConnected(void) {
-  return this->connectionStatus->connected;
+const ReconnectHistogram& BleKeyboard::reconnectStats(void) {
+  return this->reconnectManager->histogram();
 }
 
-void BleKeyboard::setBatteryLevel(uint8_t level) {
-  this->batteryLevel = level;
-  if (hid != 0)
-    this->hid->setBatteryLevel(this->batteryLevel);
+ReconnectPhase BleKeyboard::reconnectPhase(void) {
+  return this->reconnectManager != nullptr ? this->reconnectManager->phase() : RECONNECT_IDLE;
 }
 
+// Drops the current host, if any, and advertises for a new one for RECONNECT_PAIRING_MS
+void BleKeyboard::startPairing(void) {
+  if (this->reconnectManager == nullptr)
+    return;
+  this->reconnectManager->pair(millis());
+  this->transport->disconnect();
+}
 
-void BleKeyboard::sendReport(KeyReport* keys)
-{
-  if (this->isConnected())
-  {
-    this->inputKeyboard->setValue((uint8_t*)keys, sizeof(KeyReport));
-    this->inputKeyboard->notify();
-  }
+int BleKeyboard::bonds(void) {
+  return this->transport->bonds();
 }
 
-void BleKeyboard::sendReport(MediaKeyReport* keys)
-{
-  if (this->isConnected())
-  {
-    this->inputMediaKeys->setValue((uint8_t*)keys, sizeof(MediaKeyReport));
-    this->inputMediaKeys->notify();
-  }
+bool BleKeyboard::isConnected(void) {
+  return this->connectionStatus.connected;
 }
-void BleKeyboard::sendReport(RadialReport* keys)
-{
-  if (this->isConnected())
-  {
-    this->inputRadial->setValue((uint8_t*)keys, sizeof(RadialReport));
-    this->inputRadial->notify();
-  }
+
+uint16_t BleKeyboard::mtu(void) {
+  return this->connectionStatus.mtu;
 }
-void BleKeyboard::sendReport(RadialOutputReport* keys)
-{
-  if (this->isConnected())
-  {
-    this->outputRadial->setValue((uint8_t*)keys, sizeof(RadialOutputReport));
-    this->outputRadial->notify();
-  }
+
+void BleKeyboard::setBatteryLevel(uint8_t level) {
+  this->batteryLevel = level;
+  if (this->reconnectManager != nullptr)
+    this->transport->setBatteryLevel(this->batteryLevel);
 }
+
+
 extern
 const uint8_t _asciimap[128] PROGMEM;
 
@@ -605,19 +380,61 @@ size_t BleKeyboard::write(const MediaKeyReport c)
 	return p;              // just return the result of press() since release() almost always returns 1
 }
 
+// Types the text as one pipelined report stream (see TypingEngine) instead of a press and a
+// release per character. Keys already held through press() stay held.
 size_t BleKeyboard::write(const uint8_t *buffer, size_t size) {
-	size_t n = 0;
-	while (size--) {
-		if (*buffer != '\r') {
-			if (write(*buffer)) {
-			  n++;
-			} else {
-			  break;
+	TypingEngine typing(buffer, size);
+	uint8_t modifiers, usage;
+	int queued = 0;
+	size_t sent = 0;
+	while (typing.next(&modifiers, &usage)) {
+		KeyReport report = _keyReport;
+		report.modifiers |= modifiers;
+		for (uint8_t i = 0; usage != 0 && i < 6; i++) {
+			if (report.keys[i] == usage) break;
+			if (report.keys[i] == 0x00) {
+				report.keys[i] = usage;
+				break;
 			}
 		}
-		buffer++;
+		if (!sendPaced(&report, &queued)) {
+			sendReport(&_keyReport);
+			return sent;
+		}
+		sent = typing.typed();
+	}
+	if (typing.stopped()) {
+		setWriteError();
 	}
-	return n;
+	return sent;
+}
+
+// Sends one typing report. The stack only buffers a few notifications per connection event,
+// so after TYPING_REPORTS_PER_INTERVAL reports, or while earlier reports are still queued, wait
+// one connection interval before sending more. Typing never relies on the queue coalescing, so
+// no keystroke is merged away.
+bool BleKeyboard::sendPaced(KeyReport* report, int* queued)
+{
+	uint32_t waitMs = (this->connectionStatus.intervalUs + 999) / 1000;
+	for (int waits = 0; *queued >= TYPING_REPORTS_PER_INTERVAL || this->channels.pending() > 0; waits++) {
+		if (!this->channels.get<KeyReport>().cccd.subscribed || waits == TYPING_RETRY_LIMIT)
+			return false;
+		delay(waitMs);
+		*queued = 0;
+		this->channels.pump();
+	}
+	if (!this->channels.get<KeyReport>().cccd.subscribed)
+		return false;
+	sendReport(report);
+	(*queued)++;
+	return true;
+}
+
+// One connection interval, the soonest the stack can take another notification
+void BleKeyboard::waitForLink(void)
+{
+	delay((this->connectionStatus.intervalUs + 999) / 1000);
+	this->channels.pump();
 }
 
 bool BleKeyboard::dialPressed(){
@@ -625,13 +442,25 @@ bool BleKeyboard::dialPressed(){
 }
 void BleKeyboard::pressDial(){
   _radialReport.button = 3;
-  rotate(0);
+  rotateRadial(0);
 }
 void BleKeyboard::releaseDial(){
   _radialReport.button = 2;
-  rotate(0);
+  rotateRadial(0);
 }
+
+// In the wheel modes rotation only adds to the accumulator; update() sends it
 void BleKeyboard::rotate(int angle){
+  if (this->dial_output == DIAL_OUTPUT_WHEEL){
+    this->wheel_steps -= angle * (this->wheel_high_res ? WHEEL_RESOLUTION : 1); // Clockwise scrolls down
+  } else if (this->dial_output == DIAL_OUTPUT_PAN){
+    this->wheel_steps += angle * (this->pan_high_res ? WHEEL_RESOLUTION : 1);
+  } else {
+    rotateRadial(angle);
+  }
+}
+
+void BleKeyboard::rotateRadial(int angle){
   
   _radialReport.vala = 0x0A;
   _radialReport.valb = 0x0B;
@@ -646,14 +475,103 @@ void BleKeyboard::rotate(int angle){
   
 }
 
-void radialHapticCallback::onRead(BLECharacteristic* pCharacteristic){
-  ESP_LOGI(LOG_TAG, "I've been read!");
+// Notches from a dial mode, scaled by the host's resolution multiplier and sent with the
+// dial's own wheel reports
+void BleKeyboard::scroll(int notches){
+  this->scroll_units -= notches * (this->wheel_high_res ? WHEEL_RESOLUTION : 1); // Clockwise scrolls down
+}
+
+// Sends the whole notches accumulated for the wheel, at most once per connection interval and
+// not while the last wheel report is still queued, so reports never have to merge; whatever
+// doesn't go out carries over in the accumulators
+void BleKeyboard::sendWheel(void)
+{
+  if (micros() - this->wheel_sent_us < this->connectionStatus.intervalUs || this->channels.get<WheelReport>().pending())
+    return;
+  this->flushWheel();
+}
+
+// One report with as much of the accumulated notches as fits it
+void BleKeyboard::flushWheel(void)
+{
+  int32_t units = this->wheel_steps / WHEEL_STEPS_PER_NOTCH;
+  if (units == 0 && this->scroll_units == 0)
+    return;
+  if (units > 127) units = 127;
+  if (units < -127) units = -127;
+  this->wheel_steps -= units * WHEEL_STEPS_PER_NOTCH;
+  this->wheel_sent_us = micros();
+  WheelReport report = {};
+  if (this->dial_output == DIAL_OUTPUT_PAN){
+    report.pan = units;
+  } else {
+    report.wheel = units;
+  }
+  int32_t wheel = report.wheel + this->scroll_units;
+  if (wheel > 127) wheel = 127;
+  if (wheel < -127) wheel = -127;
+  this->scroll_units -= wheel - report.wheel;
+  report.wheel = wheel;
+  sendReport(&report);
+}
+
+// Whole notches still carried go out on the old axis first; less than a notch of it can't make
+// a report on the new one and is dropped
+void BleKeyboard::setDialOutput(DialOutput output){
+  if (output != this->dial_output){
+    while (this->wheel_steps / WHEEL_STEPS_PER_NOTCH != 0)
+      this->flushWheel();
+  }
+  this->dial_output = output;
+  this->wheel_steps = 0;
+  this->dial_pos = 0;
+}
+
+// Wheel units carried at one resolution, at the other
+static int32_t rescaleWheel(int32_t units, bool fromHighRes, bool toHighRes){
+  if (fromHighRes == toHighRes)
+    return units;
+  return toHighRes ? units * WHEEL_RESOLUTION : units / WHEEL_RESOLUTION;
+}
+
+// What is carried is converted to the new resolution, so a notch in progress still completes
+void BleKeyboard::applyWheelFeatureReport(const WheelFeatureReport* r){
+  bool wheelHighRes = r->wheel_multiplier != 0;
+  bool panHighRes = r->pan_multiplier != 0;
+  if (this->dial_output == DIAL_OUTPUT_PAN){
+    this->wheel_steps = rescaleWheel(this->wheel_steps, this->pan_high_res, panHighRes);
+  } else {
+    this->wheel_steps = rescaleWheel(this->wheel_steps, this->wheel_high_res, wheelHighRes);
+  }
+  this->scroll_units = rescaleWheel(this->scroll_units, this->wheel_high_res, wheelHighRes);
+  this->wheel_high_res = wheelHighRes;
+  this->pan_high_res = panHighRes;
+}
+
+// The host's resolution multiplier sets how many encoder steps make one rotation report
+// (below 100) or how far each report turns (above 100)
+void BleKeyboard::applyFeatureReport(const RadialFeatureReport* r){
+  this->dial_vibrate = r->enabled;
+  if (r->vibration_amount == 0){
+    this->dial_interval = 1;
+    this->dial_mult = 1;
+  }else if (r->vibration_amount < 100){
+    this->dial_interval = round(100.0 / (float)r->vibration_amount);
+    this->dial_mult = 1;
+  } else {
+    this->dial_interval = 1;
+    this->dial_mult = (float)r->vibration_amount / 100.0;
+  }
+  if (this->dial_interval < 2){
+    this->dial_vibrate = 0;
+  }
+  this->dial_pos = 0;
 }
-void radialHapticCallback::onWrite(BLECharacteristic* pCharacteristic){  
-  std::string buff = pCharacteristic->getValue();
+
+void radialHapticCallback::onWrite(const uint8_t* data, size_t len){
   Serial.print("Written data:");
-  for (int i = 0; i < buff.length(); i++){
-    Serial.print(buff[i], HEX);
+  for (size_t i = 0; i < len; i++){
+    Serial.print(data[i], HEX);
   }
   Serial.println();
 }
@@ -662,33 +580,33 @@ radialFeatureHapticCallback::radialFeatureHapticCallback(BleKeyboard *kbd){
   pKeyboardReference = kbd;
 }
 
-void radialFeatureHapticCallback::onWrite(BLECharacteristic* pCharacteristic){  
-  std::string buff = pCharacteristic->getValue();
-  RadialFeatureReport *r = (RadialFeatureReport*) buff.c_str();
-  
+void radialFeatureHapticCallback::onWrite(const uint8_t* data, size_t len){
+  RadialFeatureReport r;
+  if (len < sizeof(r)){
+    return;
+  }
+  memcpy(&r, data, sizeof(r));
+
   Serial.print("Feature report data:");
-  for (int i = buff.length() -1; i >= 0; i--){
-    Serial.print(buff[i], HEX);
+  for (int i = len - 1; i >= 0; i--){
+    Serial.print(data[i], HEX);
   }
   Serial.println();
-  
-  
-  pKeyboardReference->dial_vibrate = r->enabled;
-  if (r->vibration_amount == 0){
-    pKeyboardReference->dial_interval = 1;
-    pKeyboardReference->dial_mult = 1;
-  }else if (r->vibration_amount < 100){
-    pKeyboardReference->dial_interval = round(100.0 / (float)r->vibration_amount);
-    pKeyboardReference->dial_mult = 1;
-  } else {
-    pKeyboardReference->dial_interval = 1;
-    pKeyboardReference->dial_mult = (float)r->vibration_amount / 100.0;
-  }
-  if (pKeyboardReference->dial_interval < 2){
-    pKeyboardReference->dial_vibrate = 0;
-  }
-  pKeyboardReference->dial_pos = 0;
-  Serial.println(r->vibration_amount);
+
+  pKeyboardReference->applyFeatureReport(&r);
+  Serial.println(r.vibration_amount);
   Serial.println(pKeyboardReference->dial_interval);
   Serial.println(pKeyboardReference->dial_mult);
 }
+
+wheelFeatureCallback::wheelFeatureCallback(BleKeyboard *kbd){
+  pKeyboardReference = kbd;
+}
+
+void wheelFeatureCallback::onWrite(const uint8_t* data, size_t len){
+  WheelFeatureReport r;
+  if (len >= sizeof(r)){
+    memcpy(&r, data, sizeof(r));
+    pKeyboardReference->applyWheelFeatureReport(&r);
+  }
+}
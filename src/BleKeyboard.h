@@ -3,11 +3,29 @@
 #include "sdkconfig.h"
 #if defined(CONFIG_BT_ENABLED)
 
+#include <string>
+#include "HidTransport.h"
 #include "BleConnectionStatus.h"
-#include "BLEHIDDevice.h"
-#include "BLECharacteristic.h"
+#include "KeyboardOutputCallbacks.h"
+#include "ReconnectManager.h"
+#include "StaticSlot.h"
+#include "HidReports.h"
 #include "Print.h"
 
+#define TYPING_REPORTS_PER_INTERVAL 3 //Notifications queued per connection interval while typing
+#define TYPING_RETRY_LIMIT 50 //Connection intervals without progress before write() gives up
+#define REPORT_WAIT_LIMIT 20 //Connection intervals a report waits for room in its full queue
+#define WHEEL_STEPS_PER_NOTCH 4 //Dial steps that scroll one wheel notch
+
+// Where dial rotation goes. Apps without RadialController support still scroll with the wheel.
+enum DialOutput {
+  DIAL_OUTPUT_RADIAL, // Surface Dial
+  DIAL_OUTPUT_WHEEL,  // Vertical mouse wheel
+  DIAL_OUTPUT_PAN,    // Horizontal mouse wheel (AC Pan)
+  DIAL_OUTPUT_KEYS,   // Key taps, sent by InputPipeline (see DialKeys)
+  DIAL_OUTPUT_COUNT
+};
+
 
 const uint8_t KEY_LEFT_CTRL = 0x80;
 const uint8_t KEY_LEFT_SHIFT = 0x81;
@@ -57,10 +75,9 @@ const uint8_t KEY_F21 = 0xF8;
 const uint8_t KEY_F22 = 0xF9;
 const uint8_t KEY_F23 = 0xFA;
 const uint8_t KEY_F24 = 0xFB;
+const uint8_t KEY_DIAL_OUTPUT = 0xFE; // Cycles the dial output mode
 const uint8_t KEY_DIAL = 0xFF;
 
-typedef uint8_t MediaKeyReport[2];
-
 const MediaKeyReport KEY_MEDIA_NEXT_TRACK = {1, 0};
 const MediaKeyReport KEY_MEDIA_PREVIOUS_TRACK = {2, 0};
 const MediaKeyReport KEY_MEDIA_STOP = {4, 0};
@@ -79,71 +96,69 @@ const MediaKeyReport KEY_MEDIA_CONSUMER_CONTROL_CONFIGURATION = {0, 64}; // Medi
 const MediaKeyReport KEY_MEDIA_EMAIL_READER = {0, 128};
 
 
-//  Low level key report: up to 6 keys and shift, ctrl etc at once
-typedef struct
-{
-  uint8_t modifiers;
-  uint8_t reserved;
-  uint8_t keys[6];
-} KeyReport;
-
-
-// Report for the Surface Dial wheel
-typedef struct RadialReport
-{
-    uint8_t button : 8;
-    uint16_t rotation : 16;
-    uint8_t vala : 8;
-    uint8_t valb : 8;
-    uint8_t valc : 8;
-    uint8_t vald : 8;
-    uint8_t vale : 8;
-
-} __attribute__((packed));
-
-typedef struct RadialFeatureReport {
-  uint16_t vibration_amount : 16;
-  uint8_t blank : 8;
-  uint8_t enabled : 1;
-  uint8_t flags : 7;
-  
-} __attribute__((packed));
+class BleKeyboard;
 
-typedef struct
-{
-    uint16_t autotrigger = 0x1001;
-    uint32_t autotriggerasc = 0x00010037;
-    uint16_t manualtrigger = 0x1001;
-    uint16_t extrabytes = 0;
-    uint16_t extrabytes2 = 0;
+class radialHapticCallback: public TransportWriter{
+  void onWrite(const uint8_t* data, size_t len);
+};
+class radialFeatureHapticCallback: public TransportWriter{
+  BleKeyboard *pKeyboardReference;
 
-} RadialOutputReport;
+  void onWrite(const uint8_t* data, size_t len);
+  public:
+    radialFeatureHapticCallback(BleKeyboard *kbd);
+};
+class wheelFeatureCallback: public TransportWriter{
+  BleKeyboard *pKeyboardReference;
 
+  void onWrite(const uint8_t* data, size_t len);
+  public:
+    wheelFeatureCallback(BleKeyboard *kbd);
+};
 
 class BleKeyboard : public Print
 {
 private:
-  BleConnectionStatus* connectionStatus;
-  BLEHIDDevice* hid;
-  BLECharacteristic* inputKeyboard;
-  BLECharacteristic* outputKeyboard;
-  BLECharacteristic* inputMediaKeys;
-  BLECharacteristic* inputRadial;
-  BLECharacteristic* featureRadial;
-  BLECharacteristic* outputRadial;
+  // Everything begin() sets up lives in the keyboard object itself, none of it on the heap
+  HidTransport* transport;
+  BleConnectionStatus connectionStatus;
+  radialFeatureHapticCallback featureCallback;
+  wheelFeatureCallback wheelCallback;
+  KeyboardOutputCallbacks ledCallback;
+  StaticSlot<ReconnectManager> reconnectSlot;
+  ReconnectManager* reconnectManager;
+  BleKeyboardChannels channels;
   KeyReport _keyReport;
   MediaKeyReport _mediaKeyReport;
   RadialReport _radialReport;
+  void sendSnapshot(void);
+  bool sendPaced(KeyReport* report, int* queued);
+  void waitForLink(void);
+  void sendWheel(void);
+  void flushWheel(void);
+  int32_t wheel_steps = 0; // Scaled dial steps not yet sent, carried between reports
+  int32_t scroll_units = 0; // Wheel units from scroll() not yet sent
+  uint32_t wheel_sent_us = 0;
+  bool wheel_high_res = false;
+  bool pan_high_res = false;
   
 public:
-  BLEServer *pServer;
-  BleKeyboard(std::string deviceName = "ESP32 BLE Keyboard", std::string deviceManufacturer = "Espressif", uint8_t batteryLevel = 100);
+  BleKeyboard(HidTransport* transport, std::string deviceName = "ESP32 BLE Keyboard", std::string deviceManufacturer = "Espressif", uint8_t batteryLevel = 100);
   void begin(void);
   void end(void);
-  void sendReport(KeyReport* keys);
-  void sendReport(MediaKeyReport* keys);
-  void sendReport(RadialReport* keys);
-  void sendReport(RadialOutputReport* keys);
+  void update(void);
+  const ReconnectHistogram& reconnectStats(void);
+  ReconnectPhase reconnectPhase(void);
+  void startPairing(void);
+  int bonds(void);
+  // While the report's queue is full it waits for the link rather than overwrite a state the
+  // host hasn't seen; after REPORT_WAIT_LIMIT intervals it overwrites the newest waiting report
+  template<typename Report>
+  void sendReport(Report* keys) {
+    for (int waits = 0; !this->channels.send(keys, waits == REPORT_WAIT_LIMIT); waits++)
+      this->waitForLink();
+  }
+  const HidQueueStats& queueStats(void) { return this->channels.stats(); }
   size_t press(uint8_t k);
   size_t press(const MediaKeyReport k);
   size_t release(uint8_t k);
@@ -153,6 +168,7 @@ public:
   size_t write(const uint8_t *buffer, size_t size);
   void releaseAll(void);
   bool isConnected(void);
+  uint16_t mtu(void);
   void setBatteryLevel(uint8_t level);
   uint8_t batteryLevel;
   std::string deviceManufacturer;
@@ -160,26 +176,19 @@ public:
   void pressDial();
   void releaseDial();
   void rotate(int angle);
+  void rotateRadial(int angle); // Surface Dial, whatever dial_output is
+  void scroll(int notches);     // Vertical wheel, whatever dial_output is
   bool dialPressed();
+  void applyFeatureReport(const RadialFeatureReport* r);
+  void applyWheelFeatureReport(const WheelFeatureReport* r);
+  void setDialOutput(DialOutput output);
+  DialOutput dial_output = DIAL_OUTPUT_RADIAL;
   int dial_vibrate = 0;
   int dial_interval = 10;
   float dial_mult = 1;
   int dial_pos = 0;
 protected:
-  virtual void onStarted(BLEServer *pServer) { };
-};
-
-
-class radialHapticCallback: public BLECharacteristicCallbacks{
-  void onRead(BLECharacteristic* pCharacteristic);    
-  void onWrite(BLECharacteristic* pCharacteristic);    
-};
-class radialFeatureHapticCallback: public BLECharacteristicCallbacks{
-  BleKeyboard *pKeyboardReference;
-  
-  void onWrite(BLECharacteristic* pCharacteristic);    
-  public:
-    radialFeatureHapticCallback(BleKeyboard *kbd);
+  virtual void onStarted(HidTransport* transport) { };
 };
 
 #endif // CONFIG_BT_ENABLED
@@ -0,0 +1,30 @@
+#ifndef ESP32_BLE_VALUE_VIEW_H
+#define ESP32_BLE_VALUE_VIEW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "BLECharacteristic.h"
+
+// A characteristic's value where the stack keeps it, without the std::string copy getValue()
+// makes. Only valid until the next write to the characteristic, so parse it inside onWrite.
+struct BleValueView {
+  const uint8_t* data;
+  size_t length;
+
+  BleValueView(BLECharacteristic* characteristic)
+    : data(characteristic->getData()), length(characteristic->getLength()) {}
+
+  // Copies the value into a report struct, which also takes care of alignment; false when the
+  // value is too short to hold one
+  template<typename T>
+  bool read(T* out) const {
+    if (this->length < sizeof(T)){
+      return false;
+    }
+    memcpy(out, this->data, sizeof(T));
+    return true;
+  }
+};
+
+#endif // ESP32_BLE_VALUE_VIEW_H
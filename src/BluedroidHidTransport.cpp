@@ -0,0 +1,243 @@
+#include <arduino.h>
+
+#include "BluedroidHidTransport.h"
+#if defined(CONFIG_BT_ENABLED) && defined(BLE_TRANSPORT_BLUEDROID)
+
+#include <BLEDevice.h>
+#include "HIDTypes.h"
+#include "BleValueView.h"
+
+// Bond list buffer for onConnect; static so every connection doesn't churn the heap
+static esp_ble_bond_dev_t bondList[BLE_MAX_BONDS];
+
+static bool isBondedPeer(const esp_bd_addr_t addr)
+{
+  esp_ble_bond_dev_t* list = bondList;
+  int count = BLE_MAX_BONDS;
+  if (esp_ble_get_bond_device_num() <= 0 || esp_ble_get_bond_device_list(&count, list) != ESP_OK){
+    return false;
+  }
+  bool found = false;
+  for (int i = 0; i < count && !found; i++){
+    found = memcmp(list[i].bd_addr, addr, sizeof(esp_bd_addr_t)) == 0 ||
+            ((list[i].bond_key.key_mask & ESP_BLE_ID_KEY_MASK) &&
+             memcmp(list[i].bond_key.pid_key.static_addr, addr, sizeof(esp_bd_addr_t)) == 0);
+  }
+  return found;
+}
+
+void BluedroidAttribute::onWrite(BLECharacteristic* pCharacteristic)
+{
+  BleValueView value(pCharacteristic);
+  this->transport->written(this->handle, value.data, value.length);
+}
+
+void BluedroidAttribute::onStatus(BLECharacteristic* pCharacteristic, Status s, uint32_t code)
+{
+  this->notified = s == SUCCESS_NOTIFY || s == SUCCESS_INDICATE;
+}
+
+void BluedroidAttribute::onWrite(BLEDescriptor* pDescriptor)
+{
+  this->transport->status->onSubscribe(this->handle, this->cccd->getNotifications());
+}
+
+// The GAP and GATTS callbacks are plain functions, so they reach the (single) transport through this
+static BluedroidHidTransport* gapTransport = nullptr;
+
+BluedroidHidTransport::BluedroidHidTransport(void) {
+  gapTransport = this;
+}
+
+void BluedroidHidTransport::begin(const HidDeviceInfo& info, BleConnectionStatus* status)
+{
+  this->info = info;
+  this->status = status;
+  BLEDevice::init(info.name);
+  BLEDevice::setCustomGapHandler(BluedroidHidTransport::handleGap);
+  BLEDevice::setCustomGattsHandler(BluedroidHidTransport::handleGatts);
+  BLEDevice::setMTU(BLE_MAX_MTU);
+  this->pServer = BLEDevice::createServer();
+  this->pServer->setCallbacks(this);
+  this->hid = this->hidSlot.create(this->pServer);
+  this->security.setAuthenticationMode(ESP_LE_AUTH_BOND);
+}
+
+uint8_t BluedroidHidTransport::add(BLECharacteristic* characteristic)
+{
+  if (this->count == TRANSPORT_MAX_ATTRIBUTES){
+    return TRANSPORT_NO_HANDLE;
+  }
+  BluedroidAttribute* attribute = &this->attributes[this->count];
+  attribute->transport = this;
+  attribute->characteristic = characteristic;
+  attribute->handle = this->count;
+  characteristic->setCallbacks(attribute);
+  return this->count++;
+}
+
+// BLEHIDDevice gives every input report its CCCD
+uint8_t BluedroidHidTransport::addReport(uint8_t id, HidReportType type)
+{
+  BLECharacteristic* characteristic = type == HID_INPUT_REPORT ? this->hid->inputReport(id) :
+                                      type == HID_OUTPUT_REPORT ? this->hid->outputReport(id) :
+                                      this->hid->featureReport(id);
+  uint8_t handle = this->add(characteristic);
+  if (handle != TRANSPORT_NO_HANDLE && type == HID_INPUT_REPORT){
+    BluedroidAttribute* attribute = &this->attributes[handle];
+    attribute->cccd = (BLE2902*)characteristic->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+    attribute->cccd->setCallbacks(attribute);
+  }
+  return handle;
+}
+
+void BluedroidHidTransport::start(void)
+{
+  this->hid->manufacturer()->setValue(std::string(this->info.manufacturer));
+
+  this->hid->pnp(0x02, this->info.vendorId, this->info.productId, this->info.version);
+  this->hid->hidInfo(0x00,0x01);
+
+  this->hid->reportMap((uint8_t*)this->info.reportMap, this->info.reportMapSize);
+  this->hid->startServices();
+
+  BLEAdvertising *pAdvertising = this->pServer->getAdvertising();
+  pAdvertising->setAppearance(HID_KEYBOARD);
+  pAdvertising->addServiceUUID(this->hid->hidService()->getUUID());
+  this->advertisingBackend = this->advertisingSlot.create(pAdvertising);
+}
+
+void BluedroidHidTransport::beginService(const char* uuid)
+{
+  this->service = this->pServer->createService(uuid);
+}
+
+uint8_t BluedroidHidTransport::addCharacteristic(const char* uuid, uint8_t properties)
+{
+  uint32_t flags = 0;
+  if (properties & TRANSPORT_READ) flags |= BLECharacteristic::PROPERTY_READ;
+  if (properties & TRANSPORT_WRITE) flags |= BLECharacteristic::PROPERTY_WRITE;
+  if (properties & TRANSPORT_WRITE_NR) flags |= BLECharacteristic::PROPERTY_WRITE_NR;
+  if (properties & TRANSPORT_NOTIFY) flags |= BLECharacteristic::PROPERTY_NOTIFY;
+  BLECharacteristic* characteristic = this->service->createCharacteristic(uuid, flags);
+  uint8_t handle = this->add(characteristic);
+  if (handle == TRANSPORT_NO_HANDLE){
+    return handle;
+  }
+  if ((properties & TRANSPORT_NOTIFY) && this->vendorCccdCount < BLUEDROID_VENDOR_CCCDS){
+    BluedroidAttribute* attribute = &this->attributes[handle];
+    attribute->cccd = &this->vendorCccds[this->vendorCccdCount++];
+    attribute->cccd->setCallbacks(attribute);
+    characteristic->addDescriptor(attribute->cccd);
+  }
+  if (properties & TRANSPORT_ENCRYPTED){
+    characteristic->setAccessPermissions(ESP_GATT_PERM_WRITE_ENCRYPTED);
+  }
+  return handle;
+}
+
+void BluedroidHidTransport::endService(void)
+{
+  this->service->start();
+  this->service = nullptr;
+}
+
+AdvertisingBackend* BluedroidHidTransport::advertising(void)
+{
+  return this->advertisingBackend;
+}
+
+bool BluedroidHidTransport::notify(uint8_t handle, const uint8_t* data, size_t len)
+{
+  if (handle >= this->count){
+    return false;
+  }
+  BluedroidAttribute* attribute = &this->attributes[handle];
+  attribute->characteristic->setValue((uint8_t*)data, len);
+  attribute->notified = true;
+  attribute->characteristic->notify();
+  return attribute->notified;
+}
+
+void BluedroidHidTransport::setValue(uint8_t handle, const uint8_t* data, size_t len)
+{
+  if (handle < this->count){
+    this->attributes[handle].characteristic->setValue((uint8_t*)data, len);
+  }
+}
+
+// The library only notifies while the descriptor says so, and it forgets on every disconnect
+void BluedroidHidTransport::setSubscribed(uint8_t handle, bool on)
+{
+  if (handle < this->count && this->attributes[handle].cccd != nullptr){
+    this->attributes[handle].cccd->setNotifications(on);
+  }
+}
+
+void BluedroidHidTransport::setBatteryLevel(uint8_t level)
+{
+  if (this->hid != nullptr){
+    this->hid->setBatteryLevel(level);
+  }
+}
+
+// The library calls the overload with the connection parameters right after this one; all the
+// work happens there
+void BluedroidHidTransport::onConnect(BLEServer* pServer)
+{
+}
+
+void BluedroidHidTransport::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param)
+{
+  this->connId = param->connect.conn_id;
+  this->connected = true;
+  if (this->advertisingBackend != nullptr){
+    this->advertisingBackend->rememberPeer(param->connect.remote_bda);
+  }
+  bool bonded = isBondedPeer(param->connect.remote_bda);
+  this->status->onConnect(bonded, param->connect.conn_params.interval * 1250);
+}
+
+void BluedroidHidTransport::onDisconnect(BLEServer* pServer)
+{
+  this->connected = false;
+  this->status->onDisconnect();
+}
+
+void BluedroidHidTransport::disconnect(void)
+{
+  if (this->connected){
+    this->pServer->disconnect(this->connId);
+  }
+}
+
+int BluedroidHidTransport::bonds(void)
+{
+  int count = esp_ble_get_bond_device_num();
+  return count < 0 ? 0 : count;
+}
+
+// Hosts usually renegotiate the interval shortly after connecting
+void BluedroidHidTransport::handleGap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+{
+  if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT && gapTransport != nullptr && gapTransport->status != nullptr &&
+      param->update_conn_params.status == ESP_BT_STATUS_SUCCESS){
+    gapTransport->status->intervalUs = param->update_conn_params.conn_int * 1250;
+  }
+}
+
+// The stack raises congestion when its notification buffers fill up and clears it once they drain.
+// The MTU comes from the host's exchange request, answered with BLE_MAX_MTU.
+void BluedroidHidTransport::handleGatts(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param)
+{
+  if (gapTransport == nullptr || gapTransport->status == nullptr){
+    return;
+  }
+  if (event == ESP_GATTS_CONGEST_EVT){
+    gapTransport->status->congested = param->congest.congested;
+  } else if (event == ESP_GATTS_MTU_EVT){
+    gapTransport->status->mtu = param->mtu.mtu;
+  }
+}
+
+#endif // CONFIG_BT_ENABLED && BLE_TRANSPORT_BLUEDROID
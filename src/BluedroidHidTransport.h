@@ -0,0 +1,81 @@
+#ifndef ESP32_BLE_BLUEDROID_HID_TRANSPORT_H
+#define ESP32_BLE_BLUEDROID_HID_TRANSPORT_H
+#include "sdkconfig.h"
+#include "HidTransport.h"
+#if defined(CONFIG_BT_ENABLED) && defined(BLE_TRANSPORT_BLUEDROID)
+
+#include <BLEServer.h>
+#include "BLE2902.h"
+#include "BLECharacteristic.h"
+#include "BLEHIDDevice.h"
+#include "BLESecurity.h"
+#include "BleAdvertisingBackend.h"
+#include "BleConnectionStatus.h"
+#include "StaticSlot.h"
+
+#define BLUEDROID_VENDOR_CCCDS 2 //Notify characteristics outside the HID service (trace, firmware control)
+
+class BluedroidHidTransport;
+
+// One characteristic: relays the host's writes to it and to its CCCD, and the result of the last
+// notify, which BLECharacteristic::notify() reports through onStatus rather than a return value
+class BluedroidAttribute : public BLECharacteristicCallbacks, public BLEDescriptorCallbacks
+{
+public:
+  void onWrite(BLECharacteristic* pCharacteristic);
+  void onStatus(BLECharacteristic* pCharacteristic, Status s, uint32_t code);
+  void onWrite(BLEDescriptor* pDescriptor);
+  BluedroidHidTransport* transport = nullptr;
+  BLECharacteristic* characteristic = nullptr;
+  BLE2902* cccd = nullptr;
+  uint8_t handle = TRANSPORT_NO_HANDLE;
+  bool notified = true;
+};
+
+// The Arduino core's Bluedroid BLE library. Everything it sets up lives in the transport object,
+// so only the library's own allocations touch the heap.
+class BluedroidHidTransport : public HidTransport, public BLEServerCallbacks
+{
+public:
+  BluedroidHidTransport(void);
+  void begin(const HidDeviceInfo& info, BleConnectionStatus* status);
+  uint8_t addReport(uint8_t id, HidReportType type);
+  void start(void);
+  void beginService(const char* uuid);
+  uint8_t addCharacteristic(const char* uuid, uint8_t properties);
+  void endService(void);
+  AdvertisingBackend* advertising(void);
+  bool notify(uint8_t handle, const uint8_t* data, size_t len);
+  void setValue(uint8_t handle, const uint8_t* data, size_t len);
+  void setSubscribed(uint8_t handle, bool on);
+  void setBatteryLevel(uint8_t level);
+  void disconnect(void);
+  int bonds(void);
+  BLEServer* server(void) { return this->pServer; }
+  void onConnect(BLEServer* pServer);
+  void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
+  void onDisconnect(BLEServer* pServer);
+  static void handleGap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+  static void handleGatts(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t* param);
+private:
+  friend class BluedroidAttribute;
+  uint8_t add(BLECharacteristic* characteristic);
+  HidDeviceInfo info;
+  BleConnectionStatus* status = nullptr;
+  BLEServer* pServer = nullptr;
+  BLEService* service = nullptr; // Vendor service being built
+  BLEHIDDevice* hid = nullptr;
+  BleAdvertisingBackend* advertisingBackend = nullptr;
+  BLESecurity security;
+  StaticSlot<BLEHIDDevice> hidSlot;
+  StaticSlot<BleAdvertisingBackend> advertisingSlot;
+  BluedroidAttribute attributes[TRANSPORT_MAX_ATTRIBUTES];
+  BLE2902 vendorCccds[BLUEDROID_VENDOR_CCCDS];
+  uint8_t count = 0;
+  uint8_t vendorCccdCount = 0;
+  volatile bool connected = false;
+  uint16_t connId = 0;
+};
+
+#endif // CONFIG_BT_ENABLED && BLE_TRANSPORT_BLUEDROID
+#endif // ESP32_BLE_BLUEDROID_HID_TRANSPORT_H
@@ -0,0 +1,22 @@
+#include <string.h>
+#include "esp_timer.h"
+
+#include "BootTimeline.h"
+
+void BootTimeline::mark(const char* name){
+  this->mark(name, esp_timer_get_time());
+}
+
+void BootTimeline::mark(const char* name, int64_t us){
+  if (this->stages == BOOT_TIMELINE_STAGES) return;
+  this->marks[this->stages].name = name;
+  this->marks[this->stages].us = us;
+  this->stages++;
+}
+
+int64_t BootTimeline::at(const char* name) const {
+  for (size_t i = 0; i < this->stages; i++){
+    if (strcmp(this->marks[i].name, name) == 0) return this->marks[i].us;
+  }
+  return -1;
+}
@@ -0,0 +1,28 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BOOT_TIMELINE_STAGES 12
+
+typedef struct {
+  const char* name;
+  int64_t us;    // esp_timer clock, microseconds since the app started
+} BootStage;
+
+// Timestamps of the boot stages, kept in RAM while booting and printed once the pad is up, so
+// printing never delays the stages it measures. Marks past BOOT_TIMELINE_STAGES are dropped.
+class BootTimeline {
+public:
+  void mark(const char* name);
+  void mark(const char* name, int64_t us);
+  size_t count(void) const { return this->stages; }
+  const BootStage& stage(size_t i) const { return this->marks[i]; }
+  int64_t at(const char* name) const; // -1 if the stage was not reached
+private:
+  BootStage marks[BOOT_TIMELINE_STAGES];
+  size_t stages = 0;
+};
+
+#endif // BOOT_TIMELINE_H
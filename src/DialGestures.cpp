@@ -0,0 +1,105 @@
+#include "DialGestures.h"
+
+DialGestureEngine::DialGestureEngine(DialGestureCallbacks* callbacks) : callbacks(callbacks) {
+}
+
+void DialGestureEngine::emit(DialGesture gesture, const DialAction& action, int delta){
+  if (action.type != DIAL_ACTION_NONE){
+    this->callbacks->onGesture(gesture, action, delta);
+  }
+}
+
+void DialGestureEngine::end(DialGesture gesture, const DialAction& action){
+  if (action.type != DIAL_ACTION_NONE){
+    this->callbacks->onGestureEnd(gesture, action);
+  }
+}
+
+void DialGestureEngine::press(uint32_t now){
+  if (this->state == TAP_PENDING && now - this->releasedAt <= this->config.doubleTapWindow){
+    this->state = SECOND_PRESS;
+  } else {
+    if (this->state == TAP_PENDING){
+      this->emit(DIAL_GESTURE_TAP, this->config.tap, 0);
+    }
+    this->state = PRESSED;
+  }
+  this->pressedAt = now;
+}
+
+void DialGestureEngine::release(uint32_t now){
+  switch (this->state){
+    case PRESSED:
+      if (this->config.doubleTap.type == DIAL_ACTION_NONE){
+        this->emit(DIAL_GESTURE_TAP, this->config.tap, 0);
+        this->state = IDLE;
+      } else {
+        this->releasedAt = now;
+        this->state = TAP_PENDING;
+      }
+      break;
+    case SECOND_PRESS:
+      this->emit(DIAL_GESTURE_DOUBLE_TAP, this->config.doubleTap, 0);
+      this->state = IDLE;
+      break;
+    case HELD:
+      this->end(DIAL_GESTURE_LONG_PRESS, this->config.longPress);
+      this->state = IDLE;
+      break;
+    case ROTATING:
+      this->end(DIAL_GESTURE_PRESS_ROTATE, this->config.pressRotate);
+      if (this->longPressActive){
+        this->end(DIAL_GESTURE_LONG_PRESS, this->config.longPress);
+      }
+      this->state = IDLE;
+      break;
+    default:
+      break;
+  }
+}
+
+bool DialGestureEngine::rotate(int delta, uint32_t now){
+  if (this->config.pressRotate.type == DIAL_ACTION_NONE){
+    return false;
+  }
+  if (this->state == SECOND_PRESS){
+    // Turning on the second press: the first one was a plain tap
+    this->emit(DIAL_GESTURE_TAP, this->config.tap, 0);
+    this->state = PRESSED;
+  }
+  if (this->state == PRESSED || this->state == HELD){
+    this->longPressActive = this->state == HELD;
+    this->state = ROTATING;
+  }
+  if (this->state != ROTATING){
+    return false;
+  }
+  this->emit(DIAL_GESTURE_PRESS_ROTATE, this->config.pressRotate, delta);
+  return true;
+}
+
+bool DialGestureEngine::deadline(uint32_t* at) const {
+  if (this->state == TAP_PENDING){
+    *at = this->releasedAt + this->config.doubleTapWindow + 1;
+  } else if (this->state == PRESSED || this->state == SECOND_PRESS){
+    *at = this->pressedAt + this->config.longPressDelay;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void DialGestureEngine::update(uint32_t now){
+  if (this->state == TAP_PENDING && now - this->releasedAt > this->config.doubleTapWindow){
+    this->emit(DIAL_GESTURE_TAP, this->config.tap, 0);
+    this->state = IDLE;
+  } else if (this->state == SECOND_PRESS && now - this->pressedAt >= this->config.longPressDelay){
+    // Held on the second press: a tap followed by a long press
+    this->emit(DIAL_GESTURE_TAP, this->config.tap, 0);
+    this->state = PRESSED;
+  }
+  if (this->state == PRESSED && now - this->pressedAt >= this->config.longPressDelay){
+    this->emit(DIAL_GESTURE_LONG_PRESS, this->config.longPress, 0);
+    this->state = HELD;
+  }
+}
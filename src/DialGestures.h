@@ -0,0 +1,75 @@
+#ifndef DIAL_GESTURES_H
+#define DIAL_GESTURES_H
+
+#include <stdint.h>
+
+#define DIAL_LONGPRESS_DELAY 400 //Milliseconds before a held dial button counts as a long press
+#define DIAL_DOUBLETAP_WINDOW 250 //Milliseconds after a tap in which a second press makes a double tap
+
+enum DialGesture {
+  DIAL_GESTURE_TAP,
+  DIAL_GESTURE_DOUBLE_TAP,
+  DIAL_GESTURE_LONG_PRESS,
+  DIAL_GESTURE_PRESS_ROTATE
+};
+
+enum DialActionType {
+  DIAL_ACTION_NONE,
+  DIAL_ACTION_CLICK,  // Surface Dial press + release
+  DIAL_ACTION_HOLD,   // Surface Dial press, released when the button is let go
+  DIAL_ACTION_ROTATE, // Surface Dial rotation with the button held
+  DIAL_ACTION_KEYS    // Key chord: key plus KEY_LEFT_* modifiers
+};
+
+struct DialAction {
+  DialActionType type;
+  uint8_t key;
+  uint8_t ctrl;
+  uint8_t alt;
+  uint8_t shift;
+};
+
+struct DialGestureConfig {
+  DialAction tap = {DIAL_ACTION_CLICK, 0, 0, 0, 0};
+  DialAction doubleTap = {DIAL_ACTION_NONE, 0, 0, 0, 0};
+  DialAction longPress = {DIAL_ACTION_HOLD, 0, 0, 0, 0};
+  DialAction pressRotate = {DIAL_ACTION_ROTATE, 0, 0, 0, 0};
+  uint32_t longPressDelay = DIAL_LONGPRESS_DELAY;
+  uint32_t doubleTapWindow = DIAL_DOUBLETAP_WINDOW;
+};
+
+class DialGestureCallbacks {
+public:
+  virtual ~DialGestureCallbacks() {}
+  virtual void onGesture(DialGesture gesture, const DialAction& action, int delta) = 0;
+  // Long press and press-and-rotate last until the button is released
+  virtual void onGestureEnd(DialGesture gesture, const DialAction& action) {}
+};
+
+// Turns timestamped dial button and encoder events into gestures. Nothing here reads a clock,
+// so it can be driven with any time source.
+//
+// A tap is reported on release. Only when a double tap action is configured does it wait
+// doubleTapWindow for a second press first.
+class DialGestureEngine {
+public:
+  DialGestureEngine(DialGestureCallbacks* callbacks);
+  void press(uint32_t now);
+  void release(uint32_t now);
+  bool rotate(int delta, uint32_t now); // True if the rotation was taken by press-and-rotate
+  void update(uint32_t now);
+  bool deadline(uint32_t* at) const; // When update() next has something to do; false if nothing waits on time
+  bool pressed() const { return this->state == PRESSED || this->state == SECOND_PRESS || this->state == HELD || this->state == ROTATING; }
+  DialGestureConfig config;
+private:
+  enum State { IDLE, PRESSED, TAP_PENDING, SECOND_PRESS, HELD, ROTATING };
+  void emit(DialGesture gesture, const DialAction& action, int delta);
+  void end(DialGesture gesture, const DialAction& action);
+  DialGestureCallbacks* callbacks;
+  State state = IDLE;
+  uint32_t pressedAt = 0;
+  uint32_t releasedAt = 0;
+  bool longPressActive = false;
+};
+
+#endif // DIAL_GESTURES_H
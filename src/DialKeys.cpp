@@ -0,0 +1,64 @@
+#include "DialKeys.h"
+
+void DialKeys::refill(uint32_t now){
+  uint32_t full = (uint32_t)this->config.burst * 1000;
+  if (!this->started){
+    this->started = true;
+    this->credit = full;
+  } else {
+    uint32_t elapsed = now - this->refilledAt;
+    // Saturate before multiplying, so a long idle period can't overflow
+    if (elapsed >= full){
+      this->credit = full;
+    } else {
+      this->credit += elapsed * this->config.maxRate;
+      if (this->credit > full) this->credit = full;
+    }
+  }
+  this->refilledAt = now;
+}
+
+void DialKeys::rotate(int delta, uint32_t now){
+  this->refill(now);
+  this->steps += delta;
+  if (this->config.maxPendingMs == 0){
+    return;
+  }
+  // The taps the bucket holds now plus maxPendingMs of refill, and a partial tap
+  int32_t taps = this->credit / 1000 + (uint32_t)this->config.maxRate * this->config.maxPendingMs / 1000;
+  int32_t limit = (taps + 1) * this->config.stepsPerTap - 1;
+  if (this->steps > limit){
+    this->droppedSteps += this->steps - limit;
+    this->steps = limit;
+  } else if (this->steps < -limit){
+    this->droppedSteps += -limit - this->steps;
+    this->steps = -limit;
+  }
+}
+
+// The bucket gains maxRate per millisecond, so the next tap is due once it has made up the
+// shortfall to 1000
+bool DialKeys::deadline(uint32_t* at) const {
+  if (this->pending() == 0){
+    return false;
+  }
+  if (!this->started || this->credit >= 1000){
+    *at = this->refilledAt;
+  } else if (this->config.maxRate == 0){
+    return false;
+  } else {
+    *at = this->refilledAt + (1000 - this->credit + this->config.maxRate - 1) / this->config.maxRate;
+  }
+  return true;
+}
+
+int DialKeys::take(uint32_t now){
+  this->refill(now);
+  int32_t taps = this->pending();
+  int32_t allowed = this->credit / 1000;
+  if (taps > allowed) taps = allowed;
+  if (taps < -allowed) taps = -allowed;
+  this->steps -= taps * this->config.stepsPerTap;
+  this->credit -= (taps < 0 ? -taps : taps) * 1000;
+  return taps;
+}
@@ -0,0 +1,44 @@
+#ifndef DIAL_KEYS_H
+#define DIAL_KEYS_H
+
+#include <stdint.h>
+#include "DialGestures.h"
+
+#define DIAL_KEYS_MAX_RATE 30 //Taps per second a fast spin is capped at
+#define DIAL_KEYS_BURST 4 //Taps that may go out back to back before the rate cap applies
+
+struct DialKeysConfig {
+  DialAction forward = {DIAL_ACTION_KEYS, '[', 0, 0, 0};
+  DialAction reverse = {DIAL_ACTION_KEYS, ']', 0, 0, 0};
+  uint8_t stepsPerTap = 1;
+  uint16_t maxRate = DIAL_KEYS_MAX_RATE;
+  uint8_t burst = DIAL_KEYS_BURST;
+  uint16_t maxPendingMs = 0; // Opt-in cap on the taps a spin leaves waiting, in milliseconds of maxRate; 0 keeps every step
+};
+
+// Turns dial steps into key taps for apps without Surface Dial support. Steps accumulate and
+// take() hands out whole taps through a token bucket: up to burst at once, then maxRate per
+// second. Steps that can't go out yet carry over, and turning back cancels them. With
+// maxPendingMs set the carry is capped at what the bucket can pay out within it, so taps stop
+// soon after the dial does; steps past the cap are dropped and counted. Without it every step
+// becomes a tap, however long the carry takes to pay out.
+// Like DialGestureEngine it never reads a clock.
+class DialKeys {
+public:
+  void rotate(int delta, uint32_t now);
+  int take(uint32_t now); // Taps to send now, negative for reverse
+  bool deadline(uint32_t* at) const; // When take() next has a tap to give; false if none are pending
+  int pending() const { return this->steps / this->config.stepsPerTap; }
+  void clear() { this->steps = 0; }
+  uint32_t dropped() const { return this->droppedSteps; } // Steps lost to maxPendingMs so far
+  DialKeysConfig config;
+private:
+  void refill(uint32_t now);
+  int32_t steps = 0;
+  uint32_t credit = 0; // Milliseconds times maxRate; one tap costs 1000
+  uint32_t refilledAt = 0;
+  bool started = false;
+  uint32_t droppedSteps = 0;
+};
+
+#endif // DIAL_KEYS_H
@@ -0,0 +1,57 @@
+#include "DialModes.h"
+
+void DialModes::configure(void){
+  for (int k = 0; k < DIAL_MODE_MATRIX_KEYS; k++){
+    this->modeOf[k] = 0;
+  }
+  for (int i = 0; i < DIAL_MODES; i++){
+    DialMode& mode = this->config.modes[i];
+    if (mode.stepsPerUnit == 0) mode.stepsPerUnit = 1;
+    if (mode.key >= 0 && mode.key < DIAL_MODE_MATRIX_KEYS){
+      this->modeOf[mode.key] = i + 1;
+    }
+    this->keys[i].config.forward = mode.forward;
+    this->keys[i].config.reverse = mode.reverse;
+    this->keys[i].config.stepsPerTap = mode.stepsPerUnit;
+    this->keys[i].config.maxPendingMs = mode.maxPendingMs;
+  }
+}
+
+bool DialModes::press(int k){
+  if (k < 0 || k >= DIAL_MODE_MATRIX_KEYS || this->modeOf[k] == 0){
+    return false;
+  }
+  this->current = this->modeOf[k] - 1;
+  return true;
+}
+
+bool DialModes::release(int k){
+  if (k < 0 || k >= DIAL_MODE_MATRIX_KEYS || this->modeOf[k] == 0){
+    return false;
+  }
+  if (this->current == this->modeOf[k] - 1){
+    this->current = -1;
+  }
+  return true;
+}
+
+// Truncates toward zero like DialKeys, so turning back first uses up the carry
+int DialModes::units(int delta){
+  if (this->current < 0){
+    return 0;
+  }
+  int32_t steps = this->carry[this->current] + delta;
+  int32_t units = steps / this->mode().stepsPerUnit;
+  this->carry[this->current] = steps - units * this->mode().stepsPerUnit;
+  return units;
+}
+
+bool DialModes::detent(int delta){
+  if (this->current < 0 || this->mode().detentSteps == 0){
+    return false;
+  }
+  int32_t steps = this->detentCarry[this->current] + delta;
+  int32_t detents = steps / this->mode().detentSteps;
+  this->detentCarry[this->current] = steps - detents * this->mode().detentSteps;
+  return detents != 0;
+}
@@ -0,0 +1,72 @@
+#ifndef DIAL_MODES_H
+#define DIAL_MODES_H
+
+#include <stdint.h>
+#include "DialGestures.h"
+#include "DialKeys.h"
+
+#define DIAL_MODES 4 //Modes besides the default, each chosen by holding a matrix key
+#define DIAL_MODE_MATRIX_KEYS 32 //Matrix indexes a mode key can have, as many as a matrix sample
+
+enum DialModeOutput {
+  DIAL_MODE_RADIAL, // Surface Dial rotation
+  DIAL_MODE_KEYS,   // Taps of forward / reverse, paced like the dial's key tap mode
+  DIAL_MODE_WHEEL,  // Vertical mouse wheel notches
+  DIAL_MODE_VOLUME  // Consumer volume up / down
+};
+
+// What the dial does while key is held. Every stepsPerUnit encoder steps make one unit: a
+// rotation step, a tap, a notch or a volume step. With detentSteps set the motor runs for
+// detentMs every that many steps. A DIAL_MODE_KEYS mode keeps every step unless maxPendingMs
+// caps its carry (see DialKeys).
+struct DialMode {
+  int8_t key = -1; // Matrix index, -1 for an unused mode
+  DialModeOutput output = DIAL_MODE_RADIAL;
+  uint8_t stepsPerUnit = 1;
+  DialAction forward = {DIAL_ACTION_KEYS, 0, 0, 0, 0};
+  DialAction reverse = {DIAL_ACTION_KEYS, 0, 0, 0, 0};
+  uint8_t detentSteps = 0;
+  uint16_t detentMs = 0;
+  uint16_t maxPendingMs = 0;
+};
+
+// For example, brush size on '[' / ']' while 'd' is held and zoom on the wheel while 'f' is:
+//   config.modes[0].key = 3;
+//   config.modes[0].output = DIAL_MODE_KEYS;
+//   config.modes[0].forward.key = ']';
+//   config.modes[0].reverse.key = '[';
+//   config.modes[1].key = 5;
+//   config.modes[1].output = DIAL_MODE_WHEEL;
+//   config.modes[1].stepsPerUnit = 4;
+// then configure().
+struct DialModeConfig {
+  DialMode modes[DIAL_MODES];
+};
+
+// Which dial mode is active, from mode key presses and releases, and what each encoder delta
+// comes to in it. The last mode key pressed wins; letting go of it goes back to the default
+// mode at once, even if another mode key is still down.
+//
+// configure() precomputes a mode per matrix index, so a key event and an encoder delta are both
+// a table index. Partial units carry over per mode and stay with it while another mode is in
+// use, so every step counts exactly once, in the mode it was turned in. Like DialKeys it never
+// reads a clock.
+class DialModes {
+public:
+  void configure(void); // After changing config
+  bool press(int k);    // True if k is a mode key
+  bool release(int k);  // True if k is a mode key
+  int active() const { return this->current; } // -1 for the default mode
+  const DialMode& mode() const { return this->config.modes[this->current]; }
+  int units(int delta);   // Whole units delta completes in the active mode
+  bool detent(int delta); // True if delta passed a detent of the active mode
+  DialKeys keys[DIAL_MODES]; // Taps of the DIAL_MODE_KEYS modes
+  DialModeConfig config;
+private:
+  uint8_t modeOf[DIAL_MODE_MATRIX_KEYS] = {}; // Index into modes plus one, 0 if not a mode key
+  int8_t current = -1;
+  int32_t carry[DIAL_MODES] = {};
+  int32_t detentCarry[DIAL_MODES] = {};
+};
+
+#endif // DIAL_MODES_H
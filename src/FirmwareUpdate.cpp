@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "FirmwareUpdate.h"
+
+static uint32_t readU32(const uint8_t* p){
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t FirmwareUpdateStats::bytesPerSecond() const {
+  uint32_t ms = this->finishedAt - this->startedAt;
+  return ms == 0 ? 0 : (uint32_t)((uint64_t)this->bytes * 1000 / ms);
+}
+
+FirmwareUpdate::FirmwareUpdate(FlashBackend* flash) : flash(flash) {
+  mbedtls_sha256_init(&this->sha);
+}
+
+FirmwareUpdate::~FirmwareUpdate(){
+  mbedtls_sha256_free(&this->sha);
+}
+
+size_t FirmwareUpdate::control(const uint8_t* data, size_t len, uint32_t now, uint8_t* reply){
+  FirmwareUpdateResult result = FW_RESULT_OK;
+  if (len == 1 + 4 + 32 && data[0] == FW_OP_START){
+    result = this->start(readU32(data + 1), data + 5, now);
+  } else if (len == 1 && data[0] == FW_OP_ABORT){
+    if (this->current == FW_STATE_RECEIVING){
+      this->flash->abort();
+    }
+    this->current = FW_STATE_IDLE;
+  } else if (!(len == 1 && data[0] == FW_OP_STATUS)){
+    result = FW_RESULT_BAD_REQUEST;
+  }
+  return this->reply(result, reply);
+}
+
+// An unfinished image with the same size and hash is picked up where it stopped, so a dropped
+// link costs nothing already written. Anything else starts over.
+FirmwareUpdateResult FirmwareUpdate::start(uint32_t size, const uint8_t* hash, uint32_t now){
+  this->unacked = 0;
+  this->rewinding = false;
+  if (this->current == FW_STATE_RECEIVING && size == this->size && memcmp(hash, this->expected, 32) == 0){
+    this->counters.resumes++;
+    return FW_RESULT_OK;
+  }
+  if (this->current == FW_STATE_RECEIVING){
+    this->flash->abort();
+  }
+  this->current = FW_STATE_IDLE;
+  if (size == 0){
+    return FW_RESULT_BAD_REQUEST;
+  }
+  if (!this->flash->begin(size)){
+    this->current = FW_STATE_FAILED;
+    return FW_RESULT_FLASH_ERROR;
+  }
+  memcpy(this->expected, hash, 32);
+  this->size = size;
+  this->offset = 0;
+  this->counters = FirmwareUpdateStats();
+  this->counters.startedAt = now;
+  mbedtls_sha256_starts_ret(&this->sha, 0);
+  this->current = FW_STATE_RECEIVING;
+  return FW_RESULT_OK;
+}
+
+size_t FirmwareUpdate::data(const uint8_t* data, size_t len, uint32_t now, uint8_t* reply){
+  if (this->current != FW_STATE_RECEIVING){
+    return this->reply(FW_RESULT_NOT_STARTED, reply);
+  }
+  if (len <= FIRMWARE_UPDATE_CHUNK_HEADER){
+    return this->reply(FW_RESULT_BAD_REQUEST, reply);
+  }
+  uint32_t at = readU32(data);
+  data += FIRMWARE_UPDATE_CHUNK_HEADER;
+  len -= FIRMWARE_UPDATE_CHUNK_HEADER;
+  if (at != this->offset || len > this->size - this->offset){
+    // The rest of the window is still in flight; answer the first stray chunk only
+    if (this->rewinding){
+      return 0;
+    }
+    this->rewinding = true;
+    this->unacked = 0;
+    this->counters.rewinds++;
+    return this->reply(FW_RESULT_OUT_OF_ORDER, reply);
+  }
+  this->rewinding = false;
+  if (!this->flash->write(data, len)){
+    this->fail();
+    return this->reply(FW_RESULT_FLASH_ERROR, reply);
+  }
+  mbedtls_sha256_update_ret(&this->sha, data, len);
+  this->offset += len;
+  this->counters.bytes = this->offset;
+  this->counters.chunks++;
+  if (this->offset == this->size){
+    return this->reply(this->complete(now), reply);
+  }
+  if (++this->unacked >= FIRMWARE_UPDATE_ACK_EVERY){
+    this->unacked = 0;
+    return this->reply(FW_RESULT_OK, reply);
+  }
+  return 0;
+}
+
+// Switches partitions only once the whole image hashes right and the flash side accepts it
+FirmwareUpdateResult FirmwareUpdate::complete(uint32_t now){
+  uint8_t hash[32];
+  mbedtls_sha256_finish_ret(&this->sha, hash);
+  if (memcmp(hash, this->expected, 32) != 0){
+    this->fail();
+    return FW_RESULT_HASH_MISMATCH;
+  }
+  if (!this->flash->finish() || !this->flash->activate()){
+    this->current = FW_STATE_FAILED;
+    return FW_RESULT_FLASH_ERROR;
+  }
+  this->counters.finishedAt = now;
+  this->current = FW_STATE_DONE;
+  return FW_RESULT_OK;
+}
+
+void FirmwareUpdate::fail(){
+  this->flash->abort();
+  this->current = FW_STATE_FAILED;
+}
+
+size_t FirmwareUpdate::reply(FirmwareUpdateResult result, uint8_t* reply){
+  uint16_t chunk = this->chunkSize();
+  reply[0] = result;
+  reply[1] = this->current;
+  reply[2] = this->offset;
+  reply[3] = this->offset >> 8;
+  reply[4] = this->offset >> 16;
+  reply[5] = this->offset >> 24;
+  reply[6] = chunk;
+  reply[7] = chunk >> 8;
+  reply[8] = FIRMWARE_UPDATE_WINDOW;
+  return FIRMWARE_UPDATE_REPLY_SIZE;
+}
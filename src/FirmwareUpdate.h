@@ -0,0 +1,102 @@
+#ifndef FIRMWARE_UPDATE_H
+#define FIRMWARE_UPDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mbedtls/sha256.h>
+
+// Firmware update over GATT, streamed into the inactive OTA partition as it arrives.
+//
+// Control point (write, notify):
+//   01 size:u32 sha256:32   START: begin an image, or resume the unfinished one with the same size and hash
+//   02                      ABORT
+//   03                      STATUS
+// Data (write without response): offset:u32, then image bytes for that offset
+// Every reply is a notification on the control point:
+//   result:u8 state:u8 offset:u32 chunk:u16 window:u8
+// offset is the next byte the device wants and chunk the most image bytes one data write can
+// carry at the current MTU. The client keeps up to window chunks unacknowledged; the device
+// acknowledges every half window, so a steady stream never waits on a reply. A chunk for any
+// other offset is dropped and answered once with the offset wanted, so the client rewinds to it.
+// Integers are little endian.
+#define FIRMWARE_UPDATE_WINDOW 16 //Data writes the client may have in flight without an acknowledgement
+#define FIRMWARE_UPDATE_ACK_EVERY (FIRMWARE_UPDATE_WINDOW / 2)
+#define FIRMWARE_UPDATE_CHUNK_HEADER 4
+#define FIRMWARE_UPDATE_REPLY_SIZE 9
+#define FIRMWARE_UPDATE_ATT_HEADER 3 //Opcode and handle in front of every ATT write
+
+enum FirmwareUpdateOp {
+  FW_OP_START = 1,
+  FW_OP_ABORT = 2,
+  FW_OP_STATUS = 3
+};
+
+enum FirmwareUpdateState {
+  FW_STATE_IDLE,
+  FW_STATE_RECEIVING,
+  FW_STATE_DONE,   // Verified and set to boot; waiting for the restart
+  FW_STATE_FAILED
+};
+
+enum FirmwareUpdateResult {
+  FW_RESULT_OK,
+  FW_RESULT_BAD_REQUEST,
+  FW_RESULT_NOT_STARTED,
+  FW_RESULT_OUT_OF_ORDER,
+  FW_RESULT_FLASH_ERROR,
+  FW_RESULT_HASH_MISMATCH
+};
+
+// Flash side of an update. The ESP32 implementation lives in OtaFlashBackend; host tools swap in
+// a simulated flash.
+class FlashBackend {
+public:
+  virtual ~FlashBackend() {}
+  virtual bool begin(uint32_t size) = 0;                    // Prepare the inactive partition for size bytes
+  virtual bool write(const uint8_t* data, size_t len) = 0;  // Append to the image
+  virtual bool finish() = 0;                                // Close the image; false if it won't boot
+  virtual bool activate() = 0;                              // Boot the new image from the next restart
+  virtual void abort() = 0;
+};
+
+struct FirmwareUpdateStats {
+  uint32_t bytes = 0;
+  uint32_t chunks = 0;
+  uint32_t rewinds = 0;    // Out of order chunks answered with the offset wanted
+  uint32_t resumes = 0;    // STARTs that picked up an unfinished image
+  uint32_t startedAt = 0;
+  uint32_t finishedAt = 0;
+  uint32_t bytesPerSecond() const;
+};
+
+// Protocol state of one update. Like ReconnectManager it never reads a clock; replies go into
+// the caller's buffer and the caller notifies them.
+class FirmwareUpdate {
+public:
+  FirmwareUpdate(FlashBackend* flash);
+  ~FirmwareUpdate();
+  // Each returns the reply length, 0 when there is nothing to send
+  size_t control(const uint8_t* data, size_t len, uint32_t now, uint8_t* reply);
+  size_t data(const uint8_t* data, size_t len, uint32_t now, uint8_t* reply);
+  void setMtu(uint16_t mtu) { this->mtu = mtu; }
+  uint16_t chunkSize() const { return this->mtu - FIRMWARE_UPDATE_ATT_HEADER - FIRMWARE_UPDATE_CHUNK_HEADER; }
+  FirmwareUpdateState state() const { return this->current; }
+  const FirmwareUpdateStats& stats() const { return this->counters; }
+private:
+  FirmwareUpdateResult start(uint32_t size, const uint8_t* hash, uint32_t now);
+  FirmwareUpdateResult complete(uint32_t now);
+  void fail();
+  size_t reply(FirmwareUpdateResult result, uint8_t* reply);
+  FlashBackend* flash;
+  FirmwareUpdateState current = FW_STATE_IDLE;
+  FirmwareUpdateStats counters;
+  mbedtls_sha256_context sha;
+  uint8_t expected[32] = {};
+  uint32_t size = 0;
+  uint32_t offset = 0;
+  uint16_t mtu = 23;
+  uint8_t unacked = 0;
+  bool rewinding = false;
+};
+
+#endif // FIRMWARE_UPDATE_H
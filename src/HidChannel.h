@@ -0,0 +1,268 @@
+#ifndef ESP32_BLE_HID_CHANNEL_H
+#define ESP32_BLE_HID_CHANNEL_H
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <arduino.h>
+#include "HidTransport.h"
+#include "BleConnectionStatus.h"
+#include "HidDescriptor.h"
+
+#define HID_QUEUE_DEPTH 16 //Reports each input report can hold while the link is busy
+
+// Counters for the outbound report queue
+struct HidQueueStats {
+  uint32_t queued = 0;   // Reports handed to the queue
+  uint32_t merged = 0;   // Folded into a report that was already waiting
+  uint32_t stalled = 0;  // Sends that found their queue full and waited for the link
+  uint32_t dropped = 0;  // Overwrote a waiting report after waiting for room gave up
+  uint32_t retried = 0;  // Notifications refused by the stack, kept for the next attempt
+  uint32_t congested = 0; // Sends held back because the stack signalled congestion
+  uint16_t depth = 0;    // Reports waiting now
+  uint16_t maxDepth = 0;
+  uint32_t notifies = 0; // Notifications the stack took
+  uint64_t notifyUs = 0; // Time spent handing them to the transport
+  uint32_t maxNotifyUs = 0;
+};
+
+// How a new report joins the queue when the newest waiting report has the same type. Reports
+// that carry absolute state only merge when nothing changed, so every state the host should see,
+// a key press and its release included, gets its own report; a full queue makes the sender wait.
+// Types with relative fields overload this next to their definition.
+template<typename Report>
+bool hidCoalesce(Report* waiting, const Report* next, bool full) {
+  if (memcmp(waiting, next, sizeof(Report)) == 0){
+    memcpy(waiting, next, sizeof(Report));
+    return true;
+  }
+  return false;
+}
+
+// One report of the HID service: a report struct bound to a report ID and type. Input channels
+// also carry the descriptor collection that declares them (output and feature reports of the
+// same ID live in that collection), and a small queue of reports waiting for the link.
+// Everything is resolved at compile time; sending a report is a direct, non-virtual call.
+template<typename Report, uint8_t Id, HidReportType Type, typename Desc = hid::Descriptor<>>
+class HidChannel
+{
+public:
+  typedef Report report_type;
+  typedef Desc descriptor;
+
+  void create(HidTransport* transport) {
+    this->transport = transport;
+    this->handle = transport->addReport(Id, Type);
+    if (Type == HID_INPUT_REPORT)
+      this->cccd.attach(transport, this->handle);
+  }
+
+  void attach(BleConnectionStatus* status) {
+    if (Type == HID_INPUT_REPORT)
+      status->addCccd(this->handle, &this->cccd);
+  }
+
+  // Output and feature reports: what the host reads, and who gets what it writes
+  void setValue(const Report* report) { this->transport->setValue(this->handle, (const uint8_t*)report, sizeof(Report)); }
+  void setWriter(TransportWriter* writer) { this->transport->setWriter(this->handle, writer); }
+
+  // Adds a report to this channel's queue; seq orders it against the other channels. False if
+  // the queue is full and the report doesn't merge into the newest one; with force it overwrites
+  // that one instead.
+  bool queue(const Report* report, uint32_t seq, HidQueueStats* stats, bool force) {
+    static_assert(Type == HID_INPUT_REPORT, "Only input reports can be notified");
+    if (this->count > 0){
+      uint8_t tail = (this->head + this->count - 1) % Depth;
+      bool full = this->count == Depth;
+      if (hidCoalesce(&this->waiting[tail], report, full)){
+        stats->queued++;
+        stats->merged++;
+        return true;
+      }
+      if (full && !force){
+        stats->stalled++;
+        return false;
+      }
+      if (full){
+        memcpy(&this->waiting[tail], report, sizeof(Report));
+        stats->queued++;
+        stats->dropped++;
+        return true;
+      }
+    }
+    stats->queued++;
+    uint8_t slot = (this->head + this->count) % Depth;
+    memcpy(&this->waiting[slot], report, sizeof(Report));
+    this->seqs[slot] = seq;
+    this->count++;
+    stats->depth++;
+    if (stats->depth > stats->maxDepth) stats->maxDepth = stats->depth;
+    return true;
+  }
+
+  bool pending() const { return this->count > 0; }
+  uint32_t headSeq() const { return this->seqs[this->head]; }
+
+  // Notifies the oldest waiting report. False if the stack refused it, so it stays queued.
+  // Reports for an unsubscribed host are discarded; it gets the current state on resubscribe.
+  bool sendHead(HidQueueStats* stats) {
+    if (this->cccd.subscribed){
+      uint32_t started = micros();
+      bool sent = this->notify(&this->waiting[this->head]);
+      uint32_t us = micros() - started;
+      if (!sent){
+        stats->retried++;
+        return false;
+      }
+      stats->notifies++;
+      stats->notifyUs += us;
+      if (us > stats->maxNotifyUs) stats->maxNotifyUs = us;
+    }
+    this->head = (this->head + 1) % Depth;
+    this->count--;
+    stats->depth--;
+    return true;
+  }
+
+  // False if the host is not subscribed or the stack refused the notification
+  bool notify(const Report* report) {
+    if (!this->cccd.subscribed)
+      return false;
+    return this->transport->notify(this->handle, (const uint8_t*)report, sizeof(Report));
+  }
+
+  // Report struct size against the bit length the full descriptor gives this ID and type
+  template<typename Full>
+  static constexpr bool matches() {
+    return hid::reportBits(Full::data, Full::size,
+                           Type == HID_INPUT_REPORT ? hid::ITEM_INPUT :
+                           Type == HID_OUTPUT_REPORT ? hid::ITEM_OUTPUT : hid::ITEM_FEATURE,
+                           Id) == sizeof(Report) * 8;
+  }
+
+  HidTransport* transport = nullptr;
+  uint8_t handle = TRANSPORT_NO_HANDLE;
+  CccdState cccd;
+private:
+  static const uint8_t Depth = Type == HID_INPUT_REPORT ? HID_QUEUE_DEPTH : 1;
+  Report waiting[Depth];
+  uint32_t seqs[Depth];
+  uint8_t head = 0;
+  uint8_t count = 0;
+};
+
+template<typename... Channels> class HidChannelList;
+
+template<>
+class HidChannelList<>
+{
+public:
+  typedef hid::Descriptor<> descriptor;
+  void create(HidTransport* transport) {}
+  void attach(BleConnectionStatus* status) {}
+  template<typename Full>
+  static constexpr bool matches() { return true; }
+protected:
+  void channelFor() {}
+  bool oldest(uint32_t* seq) { return false; }
+  bool sendSeq(uint32_t seq, HidQueueStats* stats) { return true; }
+};
+
+template<typename First, typename... Rest>
+class HidChannelList<First, Rest...> : public HidChannelList<Rest...>
+{
+  typedef HidChannelList<Rest...> Base;
+  First channel;
+public:
+  typedef hid::Descriptor<typename First::descriptor, typename Base::descriptor> descriptor;
+
+  void create(HidTransport* transport) {
+    this->channel.create(transport);
+    Base::create(transport);
+  }
+
+  void attach(BleConnectionStatus* status) {
+    this->channel.attach(status);
+    Base::attach(status);
+  }
+
+  template<typename Full>
+  static constexpr bool matches() {
+    return First::template matches<Full>() && Base::template matches<Full>();
+  }
+protected:
+  // Sequence number of the oldest report waiting in any channel
+  bool oldest(uint32_t* seq) {
+    bool found = Base::oldest(seq);
+    if (this->channel.pending() && (!found || (int32_t)(this->channel.headSeq() - *seq) < 0)){
+      *seq = this->channel.headSeq();
+      found = true;
+    }
+    return found;
+  }
+
+  bool sendSeq(uint32_t seq, HidQueueStats* stats) {
+    if (this->channel.pending() && this->channel.headSeq() == seq)
+      return this->channel.sendHead(stats);
+    return Base::sendSeq(seq, stats);
+  }
+
+  // Overload per report struct, so picking a channel is plain overload resolution
+  using Base::channelFor;
+  First& channelFor(const typename First::report_type*) { return this->channel; }
+};
+
+// The full set of reports of one HID service. The report map is the concatenation of the
+// channels' descriptors, and every report struct is checked against it when this is instantiated.
+// Adding a report type means adding one HidChannel to the list.
+//
+// Sent reports go through the channels' queues and leave in the order they were sent, as fast
+// as the stack takes them. While the stack signals congestion or refuses a notification the
+// rest stay queued until the next pump(). send() is false when the report's queue is full; the
+// caller waits for the link and tries again, or forces it in.
+template<typename... Channels>
+class HidReportMap : public HidChannelList<Channels...>
+{
+  typedef HidChannelList<Channels...> List;
+public:
+  typedef typename List::descriptor descriptor;
+  static_assert(List::template matches<descriptor>(), "A report struct does not match the HID report descriptor");
+
+  template<typename Report>
+  auto get() -> decltype(this->channelFor((const Report*)nullptr)) {
+    return this->channelFor((const Report*)nullptr);
+  }
+
+  void attach(BleConnectionStatus* status) {
+    this->status = status;
+    List::attach(status);
+  }
+
+  template<typename Report>
+  bool send(const Report* report, bool force = false) {
+    bool queued = this->channelFor(report).queue(report, this->seq++, &this->queueStats, force);
+    this->pump();
+    return queued;
+  }
+
+  void pump(void) {
+    uint32_t next;
+    while (this->oldest(&next)){
+      if (this->status != nullptr && this->status->congested){
+        this->queueStats.congested++;
+        return;
+      }
+      if (!this->sendSeq(next, &this->queueStats))
+        return;
+    }
+  }
+
+  uint16_t pending(void) const { return this->queueStats.depth; }
+  const HidQueueStats& stats(void) const { return this->queueStats; }
+private:
+  BleConnectionStatus* status = nullptr;
+  HidQueueStats queueStats;
+  uint32_t seq = 0;
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // ESP32_BLE_HID_CHANNEL_H
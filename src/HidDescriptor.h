@@ -0,0 +1,146 @@
+#ifndef ESP32_BLE_HID_DESCRIPTOR_H
+#define ESP32_BLE_HID_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compile-time HID report descriptor builder.
+//
+// A descriptor is written as a list of item types, e.g.
+//   typedef hid::Descriptor<hid::UsagePage<0x01>, hid::Usage<0x06>, ...> MyDescriptor;
+// and MyDescriptor::data is a constant byte array in flash, laid out exactly as the items say
+// (the size template argument picks the item's data length, so existing descriptors can be
+// reproduced byte for byte). Descriptors can be nested to compose several collections.
+//
+// hid::Report<MyDescriptor, Id> walks those bytes at compile time and gives the input, output
+// and feature bit lengths of one report ID, so report structs can be checked with
+//   static_assert(hid::Report<MyDescriptor, 1>::inputBits == sizeof(MyReport) * 8, "...");
+namespace hid {
+
+template<uint8_t... B>
+struct Bytes {
+  static constexpr size_t size = sizeof...(B);
+  static constexpr uint8_t data[sizeof...(B)] = {B...};
+};
+template<uint8_t... B> constexpr size_t Bytes<B...>::size;
+template<uint8_t... B> constexpr uint8_t Bytes<B...>::data[sizeof...(B)];
+
+template<>
+struct Bytes<> {
+  static constexpr size_t size = 0;
+  static constexpr const uint8_t* data = nullptr;
+};
+
+template<typename... T> struct Concat;
+template<> struct Concat<> {
+  typedef Bytes<> type;
+};
+template<uint8_t... A> struct Concat<Bytes<A...>> {
+  typedef Bytes<A...> type;
+};
+template<uint8_t... A, uint8_t... B, typename... Rest> struct Concat<Bytes<A...>, Bytes<B...>, Rest...> {
+  typedef typename Concat<Bytes<A..., B...>, Rest...>::type type;
+};
+
+// Short item encoding: prefix byte (tag | type | size code) followed by 0, 1, 2 or 4 data bytes
+template<uint8_t Prefix, uint8_t Size, int32_t Value> struct Encode;
+template<uint8_t Prefix, int32_t Value> struct Encode<Prefix, 0, Value> {
+  typedef Bytes<Prefix> type;
+};
+template<uint8_t Prefix, int32_t Value> struct Encode<Prefix, 1, Value> {
+  typedef Bytes<uint8_t(Prefix | 1), uint8_t(Value)> type;
+};
+template<uint8_t Prefix, int32_t Value> struct Encode<Prefix, 2, Value> {
+  typedef Bytes<uint8_t(Prefix | 2), uint8_t(Value), uint8_t(Value >> 8)> type;
+};
+template<uint8_t Prefix, int32_t Value> struct Encode<Prefix, 4, Value> {
+  typedef Bytes<uint8_t(Prefix | 3), uint8_t(Value), uint8_t(Value >> 8), uint8_t(Value >> 16), uint8_t(Value >> 24)> type;
+};
+
+template<uint8_t Prefix, uint8_t Size, int32_t Value>
+struct Item {
+  typedef typename Encode<Prefix, Size, Value>::type bytes;
+};
+
+template<typename... Items>
+struct Descriptor {
+  typedef typename Concat<typename Items::bytes...>::type bytes;
+  static constexpr size_t size = bytes::size;
+  static constexpr const uint8_t* data = bytes::data;
+};
+template<typename... Items> constexpr size_t Descriptor<Items...>::size;
+template<typename... Items> constexpr const uint8_t* Descriptor<Items...>::data;
+
+// Item prefixes with the size bits cleared
+const uint8_t ITEM_INPUT = 0x80;
+const uint8_t ITEM_OUTPUT = 0x90;
+const uint8_t ITEM_FEATURE = 0xB0;
+const uint8_t ITEM_COLLECTION = 0xA0;
+const uint8_t ITEM_END_COLLECTION = 0xC0;
+const uint8_t ITEM_USAGE_PAGE = 0x04;
+const uint8_t ITEM_LOGICAL_MINIMUM = 0x14;
+const uint8_t ITEM_LOGICAL_MAXIMUM = 0x24;
+const uint8_t ITEM_PHYSICAL_MINIMUM = 0x34;
+const uint8_t ITEM_PHYSICAL_MAXIMUM = 0x44;
+const uint8_t ITEM_UNIT_EXPONENT = 0x54;
+const uint8_t ITEM_UNIT = 0x64;
+const uint8_t ITEM_REPORT_SIZE = 0x74;
+const uint8_t ITEM_REPORT_ID = 0x84;
+const uint8_t ITEM_REPORT_COUNT = 0x94;
+const uint8_t ITEM_USAGE = 0x08;
+const uint8_t ITEM_USAGE_MINIMUM = 0x18;
+const uint8_t ITEM_USAGE_MAXIMUM = 0x28;
+
+// Main items
+template<int32_t Flags, uint8_t Size = 1> using Input = Item<ITEM_INPUT, Size, Flags>;
+template<int32_t Flags, uint8_t Size = 1> using Output = Item<ITEM_OUTPUT, Size, Flags>;
+template<int32_t Flags, uint8_t Size = 1> using Feature = Item<ITEM_FEATURE, Size, Flags>;
+template<int32_t Type, uint8_t Size = 1> using Collection = Item<ITEM_COLLECTION, Size, Type>;
+using EndCollection = Item<ITEM_END_COLLECTION, 0, 0>;
+// Global items
+template<int32_t Value, uint8_t Size = 1> using UsagePage = Item<ITEM_USAGE_PAGE, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using LogicalMinimum = Item<ITEM_LOGICAL_MINIMUM, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using LogicalMaximum = Item<ITEM_LOGICAL_MAXIMUM, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using PhysicalMinimum = Item<ITEM_PHYSICAL_MINIMUM, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using PhysicalMaximum = Item<ITEM_PHYSICAL_MAXIMUM, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using UnitExponent = Item<ITEM_UNIT_EXPONENT, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using Unit = Item<ITEM_UNIT, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using ReportSize = Item<ITEM_REPORT_SIZE, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using ReportId = Item<ITEM_REPORT_ID, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using ReportCount = Item<ITEM_REPORT_COUNT, Size, Value>;
+// Local items
+template<int32_t Value, uint8_t Size = 1> using Usage = Item<ITEM_USAGE, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using UsageMinimum = Item<ITEM_USAGE_MINIMUM, Size, Value>;
+template<int32_t Value, uint8_t Size = 1> using UsageMaximum = Item<ITEM_USAGE_MAXIMUM, Size, Value>;
+
+// Descriptor parsing, all constexpr (C++11 style: single-expression recursion over the items)
+constexpr size_t itemDataSize(uint8_t prefix) {
+  return (prefix & 0x03) == 0x03 ? 4 : (prefix & 0x03);
+}
+
+constexpr uint32_t itemValue(const uint8_t* d, size_t n) {
+  return n == 0 ? 0 : (uint32_t(d[n - 1]) << (8 * (n - 1))) | itemValue(d, n - 1);
+}
+
+// Sum of REPORT_SIZE * REPORT_COUNT over every main item of one kind (input/output/feature)
+// that belongs to the given report ID. Global state (report ID, size, count) is carried along.
+constexpr uint32_t reportBits(const uint8_t* d, size_t len, uint8_t kind, uint8_t id,
+                              size_t pos = 0, uint8_t currentId = 0, uint32_t size = 0, uint32_t count = 0) {
+  return pos >= len ? 0 :
+    (((d[pos] & 0xFC) == kind && currentId == id) ? size * count : 0) +
+    reportBits(d, len, kind, id, pos + 1 + itemDataSize(d[pos]),
+               (d[pos] & 0xFC) == ITEM_REPORT_ID ? uint8_t(itemValue(d + pos + 1, itemDataSize(d[pos]))) : currentId,
+               (d[pos] & 0xFC) == ITEM_REPORT_SIZE ? itemValue(d + pos + 1, itemDataSize(d[pos])) : size,
+               (d[pos] & 0xFC) == ITEM_REPORT_COUNT ? itemValue(d + pos + 1, itemDataSize(d[pos])) : count);
+}
+
+template<typename D, uint8_t Id>
+struct Report {
+  static constexpr uint32_t inputBits = reportBits(D::data, D::size, ITEM_INPUT, Id);
+  static constexpr uint32_t outputBits = reportBits(D::data, D::size, ITEM_OUTPUT, Id);
+  static constexpr uint32_t featureBits = reportBits(D::data, D::size, ITEM_FEATURE, Id);
+};
+
+} // namespace hid
+
+#endif // ESP32_BLE_HID_DESCRIPTOR_H
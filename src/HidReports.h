@@ -0,0 +1,405 @@
+#ifndef ESP32_BLE_HID_REPORTS_H
+#define ESP32_BLE_HID_REPORTS_H
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "HidDescriptor.h"
+#include "HidChannel.h"
+
+// Report IDs:
+#define KEYBOARD_ID 0x01
+#define MEDIA_KEYS_ID 0x02
+#define RADIAL_ID 0x03
+#define RADIAL_HAPTIC_ID 0x04
+#define WHEEL_ID 0x05
+
+#define WHEEL_RESOLUTION 8 //Wheel units per notch once the host enables the resolution multiplier
+
+
+typedef uint8_t MediaKeyReport[2];
+
+//  Low level key report: up to 6 keys and shift, ctrl etc at once
+typedef struct
+{
+  uint8_t modifiers;
+  uint8_t reserved;
+  uint8_t keys[6];
+} KeyReport;
+
+// Keyboard LEDs (num lock, caps lock, ...) written by the host
+typedef struct
+{
+  uint8_t leds;
+} KeyboardLedReport;
+
+
+// Report for the Surface Dial wheel
+struct RadialReport
+{
+    uint8_t button : 8;
+    uint16_t rotation : 16;
+    uint8_t vala : 8;
+    uint8_t valb : 8;
+    uint8_t valc : 8;
+    uint8_t vald : 8;
+    uint8_t vale : 8;
+
+} __attribute__((packed));
+
+// Rotation is relative, so queued dial reports merge by summing it. A button change always
+// stays a separate report, so a short click still reaches the host.
+inline bool hidCoalesce(RadialReport* waiting, const RadialReport* next, bool full) {
+  if (waiting->button != next->button)
+    return false;
+  int32_t rotation = (int16_t)waiting->rotation + (int16_t)next->rotation;
+  *waiting = *next;
+  waiting->rotation = rotation > 32767 ? 32767 : rotation < -32767 ? -32767 : rotation;
+  return true;
+}
+
+// Mouse report carrying the dial as a vertical wheel or AC Pan. Buttons and X/Y are never
+// set; Windows only applies the resolution multiplier to a complete mouse collection.
+struct WheelReport {
+  uint8_t buttons;
+  int8_t x;
+  int8_t y;
+  int8_t wheel;
+  int8_t pan;
+} __attribute__((packed));
+
+// Wheel and pan are relative, so queued reports merge by summing them, unless the sum no
+// longer fits a report; then the next one queues on its own rather than lose the excess
+inline bool hidCoalesce(WheelReport* waiting, const WheelReport* next, bool full) {
+  int wheel = waiting->wheel + next->wheel;
+  int pan = waiting->pan + next->pan;
+  if (wheel > 127 || wheel < -127 || pan > 127 || pan < -127)
+    return false;
+  *waiting = *next;
+  waiting->wheel = wheel;
+  waiting->pan = pan;
+  return true;
+}
+
+// Resolution multipliers written by the host: 1 turns each wheel unit into 1/WHEEL_RESOLUTION
+// of a notch
+struct WheelFeatureReport {
+  uint8_t wheel_multiplier : 2;
+  uint8_t pan_multiplier : 2;
+  uint8_t padding : 4;
+} __attribute__((packed));
+
+// Feature report for the Surface Dial wheel (written by the host)
+struct RadialFeatureReport {
+  uint16_t vibration_amount : 16; // Resolution Multiplier
+  uint8_t blank : 8;              // Repeat Count
+  uint8_t enabled : 1;            // Auto Trigger
+  uint8_t flags : 7;
+  uint8_t waveform_cutoff : 8;
+  uint16_t retrigger_period : 16;
+  
+} __attribute__((packed));
+
+// Output report for the Surface Dial haptics
+struct RadialOutputReport {
+  uint8_t repeat_count : 8;
+  uint8_t manual_trigger : 8;
+  uint16_t retrigger_period : 16;
+
+} __attribute__((packed));
+
+// Haptic feature report: auto trigger control, then duration and waveform ordinals
+struct RadialHapticFeatureReport {
+  uint32_t auto_trigger_control : 32;
+  uint8_t durations[3];
+  uint8_t waveforms[3];
+
+} __attribute__((packed));
+
+
+typedef hid::Descriptor<
+  hid::UsagePage<0x01>,               // USAGE_PAGE (Generic Desktop Ctrls)
+  hid::Usage<0x06>,                   // USAGE (Keyboard)
+  hid::Collection<0x01>,              // COLLECTION (Application)
+  hid::ReportId<KEYBOARD_ID>,         //   REPORT_ID (KEYBOARD_ID)
+  hid::UsagePage<0x07>,               //   USAGE_PAGE (Kbrd/Keypad)
+  hid::UsageMinimum<0xE0>,            //   USAGE_MINIMUM (0xE0)
+  hid::UsageMaximum<0xE7>,            //   USAGE_MAXIMUM (0xE7)
+  hid::LogicalMinimum<0>,             //   LOGICAL_MINIMUM (0)
+  hid::LogicalMaximum<1>,             //   Logical Maximum (1)
+  hid::ReportSize<1>,                 //   REPORT_SIZE (1)
+  hid::ReportCount<8>,                //   REPORT_COUNT (8)
+  hid::Input<0x02>,                   //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  hid::ReportCount<1>,                //   REPORT_COUNT (1) ; 1 byte (Reserved)
+  hid::ReportSize<8>,                 //   REPORT_SIZE (8)
+  hid::Input<0x01>,                   //   INPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  hid::ReportCount<5>,                //   REPORT_COUNT (5) ; 5 bits (Num lock, Caps lock, Scroll lock, Compose, Kana)
+  hid::ReportSize<1>,                 //   REPORT_SIZE (1)
+  hid::UsagePage<0x08>,               //   USAGE_PAGE (LEDs)
+  hid::UsageMinimum<0x01>,            //   USAGE_MINIMUM (0x01) ; Num Lock
+  hid::UsageMaximum<0x05>,            //   USAGE_MAXIMUM (0x05) ; Kana
+  hid::Output<0x02>,                  //   OUTPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+  hid::ReportCount<1>,                //   REPORT_COUNT (1) ; 3 bits (Padding)
+  hid::ReportSize<3>,                 //   REPORT_SIZE (3)
+  hid::Output<0x01>,                  //   OUTPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+  hid::ReportCount<6>,                //   REPORT_COUNT (6) ; 6 bytes (Keys)
+  hid::ReportSize<8>,                 //   REPORT_SIZE(8)
+  hid::LogicalMinimum<0>,             //   LOGICAL_MINIMUM(0)
+  hid::LogicalMaximum<0x65>,          //   LOGICAL_MAXIMUM(0x65) ; 101 keys
+  hid::UsagePage<0x07>,               //   USAGE_PAGE (Kbrd/Keypad)
+  hid::UsageMinimum<0x00>,            //   USAGE_MINIMUM (0)
+  hid::UsageMaximum<0x65>,            //   USAGE_MAXIMUM (0x65)
+  hid::Input<0x00>,                   //   INPUT (Data,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  hid::EndCollection                  // END_COLLECTION
+> KeyboardDescriptor;
+
+typedef hid::Descriptor<
+  hid::UsagePage<0x0C>,               // USAGE_PAGE (Consumer)
+  hid::Usage<0x01>,                   // USAGE (Consumer Control)
+  hid::Collection<0x01>,              // COLLECTION (Application)
+  hid::ReportId<MEDIA_KEYS_ID>,       //   REPORT_ID (MEDIA_KEYS_ID)
+  hid::UsagePage<0x0C>,               //   USAGE_PAGE (Consumer)
+  hid::LogicalMinimum<0>,             //   LOGICAL_MINIMUM (0)
+  hid::LogicalMaximum<1>,             //   LOGICAL_MAXIMUM (1)
+  hid::ReportSize<1>,                 //   REPORT_SIZE (1)
+  hid::ReportCount<16>,               //   REPORT_COUNT (16)
+  hid::Usage<0xB5>,                   //   USAGE (Scan Next Track)     ; bit 0:
+  hid::Usage<0xB6>,                   //   USAGE (Scan Previous Track) ; bit 1:
+  hid::Usage<0xB7>,                   //   USAGE (Stop)                ; bit 2:
+  hid::Usage<0xCD>,                   //   USAGE (Play/Pause)          ; bit 3:
+  hid::Usage<0xE2>,                   //   USAGE (Mute)                ; bit 4:
+  hid::Usage<0xE9>,                   //   USAGE (Volume Increment)    ; bit 5:
+  hid::Usage<0xEA>,                   //   USAGE (Volume Decrement)    ; bit 6:
+  hid::Usage<0x0223, 2>,              //   Usage (WWW Home)            ; bit 7:
+  hid::Usage<0x0194, 2>,              //   Usage (My Computer) ; bit 0:
+  hid::Usage<0x0192, 2>,              //   Usage (Calculator)  ; bit 1:
+  hid::Usage<0x022A, 2>,              //   Usage (WWW fav)     ; bit 2:
+  hid::Usage<0x0221, 2>,              //   Usage (WWW search)  ; bit 3:
+  hid::Usage<0x0226, 2>,              //   Usage (WWW stop)    ; bit 4:
+  hid::Usage<0x0224, 2>,              //   Usage (WWW back)    ; bit 5:
+  hid::Usage<0x0183, 2>,              //   Usage (Media sel)   ; bit 6:
+  hid::Usage<0x018A, 2>,              //   Usage (Mail)        ; bit 7:
+  hid::Input<0x02>,                   //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  hid::EndCollection                  // END_COLLECTION
+> MediaKeysDescriptor;
+
+typedef hid::Descriptor<
+  hid::UsagePage<0x01>,               // Usage Page (Generic Desktop)
+  hid::Usage<0x0E>,                   // Usage (System Multi-Axis Controller)
+  hid::Collection<0x01>,              // Collection (Application)
+  hid::ReportId<RADIAL_ID>,           //  Report ID (RADIAL_ID)
+  hid::UsagePage<0x0D>,               //  Usage Page (Digitizers)
+  hid::Usage<0x21>,                   //  Usage (Puck)
+
+  hid::Collection<0x02>,              //  Collection (Logical)
+  hid::LogicalMinimum<0>,             //   Logical Minimum (0)
+  hid::LogicalMaximum<1>,             //   Logical Maximum (1)
+  hid::ReportSize<1>,                 //   Report Size (1)
+  hid::ReportCount<1>,                //   Report Count (1)
+  hid::Collection<0x00>,              //   Collection (Physical)
+  hid::UsagePage<0x09>,               //    Usage Page (Button)
+  hid::Usage<0x01>,                   //    Usage (Vendor Usage 0x01)
+  hid::Input<0x02>,                   //    Input (Data,Var,Abs)
+  hid::UsagePage<0x0D>,               //    Usage Page (Digitizers)
+  hid::Usage<0x33>,                   //    Usage (Touch)
+  hid::Input<0x02>,                   //    Input (Data,Var,Abs)
+  hid::ReportCount<6>,                //    Report Count (6)
+  hid::Input<0x03>,                   //    Input (Cnst,Var,Abs)
+  hid::Collection<0x02>,              //    Collection (Logical)
+  hid::UsagePage<0x01>,               //     Usage Page (Generic Desktop)
+  hid::Usage<0x37>,                   //     Usage (Dial)
+  hid::LogicalMinimum<-32767, 2>,     //     Logical Minimum (-32767)
+  hid::LogicalMaximum<32767, 2>,      //     Logical Maximum (32767)
+  hid::ReportSize<16>,                //     Report Size (16)
+  hid::ReportCount<1>,                //     Report Count (1)
+  hid::Input<0x06>,                   //     Input (Data,Var,Rel)
+  hid::PhysicalMinimum<0>,            //     Physical Minimum (0)
+  hid::PhysicalMaximum<3600, 2>,      //     Physical Maximum (3600)
+  hid::LogicalMinimum<0>,             //     Logical Minimum (0)
+  hid::LogicalMaximum<3600, 2>,       //     Logical Maximum (3600)
+  hid::Usage<0x48>,                   //     Usage (Resolution Multiplier)
+  hid::Feature<0x02>,                 //     Feature (Data,Var,Abs)
+  hid::PhysicalMaximum<0>,            //     Physical Maximum (0)
+  hid::EndCollection,                 //    End Collection
+
+  hid::UnitExponent<0x0E>,            //    Unit Exponent (-2)
+  hid::Unit<0x11>,                    //    Unit (Centimeter,SILinear)
+  hid::PhysicalMaximum<0, 2>,         //    Physical Maximum (0)
+  hid::LogicalMaximum<0, 2>,          //    Logical Maximum (0)
+  hid::Usage<0x30>,                   //    Usage (X)
+  hid::Input<0x42>,                   //    Input (Data,Var,Abs,Null)
+  hid::Usage<0x31>,                   //    Usage (Y)
+  hid::PhysicalMaximum<0, 2>,         //    Physical Maximum (0)
+  hid::LogicalMaximum<0, 2>,          //    Logical Maximum (0)
+  hid::Input<0x42>,                   //    Input (Data,Var,Abs,Null)
+  hid::UsagePage<0x0D>,               //    Usage Page (Digitizers)
+  hid::Usage<0x48>,                   //    Usage (Width)
+  hid::LogicalMinimum<58>,            //    Logical Minimum (58)
+  hid::LogicalMaximum<58>,            //    Logical Maximum (58)
+  hid::ReportSize<8>,                 //    Report Size (8)
+  hid::UnitExponent<0x0F>,            //    Unit Exponent (-1)
+  hid::PhysicalMinimum<58>,           //    Physical Minimum (58)
+  hid::PhysicalMaximum<58>,           //    Physical Maximum (58)
+  hid::Input<0x03>,                   //    Input (Cnst,Var,Abs)
+  hid::UnitExponent<0x00>,            //    Unit Exponent (0)
+  hid::Unit<0x00>,                    //    Unit (None)
+  hid::PhysicalMinimum<0>,            //    Physical Minimum (0)
+  hid::PhysicalMaximum<0>,            //    Physical Maximum (0)
+
+  hid::UsagePage<0x0E>,               //    Usage Page (Haptic)
+  hid::Usage<0x01>,                   //    Usage (Simple Haptic Controller)
+  hid::Collection<0x02>,              //    Collection (Logical)
+  hid::LogicalMinimum<0>,             //     Logical Minimum (0)
+  hid::LogicalMaximum<255, 2>,        //     Logical Maximum (255)
+  hid::Usage<0x24>,                   //     Usage (Repeat Count)
+  hid::Feature<0x42>,                 //     Feature (Data,Var,Abs,Null)
+  hid::Usage<0x24>,                   //     Usage (Repeat Count)
+  hid::Output<0x42>,                  //     Output (Data,Var,Abs,Null)
+  hid::LogicalMinimum<1>,             //     Logical Minimum (1)
+  hid::LogicalMaximum<7>,             //     Logical Maximum (7)
+  hid::Usage<0x20>,                   //     Usage (Auto Trigger)
+  hid::Feature<0x42>,                 //     Feature (Data,Var,Abs,Null)
+  hid::Usage<0x21>,                   //     Usage (Manual Trigger)
+  hid::Output<0x42>,                  //     Output (Data,Var,Abs,Null)
+  hid::LogicalMaximum<10>,            //     Logical Maximum (10)
+  hid::Usage<0x28>,                   //     Usage (Waveform Cutoff Time)
+  hid::Feature<0x42>,                 //     Feature (Data,Var,Abs,Null)
+  hid::ReportSize<16>,                //     Report Size (16)
+  hid::LogicalMaximum<2000, 2>,       //     Logical Maximum (2000)
+  hid::Usage<0x25>,                   //     Usage (Retrigger Period)
+  hid::Feature<0x42>,                 //     Feature (Data,Var,Abs,Null)
+  hid::Usage<0x25>,                   //     Usage (Retrigger Period)
+  hid::Output<0x42>,                  //     Output (Data,Var,Abs,Null)
+  hid::ReportId<RADIAL_HAPTIC_ID>,    //     Report ID (RADIAL_HAPTIC_ID)
+  hid::ReportSize<32>,                //     Report Size (32)
+  hid::LogicalMinimum<65591, 4>,      //     Logical Minimum (65591)
+  hid::LogicalMaximum<65591, 4>,      //     Logical Maximum (65591)
+  hid::Usage<0x22>,                   //     Usage (Auto Trigger Associated Control)
+  hid::Feature<0x02>,                 //     Feature (Data,Var,Abs)
+  hid::Usage<0x11>,                   //     Usage (Duration)
+  hid::Collection<0x02>,              //     Collection (Logical)
+  hid::UsagePage<0x0A>,               //      Usage Page (Ordinals)
+  hid::ReportCount<3>,                //      Report Count (3)
+  hid::Usage<0x03>,                   //      Usage (Vendor Usage 0x03)
+  hid::Usage<0x04>,                   //      Usage (Vendor Usage 0x04)
+  hid::Usage<0x05>,                   //      Usage (Vendor Usage 0x05)
+  hid::ReportSize<8>,                 //      Report Size (8)
+  hid::LogicalMinimum<0>,             //      Logical Minimum (0)
+  hid::LogicalMaximum<0xFF>,          //      Logical Maximum (255)
+  hid::Feature<0x02>,                 //      Feature (Data,Var,Abs)
+  hid::EndCollection,                 //     End Collection
+  hid::UsagePage<0x0E>,               //     Usage Page (Haptic)
+  hid::Usage<0x10>,                   //     Usage (Waveform)
+  hid::Collection<0x02>,              //     Collection (Logical)
+  hid::UsagePage<0x0A>,               //      Usage Page (Ordinals)
+  hid::ReportCount<1>,                //      Report Count (1)
+  hid::LogicalMinimum<3>,             //      Logical Minimum (3)
+  hid::LogicalMaximum<3>,             //      Logical Maximum (3)
+  hid::PhysicalMinimum<4099, 2>,      //      Physical Minimum (4099)
+  hid::PhysicalMaximum<4099, 2>,      //      Physical Maximum (4099)
+  hid::Usage<0x03>,                   //      Usage (Vendor Usage 0x03)
+  hid::Feature<0x02>,                 //      Feature (Data,Var,Abs)
+  hid::LogicalMinimum<4>,             //      Logical Minimum (4)
+  hid::LogicalMaximum<4>,             //      Logical Maximum (4)
+  hid::PhysicalMinimum<4100, 2>,      //      Physical Minimum (4100)
+  hid::PhysicalMaximum<4100, 2>,      //      Physical Maximum (4100)
+  hid::Usage<0x04>,                   //      Usage (Vendor Usage 0x04)
+  hid::Feature<0x02>,                 //      Feature (Data,Var,Abs)
+  hid::LogicalMinimum<5>,             //      Logical Minimum (5)
+  hid::LogicalMaximum<5>,             //      Logical Maximum (5)
+  hid::PhysicalMinimum<4100, 2>,      //      Physical Minimum (4100)
+  hid::PhysicalMaximum<4100, 2>,      //      Physical Maximum (4100)
+  hid::Usage<0x05>,                   //      Usage (Vendor Usage 0x05)
+  hid::Feature<0x02>,                 //      Feature (Data,Var,Abs)
+  hid::PhysicalMinimum<0>,            //      Physical Minimum (0)
+  hid::PhysicalMaximum<0>,            //      Physical Maximum (0)
+  hid::EndCollection,                 //     End Collection
+  hid::EndCollection,                 //    End Collection
+  hid::EndCollection,                 //   End Collection
+  hid::EndCollection,                 //  End Collection
+  hid::EndCollection                  // End Collection
+> RadialDescriptor;
+
+typedef hid::Descriptor<
+  hid::UsagePage<0x01>,               // USAGE_PAGE (Generic Desktop)
+  hid::Usage<0x02>,                   // USAGE (Mouse)
+  hid::Collection<0x01>,              // COLLECTION (Application)
+  hid::ReportId<WHEEL_ID>,            //  REPORT_ID (WHEEL_ID)
+  hid::Usage<0x01>,                   //  USAGE (Pointer)
+  hid::Collection<0x00>,              //  COLLECTION (Physical)
+  hid::UsagePage<0x09>,               //   USAGE_PAGE (Button)
+  hid::UsageMinimum<0x01>,            //   USAGE_MINIMUM (Button 1)
+  hid::UsageMaximum<0x03>,            //   USAGE_MAXIMUM (Button 3)
+  hid::LogicalMinimum<0>,             //   LOGICAL_MINIMUM (0)
+  hid::LogicalMaximum<1>,             //   LOGICAL_MAXIMUM (1)
+  hid::ReportSize<1>,                 //   REPORT_SIZE (1)
+  hid::ReportCount<3>,                //   REPORT_COUNT (3)
+  hid::Input<0x02>,                   //   INPUT (Data,Var,Abs)
+  hid::ReportSize<5>,                 //   REPORT_SIZE (5)
+  hid::ReportCount<1>,                //   REPORT_COUNT (1)
+  hid::Input<0x03>,                   //   INPUT (Cnst,Var,Abs)
+  hid::UsagePage<0x01>,               //   USAGE_PAGE (Generic Desktop)
+  hid::Usage<0x30>,                   //   USAGE (X)
+  hid::Usage<0x31>,                   //   USAGE (Y)
+  hid::LogicalMinimum<-127>,          //   LOGICAL_MINIMUM (-127)
+  hid::LogicalMaximum<127>,           //   LOGICAL_MAXIMUM (127)
+  hid::ReportSize<8>,                 //   REPORT_SIZE (8)
+  hid::ReportCount<2>,                //   REPORT_COUNT (2)
+  hid::Input<0x06>,                   //   INPUT (Data,Var,Rel)
+
+  hid::Collection<0x02>,              //   COLLECTION (Logical)
+  hid::Usage<0x48>,                   //    USAGE (Resolution Multiplier)
+  hid::LogicalMinimum<0>,             //    LOGICAL_MINIMUM (0)
+  hid::LogicalMaximum<1>,             //    LOGICAL_MAXIMUM (1)
+  hid::PhysicalMinimum<1>,            //    PHYSICAL_MINIMUM (1)
+  hid::PhysicalMaximum<WHEEL_RESOLUTION>, //    PHYSICAL_MAXIMUM (WHEEL_RESOLUTION)
+  hid::ReportSize<2>,                 //    REPORT_SIZE (2)
+  hid::ReportCount<1>,                //    REPORT_COUNT (1)
+  hid::Feature<0x02>,                 //    FEATURE (Data,Var,Abs)
+  hid::Usage<0x38>,                   //    USAGE (Wheel)
+  hid::LogicalMinimum<-127>,          //    LOGICAL_MINIMUM (-127)
+  hid::LogicalMaximum<127>,           //    LOGICAL_MAXIMUM (127)
+  hid::PhysicalMinimum<0>,            //    PHYSICAL_MINIMUM (0)
+  hid::PhysicalMaximum<0>,            //    PHYSICAL_MAXIMUM (0)
+  hid::ReportSize<8>,                 //    REPORT_SIZE (8)
+  hid::Input<0x06>,                   //    INPUT (Data,Var,Rel)
+  hid::EndCollection,                 //   END_COLLECTION
+
+  hid::Collection<0x02>,              //   COLLECTION (Logical)
+  hid::Usage<0x48>,                   //    USAGE (Resolution Multiplier)
+  hid::LogicalMinimum<0>,             //    LOGICAL_MINIMUM (0)
+  hid::LogicalMaximum<1>,             //    LOGICAL_MAXIMUM (1)
+  hid::PhysicalMinimum<1>,            //    PHYSICAL_MINIMUM (1)
+  hid::PhysicalMaximum<WHEEL_RESOLUTION>, //    PHYSICAL_MAXIMUM (WHEEL_RESOLUTION)
+  hid::ReportSize<2>,                 //    REPORT_SIZE (2)
+  hid::Feature<0x02>,                 //    FEATURE (Data,Var,Abs)
+  hid::PhysicalMinimum<0>,            //    PHYSICAL_MINIMUM (0)
+  hid::PhysicalMaximum<0>,            //    PHYSICAL_MAXIMUM (0)
+  hid::ReportSize<4>,                 //    REPORT_SIZE (4)
+  hid::Feature<0x03>,                 //    FEATURE (Cnst,Var,Abs)
+  hid::UsagePage<0x0C>,               //    USAGE_PAGE (Consumer)
+  hid::Usage<0x0238, 2>,              //    USAGE (AC Pan)
+  hid::LogicalMinimum<-127>,          //    LOGICAL_MINIMUM (-127)
+  hid::LogicalMaximum<127>,           //    LOGICAL_MAXIMUM (127)
+  hid::ReportSize<8>,                 //    REPORT_SIZE (8)
+  hid::Input<0x06>,                   //    INPUT (Data,Var,Rel)
+  hid::EndCollection,                 //   END_COLLECTION
+  hid::EndCollection,                 //  END_COLLECTION
+  hid::EndCollection                  // END_COLLECTION
+> WheelDescriptor;
+
+
+// Every report of the pad's HID service
+typedef HidReportMap<
+  HidChannel<KeyReport, KEYBOARD_ID, HID_INPUT_REPORT, KeyboardDescriptor>,
+  HidChannel<KeyboardLedReport, KEYBOARD_ID, HID_OUTPUT_REPORT>,
+  HidChannel<MediaKeyReport, MEDIA_KEYS_ID, HID_INPUT_REPORT, MediaKeysDescriptor>,
+  HidChannel<RadialReport, RADIAL_ID, HID_INPUT_REPORT, RadialDescriptor>,
+  HidChannel<RadialFeatureReport, RADIAL_ID, HID_FEATURE_REPORT>,
+  HidChannel<RadialOutputReport, RADIAL_ID, HID_OUTPUT_REPORT>,
+  HidChannel<RadialHapticFeatureReport, RADIAL_HAPTIC_ID, HID_FEATURE_REPORT>,
+  HidChannel<WheelReport, WHEEL_ID, HID_INPUT_REPORT, WheelDescriptor>,
+  HidChannel<WheelFeatureReport, WHEEL_ID, HID_FEATURE_REPORT>
+> BleKeyboardChannels;
+
+#endif // CONFIG_BT_ENABLED
+#endif // ESP32_BLE_HID_REPORTS_H
@@ -0,0 +1,88 @@
+#ifndef ESP32_BLE_HID_TRANSPORT_H
+#define ESP32_BLE_HID_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ReconnectManager.h"
+
+// Which BLE stack the firmware is built on; platformio.ini sets one per environment:
+//   BLE_TRANSPORT_BLUEDROID  the Arduino core's Bluedroid BLE library (default)
+//   BLE_TRANSPORT_NIMBLE     NimBLE-Arduino, a smaller host with the same controller
+//   BLE_TRANSPORT_LOOPBACK   no radio; reports are written to a stdio stream
+#if !defined(BLE_TRANSPORT_NIMBLE) && !defined(BLE_TRANSPORT_LOOPBACK)
+#define BLE_TRANSPORT_BLUEDROID
+#endif
+
+#define TRANSPORT_MAX_ATTRIBUTES 16 //HID reports plus vendor characteristics one transport can hold
+#define TRANSPORT_NO_HANDLE 0xFF
+
+// Properties of a vendor characteristic
+#define TRANSPORT_READ 0x01
+#define TRANSPORT_WRITE 0x02
+#define TRANSPORT_WRITE_NR 0x04
+#define TRANSPORT_NOTIFY 0x08
+#define TRANSPORT_ENCRYPTED 0x10 //Writes need an encrypted link, so only a bonded host can make them
+
+enum HidReportType {
+  HID_INPUT_REPORT,
+  HID_OUTPUT_REPORT,
+  HID_FEATURE_REPORT
+};
+
+// What the HID service says about the device
+struct HidDeviceInfo {
+  const char* name;
+  const char* manufacturer;
+  const uint8_t* reportMap;
+  uint16_t reportMapSize;
+  uint16_t vendorId;   // PnP ID, with the vendor ID taken from the USB range
+  uint16_t productId;
+  uint16_t version;
+  uint8_t batteryLevel;
+};
+
+// Receives what the host writes to one characteristic. Runs in the stack's task.
+class TransportWriter {
+public:
+  virtual ~TransportWriter() {}
+  virtual void onWrite(const uint8_t* data, size_t len) = 0;
+};
+
+class BleConnectionStatus;
+
+// The BLE stack under BleKeyboard: builds the HID service and any vendor services, notifies
+// reports, and passes connection, CCCD and write events up. Attributes are numbered by handles
+// the transport hands out in the order they are added. Connection events go to the
+// BleConnectionStatus given to begin(); writes go to the attribute's TransportWriter.
+//
+// Setup order: begin(), addReport() for every report, start(), then any vendor services with
+// beginService() / addCharacteristic() / endService().
+class HidTransport {
+public:
+  virtual ~HidTransport() {}
+  virtual void begin(const HidDeviceInfo& info, BleConnectionStatus* status) = 0; // Stack up, bonding on
+  virtual uint8_t addReport(uint8_t id, HidReportType type) = 0;
+  virtual void start() = 0;                                       // HID service up; advertising is left to ReconnectManager
+  virtual void beginService(const char* uuid) = 0;
+  virtual uint8_t addCharacteristic(const char* uuid, uint8_t properties) = 0;
+  virtual void endService() = 0;
+  virtual AdvertisingBackend* advertising() = 0;                  // Valid after start()
+  virtual bool notify(uint8_t handle, const uint8_t* data, size_t len) = 0; // False if the stack refused it
+  virtual void setValue(uint8_t handle, const uint8_t* data, size_t len) = 0; // What the host reads
+  virtual void setSubscribed(uint8_t handle, bool on) {}          // Restores a bonded host's CCCD where the stack doesn't
+  virtual void setBatteryLevel(uint8_t level) = 0;
+  virtual void disconnect() = 0;                                  // Drops the link to the host, if any
+  virtual int bonds() = 0;                                        // Hosts the stack keeps keys for
+  void setWriter(uint8_t handle, TransportWriter* writer) {
+    if (handle < TRANSPORT_MAX_ATTRIBUTES) this->writers[handle] = writer;
+  }
+protected:
+  void written(uint8_t handle, const uint8_t* data, size_t len) {
+    if (handle < TRANSPORT_MAX_ATTRIBUTES && this->writers[handle] != nullptr)
+      this->writers[handle]->onWrite(data, len);
+  }
+private:
+  TransportWriter* writers[TRANSPORT_MAX_ATTRIBUTES] = {};
+};
+
+#endif // ESP32_BLE_HID_TRANSPORT_H
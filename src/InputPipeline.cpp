@@ -0,0 +1,239 @@
+#include "InputPipeline.h"
+#include "matrix.h"
+#include "keymap.h"
+#include "MonotonicClock.h"
+
+// Every key of the pad can be bound as a dual-role key, chord member or dial mode key
+static_assert(PadMatrix::keys <= KEY_BEHAVIOR_KEYS, "Raise KEY_BEHAVIOR_KEYS and widen KeyMask for this matrix");
+static_assert(PadMatrix::keys <= DIAL_MODE_MATRIX_KEYS, "Raise DIAL_MODE_MATRIX_KEYS for this matrix");
+
+InputPipeline::InputPipeline(BleKeyboard* keyboard, TimerWheel* timers, HapticBackend* haptics)
+  : gestures(this), behaviors(this), update_timer(this), vibe_timer(this) {
+  this->keyboard = keyboard;
+  this->timers = timers;
+  this->haptics = haptics;
+  this->behaviors.configure();
+  this->dial_modes.configure();
+}
+
+void InputPipeline::key(int k, int event, uint32_t now){
+  this->now = now;
+  // Mode keys only choose where the dial goes
+  if ((event == KEY_PRESS_EVENT && this->dial_modes.press(k)) || (event == KEY_UNPRESS_EVENT && this->dial_modes.release(k))){
+    return;
+  }
+  if (key_mapping[k] == KEY_DIAL_OUTPUT){
+    if (event == KEY_PRESS_EVENT){
+      this->keyboard->setDialOutput((DialOutput)((this->keyboard->dial_output + 1) % DIAL_OUTPUT_COUNT));
+      this->dial_keys.clear();
+      this->arm();
+    }
+    return;
+  }
+  if (event == KEY_PRESS_EVENT){
+    if (key_mapping[k] == KEY_DIAL){
+      this->gestures.press(now);
+    } else {
+      this->behaviors.press(k, now);
+    }
+  } else if (event == KEY_UNPRESS_EVENT){
+    if (key_mapping[k] == KEY_DIAL){
+      this->gestures.release(now);
+    } else {
+      this->behaviors.release(k, now);
+    }
+  }
+  this->arm();
+}
+
+void InputPipeline::dial(int d, uint32_t now){
+  this->now = now;
+  if (this->dial_modes.active() >= 0){
+    this->dialMode(d * DIAL_ROTATION_DIRECTION, now);
+    this->arm();
+    return;
+  }
+  // dial_interval is the Surface Dial's resolution; the other modes carry partial steps themselves
+  if (this->keyboard->dial_output != DIAL_OUTPUT_RADIAL){
+    if (this->gestures.rotate(d * DIAL_ROTATION_DIRECTION, now)){
+      this->arm();
+      return;
+    }
+    if (this->keyboard->dial_output == DIAL_OUTPUT_KEYS){
+      this->dial_keys.rotate(d * DIAL_ROTATION_DIRECTION, now);
+    } else {
+      this->keyboard->rotate(d * DIAL_ROTATION_DIRECTION);
+    }
+    this->arm();
+    return;
+  }
+  this->keyboard->dial_pos += d;
+  if (this->keyboard->dial_pos % this->keyboard->dial_interval == 0){
+    this->keyboard->dial_pos = 0;
+    if (!this->gestures.rotate(d * DIAL_ROTATION_DIRECTION, now)){
+      this->keyboard->rotate(d * DIAL_ROTATION_DIRECTION);
+    }
+    if (this->keyboard->dial_vibrate){
+      this->vibrate((uint32_t)this->vibe_strength);
+    }
+  }
+  this->arm();
+}
+
+void InputPipeline::update(uint32_t now){
+  this->now = now;
+  this->gestures.update(now);
+  this->behaviors.update(now);
+  this->sendTaps(&this->dial_keys, now);
+  for (int i = 0; i < DIAL_MODES; i++){
+    this->sendTaps(&this->dial_modes.keys[i], now);
+  }
+  this->arm();
+}
+
+// The active mode's table entry decides where the steps go; a tap mode's taps go out from
+// update() at its own pace, even after the mode key is let go
+void InputPipeline::dialMode(int delta, uint32_t now){
+  const DialMode& mode = this->dial_modes.mode();
+  if (mode.output == DIAL_MODE_KEYS){
+    this->dial_modes.keys[this->dial_modes.active()].rotate(delta, now);
+  } else {
+    int units = this->dial_modes.units(delta);
+    if (mode.output == DIAL_MODE_RADIAL && units != 0){
+      this->keyboard->rotateRadial(units);
+    } else if (mode.output == DIAL_MODE_WHEEL && units != 0){
+      this->keyboard->scroll(units);
+    } else if (mode.output == DIAL_MODE_VOLUME){
+      for (; units > 0; units--) this->keyboard->write(KEY_MEDIA_VOLUME_UP);
+      for (; units < 0; units++) this->keyboard->write(KEY_MEDIA_VOLUME_DOWN);
+    }
+  }
+  if (this->dial_modes.detent(delta)){
+    this->vibrate(mode.detentMs);
+  }
+}
+
+void InputPipeline::sendTaps(DialKeys* keys, uint32_t now){
+  int taps = keys->take(now);
+  for (; taps > 0; taps--){
+    this->sendKeys(keys->config.forward);
+  }
+  for (; taps < 0; taps++){
+    this->sendKeys(keys->config.reverse);
+  }
+}
+
+static bool sooner(uint32_t* at, uint32_t next, bool timed){
+  if (!timed || (int32_t)(next - *at) < 0){
+    *at = next;
+  }
+  return true;
+}
+
+// One timer for all the engines, at the earliest time one of them has something to do
+void InputPipeline::arm(void){
+  uint32_t at = 0;
+  uint32_t next;
+  bool timed = false;
+  if (this->gestures.deadline(&next)) timed = sooner(&at, next, timed);
+  if (this->behaviors.deadline(&next)) timed = sooner(&at, next, timed);
+  if (this->dial_keys.deadline(&next)) timed = sooner(&at, next, timed);
+  for (int i = 0; i < DIAL_MODES; i++){
+    if (this->dial_modes.keys[i].deadline(&next)) timed = sooner(&at, next, timed);
+  }
+  if (timed){
+    this->timers->schedule(&this->update_timer, widenMs(at, this->timers->now()));
+  } else {
+    this->timers->cancel(&this->update_timer);
+  }
+}
+
+// Whole milliseconds on the 64-bit clock: vibe_strength is a float, and adding it to a large
+// uint32_t time in float arithmetic rounds the end of the vibration away, so callers convert it
+void InputPipeline::vibrate(uint32_t ms){
+  if (this->haptics != nullptr){
+    this->haptics->vibrate(true);
+  }
+  this->timers->schedule(&this->vibe_timer, widenMs(this->now, this->timers->now()) + ms);
+}
+
+void InputPipeline::onTimer(WheelTimer* timer, uint64_t now){
+  if (timer == &this->vibe_timer){
+    if (this->haptics != nullptr){
+      this->haptics->vibrate(false);
+    }
+  } else {
+    this->update((uint32_t)now);
+  }
+}
+
+void InputPipeline::onKey(int k, bool pressed){
+  if (pressed){
+    keymapPress(this->keyboard, k);
+  } else {
+    keymapRelease(this->keyboard, k);
+  }
+}
+
+void InputPipeline::onAction(const KeyAction& action, bool pressed){
+  if (action.type != KEY_ACTION_KEYS && action.type != KEY_ACTION_MODIFIERS){
+    return;
+  }
+  if (pressed){
+    if (action.ctrl) this->keyboard->press(KEY_LEFT_CTRL);
+    if (action.alt) this->keyboard->press(KEY_LEFT_ALT);
+    if (action.shift) this->keyboard->press(KEY_LEFT_SHIFT);
+    if (action.type == KEY_ACTION_KEYS) this->keyboard->press(action.key);
+  } else {
+    if (action.ctrl) this->keyboard->release(KEY_LEFT_CTRL);
+    if (action.alt) this->keyboard->release(KEY_LEFT_ALT);
+    if (action.shift) this->keyboard->release(KEY_LEFT_SHIFT);
+    if (action.type == KEY_ACTION_KEYS) this->keyboard->release(action.key);
+  }
+}
+
+void InputPipeline::sendKeys(const DialAction& action){
+  if (action.ctrl) this->keyboard->press(KEY_LEFT_CTRL);
+  if (action.alt) this->keyboard->press(KEY_LEFT_ALT);
+  if (action.shift) this->keyboard->press(KEY_LEFT_SHIFT);
+  this->keyboard->press(action.key);
+  this->keyboard->release(action.key);
+  if (action.shift) this->keyboard->release(KEY_LEFT_SHIFT);
+  if (action.alt) this->keyboard->release(KEY_LEFT_ALT);
+  if (action.ctrl) this->keyboard->release(KEY_LEFT_CTRL);
+}
+
+void InputPipeline::onGesture(DialGesture gesture, const DialAction& action, int delta){
+  if (gesture == DIAL_GESTURE_LONG_PRESS){
+    this->vibrate((uint32_t)this->vibe_strength);
+  }
+  switch (action.type){
+    case DIAL_ACTION_CLICK:
+      this->keyboard->pressDial();
+      this->keyboard->releaseDial();
+      break;
+    case DIAL_ACTION_HOLD:
+      this->keyboard->pressDial();
+      this->dial_held = true;
+      break;
+    case DIAL_ACTION_ROTATE:
+      if (!this->dial_held){
+        this->keyboard->pressDial();
+        this->dial_held = true;
+      }
+      this->keyboard->rotate(delta);
+      break;
+    case DIAL_ACTION_KEYS:
+      this->sendKeys(action);
+      break;
+    default:
+      break;
+  }
+}
+
+void InputPipeline::onGestureEnd(DialGesture gesture, const DialAction& action){
+  if (this->dial_held){
+    this->keyboard->releaseDial();
+    this->dial_held = false;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef INPUT_PIPELINE_H
+#define INPUT_PIPELINE_H
+
+#include "BleKeyboard.h"
+#include "DialGestures.h"
+#include "DialKeys.h"
+#include "DialModes.h"
+#include "KeyBehaviors.h"
+#include "TimerWheel.h"
+
+#define DIAL_ROTATION_DIRECTION -1 //Depends on how encoder is wired
+
+// The vibration motor behind the dial's detents and long press
+class HapticBackend {
+public:
+  virtual ~HapticBackend() {}
+  virtual void vibrate(bool on) = 0;
+};
+
+// Turns debounced key events and encoder steps into reports: keymap dispatch through the
+// tap-hold and chord bindings, the dial button gestures, dial_interval scaling, the dial's key tap mode
+// and the modes chosen by holding a key. Every entry point takes the time of the event instead of
+// reading a clock, so a recorded input trace replays through it unchanged.
+//
+// Whatever waits on time, the engines' next deadline and the end of a vibration, is a timer on
+// the wheel it is given; whoever advances the wheel drives it, and nothing needs polling.
+class InputPipeline : public DialGestureCallbacks, public KeyBehaviorCallbacks, public TimerCallbacks {
+public:
+  InputPipeline(BleKeyboard* keyboard, TimerWheel* timers, HapticBackend* haptics = nullptr);
+  void key(int k, int event, uint32_t now);
+  void dial(int d, uint32_t now);
+  void update(uint32_t now); // Runs the engines' deadlines; the wheel calls it when one is due
+  bool vibrating() const { return this->vibe_timer.pending(); }
+  DialGestureEngine gestures;
+  DialKeys dial_keys;
+  DialModes dial_modes; // Where the dial goes while a mode key is held
+  KeyBehaviorEngine behaviors;
+  float vibe_strength = 100; // Milliseconds of vibration per detent
+private:
+  void onGesture(DialGesture gesture, const DialAction& action, int delta);
+  void onGestureEnd(DialGesture gesture, const DialAction& action);
+  void onKey(int k, bool pressed);
+  void onAction(const KeyAction& action, bool pressed);
+  void onTimer(WheelTimer* timer, uint64_t now);
+  void dialMode(int delta, uint32_t now);
+  void sendKeys(const DialAction& action);
+  void sendTaps(DialKeys* keys, uint32_t now);
+  void arm(void);
+  void vibrate(uint32_t ms);
+  BleKeyboard* keyboard;
+  TimerWheel* timers;
+  HapticBackend* haptics;
+  WheelTimer update_timer;
+  WheelTimer vibe_timer;
+  uint32_t now = 0; // Time of the event being handled, for gesture callbacks
+  bool dial_held = false;
+};
+
+#endif // INPUT_PIPELINE_H
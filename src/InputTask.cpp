@@ -0,0 +1,174 @@
+#include "InputTask.h"
+#include "esp_timer.h"
+
+static_assert(INPUT_QUEUE_DIAL_DEPTH + INPUT_QUEUE_RELEASE_RESERVE < INPUT_QUEUE_LENGTH, "No room left for presses");
+static_assert(PadMatrix::keys <= 32, "InputTask::refused has a bit per key");
+
+void InputTask::start(PadMatrix* matrix, RotaryEncoder* encoder, InputTraceBuffer* trace){
+  this->matrix = matrix;
+  this->encoder = encoder;
+  this->trace = trace;
+  this->queue = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(InputEvent));
+  xTaskCreatePinnedToCore(InputTask::run, "input", INPUT_TASK_STACK, this, INPUT_TASK_PRIORITY, &this->handle, INPUT_TASK_CORE);
+}
+
+bool InputTask::receive(InputEvent* event, TickType_t wait){
+  return xQueueReceive(this->queue, event, wait) == pdTRUE;
+}
+
+void InputTask::run(void* arg){
+  InputTask* self = (InputTask*)arg;
+  TickType_t wake = xTaskGetTickCount();
+  int64_t last = esp_timer_get_time();
+  // The first scan runs straight away; anything held at power on is seen as early as possible
+  self->sample(last);
+  portENTER_CRITICAL(&self->statsLock);
+  self->firstUs = last;
+  portEXIT_CRITICAL(&self->statsLock);
+  for (;;){
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(INPUT_SCAN_PERIOD_MS));
+    int64_t started = esp_timer_get_time();
+    self->record(started - last);
+    last = started;
+    self->sample(started);
+  }
+}
+
+void InputTask::sample(int64_t nowUs){
+  uint32_t now = nowUs / 1000;
+  int changes_buff[PadMatrix::keys] = {};
+  MatrixBits raw = this->matrix->sample();
+  int16_t count = this->encoder->readCounter();
+  if (this->trace != NULL){
+    portENTER_CRITICAL(&this->traceLock);
+    this->trace->sample(nowUs, raw, count);
+    portEXIT_CRITICAL(&this->traceLock);
+  }
+  this->matrix->process(raw, changes_buff);
+  if (this->matrix->blocked() != 0){
+    portENTER_CRITICAL(&this->statsLock);
+    this->periodStats.ghosted++;
+    portEXIT_CRITICAL(&this->statsLock);
+  }
+  for (int k = 0; k < PadMatrix::keys; k++){
+    if (changes_buff[k] != 0){
+      this->pushKey(k, changes_buff[k], now);
+    }
+  }
+  int16_t d = this->encoder->delta(count);
+  if (d != 0 || this->dialCarry != 0){
+    this->pushDial(d, now);
+  }
+}
+
+// A press is refused once queueing it would reach into the release reserve. The dial steps
+// merged so far go ahead of any key event, so the pipeline still sees them in the order turned.
+void InputTask::pushKey(uint8_t key, int16_t value, uint32_t now){
+  MatrixBits bit = (MatrixBits)1 << key;
+  if (value == KEY_PRESS_EVENT){
+    UBaseType_t need = (this->dialCarry != 0) + 1;
+    if (uxQueueMessagesWaiting(this->queue) + need > INPUT_QUEUE_LENGTH - INPUT_QUEUE_RELEASE_RESERVE){
+      this->refused |= bit;
+      this->countDropped();
+      return;
+    }
+  } else if (this->refused & bit){
+    this->refused &= ~bit;
+    this->countDropped();
+    return;
+  }
+  this->flushDial(now);
+  this->push(INPUT_EVENT_KEY, key, value, now);
+}
+
+// While the HID task keeps up the queue stays short and every delta goes out as sampled; while
+// it holds input the deltas add up into one event, queued once the queue drains
+void InputTask::pushDial(int16_t delta, uint32_t now){
+  if (delta != 0 && this->dialCarry != 0){
+    portENTER_CRITICAL(&this->statsLock);
+    this->periodStats.merged++;
+    portEXIT_CRITICAL(&this->statsLock);
+  }
+  this->dialCarry += delta;
+  if (uxQueueMessagesWaiting(this->queue) < INPUT_QUEUE_DIAL_DEPTH){
+    this->flushDial(now);
+  }
+}
+
+void InputTask::flushDial(uint32_t now){
+  if (this->dialCarry == 0) return;
+  int16_t part = this->dialCarry > INT16_MAX ? INT16_MAX : this->dialCarry < INT16_MIN ? INT16_MIN : this->dialCarry;
+  this->dialCarry -= part;
+  this->push(INPUT_EVENT_DIAL, 0, part, now);
+}
+
+void InputTask::push(uint8_t type, uint8_t key, int16_t value, uint32_t now){
+  InputEvent event = {type, key, value, now};
+  if (xQueueSend(this->queue, &event, 0) != pdTRUE){
+    this->countDropped();
+  }
+}
+
+void InputTask::countDropped(void){
+  portENTER_CRITICAL(&this->statsLock);
+  this->periodStats.dropped++;
+  portEXIT_CRITICAL(&this->statsLock);
+}
+
+void InputTask::record(int64_t periodUs){
+  uint32_t us = (uint32_t)periodUs;
+  portENTER_CRITICAL(&this->statsLock);
+  if (us < this->periodStats.minUs) this->periodStats.minUs = us;
+  if (us > this->periodStats.maxUs) this->periodStats.maxUs = us;
+  this->periodStats.totalUs += us;
+  this->periodStats.count++;
+  if (us > 2 * INPUT_SCAN_PERIOD_MS * 1000) this->periodStats.overruns++;
+  portEXIT_CRITICAL(&this->statsLock);
+}
+
+ScanPeriodStats InputTask::stats(void){
+  portENTER_CRITICAL(&this->statsLock);
+  ScanPeriodStats copy = this->periodStats;
+  portEXIT_CRITICAL(&this->statsLock);
+  return copy;
+}
+
+void InputTask::resetStats(void){
+  portENTER_CRITICAL(&this->statsLock);
+  this->periodStats = {UINT32_MAX, 0, 0, 0, 0, 0, 0, 0};
+  portEXIT_CRITICAL(&this->statsLock);
+}
+
+int64_t InputTask::firstScanUs(void){
+  portENTER_CRITICAL(&this->statsLock);
+  int64_t us = this->firstUs;
+  portEXIT_CRITICAL(&this->statsLock);
+  return us;
+}
+
+size_t InputTask::traceSnapshot(uint8_t* out, size_t max){
+  if (this->trace == NULL) return 0;
+  for (int tries = 0; tries < INPUT_TRACE_SNAPSHOT_TRIES; tries++){
+    TraceCursor cursor;
+    portENTER_CRITICAL(&this->traceLock);
+    bool started = this->trace->snapshotBegin(out, max, &cursor);
+    portEXIT_CRITICAL(&this->traceLock);
+    if (!started) return 0;
+    bool intact = true;
+    while (intact && cursor.copied < cursor.length){
+      portENTER_CRITICAL(&this->traceLock);
+      intact = this->trace->snapshotCopy(out, &cursor, TRACE_SNAPSHOT_CHUNK);
+      portEXIT_CRITICAL(&this->traceLock);
+    }
+    if (intact) return this->trace->snapshotEnd(out, &cursor);
+  }
+  return 0;
+}
+
+size_t InputTask::traceSnapshotSize(void){
+  if (this->trace == NULL) return 0;
+  portENTER_CRITICAL(&this->traceLock);
+  size_t n = this->trace->snapshotSize();
+  portEXIT_CRITICAL(&this->traceLock);
+  return n;
+}
@@ -0,0 +1,82 @@
+#ifndef INPUT_TASK_H
+#define INPUT_TASK_H
+
+#include <arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "matrix.h"
+#include "encoder.h"
+#include "InputTrace.h"
+
+#define INPUT_SCAN_PERIOD_MS 1
+#define INPUT_TASK_CORE 1 // The Bluetooth controller and host run on core 0
+#define INPUT_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define INPUT_TASK_STACK 2048
+#define INPUT_QUEUE_LENGTH 64
+#define INPUT_TRACE_SNAPSHOT_TRIES 3 //Times a trace snapshot starts over after the scans dropped records it had not copied
+#define INPUT_QUEUE_DIAL_DEPTH 8 //Queued events past which dial deltas merge into one instead of queueing
+// Slots only releases may take: a release and the dial steps merged before it, for every key, so
+// no press queued while the HID task holds input loses its release
+#define INPUT_QUEUE_RELEASE_RESERVE (2 * PadMatrix::keys)
+
+#define INPUT_EVENT_KEY 1
+#define INPUT_EVENT_DIAL 2
+
+typedef struct {
+  uint8_t type;
+  uint8_t key;    // Matrix index, j * PadMatrix::cols + i
+  int16_t value;  // KEY_PRESS_EVENT / KEY_UNPRESS_EVENT, or encoder delta
+  uint32_t time;  // Milliseconds when sampled: the low 32 bits of monotonicMs(), see widenMs()
+} InputEvent;
+
+// Time between consecutive scans, in microseconds
+typedef struct {
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t count;
+  uint32_t overruns; // Scans that started more than one period late
+  uint32_t dropped;  // Events lost to a full queue, presses refused and their releases
+  uint32_t merged;   // Dial deltas merged into a later one while the queue was backed up
+  uint32_t ghosted;  // Scans that held keys back as ambiguous (matrices without diodes)
+} ScanPeriodStats;
+
+// Samples the key matrix and the encoder on a fixed period from a high priority task, so the
+// sampling rate does not depend on how long BLE notifies take. Events go to a queue that the
+// reporting task drains.
+class InputTask {
+public:
+  void start(PadMatrix* matrix, RotaryEncoder* encoder, InputTraceBuffer* trace = NULL);
+  bool receive(InputEvent* event, TickType_t wait);
+  ScanPeriodStats stats(void);
+  void resetStats(void);
+  int64_t firstScanUs(void); // esp_timer time of the first scan, 0 until it has run
+  // Copy of the raw input trace, see InputTraceBuffer::snapshot. Copied TRACE_SNAPSHOT_CHUNK
+  // bytes per hold of the trace lock, so a scan waits at most one chunk.
+  size_t traceSnapshot(uint8_t* out, size_t max);
+  size_t traceSnapshotSize(void);
+private:
+  static void run(void* arg);
+  void sample(int64_t nowUs);
+  void pushKey(uint8_t key, int16_t value, uint32_t now);
+  void pushDial(int16_t delta, uint32_t now);
+  void flushDial(uint32_t now);
+  void push(uint8_t type, uint8_t key, int16_t value, uint32_t now);
+  void countDropped(void);
+  void record(int64_t periodUs);
+  PadMatrix* matrix;
+  RotaryEncoder* encoder;
+  InputTraceBuffer* trace;
+  QueueHandle_t queue;
+  TaskHandle_t handle;
+  portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+  portMUX_TYPE traceLock = portMUX_INITIALIZER_UNLOCKED;
+  ScanPeriodStats periodStats = {UINT32_MAX, 0, 0, 0, 0, 0, 0, 0};
+  int32_t dialCarry = 0;      // Dial steps not yet queued
+  MatrixBits refused = 0;     // Keys whose press was refused; their release is dropped as well
+  int64_t firstUs = 0;
+};
+
+#endif // INPUT_TASK_H
@@ -0,0 +1,232 @@
+#include "InputTrace.h"
+
+#include <string.h>
+
+static const uint8_t TRACE_MAGIC[4] = {'M', 'P', 'T', 'R'};
+
+static size_t putVarint(uint8_t* out, uint32_t value){
+  size_t n = 0;
+  while (value >= 0x80){
+    out[n++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[n++] = value;
+  return n;
+}
+
+static size_t getVarint(const uint8_t* in, size_t len, uint32_t* value){
+  uint32_t result = 0;
+  for (size_t n = 0; n < len && n < 5; n++){
+    result |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+    if (!(in[n] & 0x80)){
+      *value = result;
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+static uint32_t zigzag(int32_t value){
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value){
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void putLe(uint8_t* out, uint64_t value, int bytes){
+  for (int i = 0; i < bytes; i++){
+    out[i] = value >> (8 * i);
+  }
+}
+
+static uint64_t getLe(const uint8_t* in, int bytes){
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++){
+    value |= (uint64_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+static size_t encodeMatrix(uint8_t* out, uint32_t deltaUs, uint32_t run, uint32_t changed){
+  size_t n = putVarint(out, deltaUs << 1 | TRACE_RECORD_MATRIX);
+  n += putVarint(out + n, run);
+  n += putVarint(out + n, changed);
+  return n;
+}
+
+InputTraceBuffer::InputTraceBuffer(uint8_t* buffer, size_t size){
+  this->buffer = buffer;
+  this->size = size;
+}
+
+void InputTraceBuffer::clear(void){
+  this->droppedBytes += this->used;
+  this->head = 0;
+  this->tail = 0;
+  this->used = 0;
+  this->started = false;
+  this->dropped = 0;
+}
+
+void InputTraceBuffer::sample(uint64_t nowUs, uint32_t raw, int16_t count){
+  if (!this->started){
+    this->base = {nowUs, raw, count};
+    this->lastRecordUs = nowUs;
+    this->lastSampleUs = nowUs;
+    this->lastRaw = raw;
+    this->lastCount = count;
+    this->run = 0;
+    this->started = true;
+    return;
+  }
+  this->lastSampleUs = nowUs;
+  // Encoder records come after the matrix record of the same scan, the order InputTask sends events in
+  if (raw == this->lastRaw && count == this->lastCount && this->run < TRACE_MAX_RUN){
+    this->run++;
+    return;
+  }
+  uint8_t record[TRACE_RECORD_MAX];
+  size_t n = encodeMatrix(record, nowUs - this->lastRecordUs, this->run, raw ^ this->lastRaw);
+  if (count != this->lastCount){
+    n += putVarint(record + n, TRACE_RECORD_ENCODER);
+    n += putVarint(record + n, zigzag((int16_t)(count - this->lastCount)));
+  }
+  this->append(record, n);
+  this->lastRecordUs = nowUs;
+  this->lastRaw = raw;
+  this->lastCount = count;
+  this->run = 0;
+}
+
+void InputTraceBuffer::append(const uint8_t* record, size_t len){
+  while (this->size - this->used < len){
+    this->dropOldest();
+  }
+  for (size_t i = 0; i < len; i++){
+    this->buffer[this->head] = record[i];
+    this->head = (this->head + 1) % this->size;
+  }
+  this->used += len;
+}
+
+// Folds the oldest record into base so the remaining deltas still resolve
+void InputTraceBuffer::dropOldest(void){
+  uint8_t record[TRACE_RECORD_MAX];
+  size_t len = this->used < TRACE_RECORD_MAX ? this->used : TRACE_RECORD_MAX;
+  for (size_t i = 0; i < len; i++){
+    record[i] = this->buffer[(this->tail + i) % this->size];
+  }
+  uint32_t tag = 0, run = 0, value = 0;
+  size_t n = getVarint(record, len, &tag);
+  this->base.timeUs += tag >> 1;
+  if ((tag & 1) == TRACE_RECORD_MATRIX){
+    n += getVarint(record + n, len - n, &run);
+    n += getVarint(record + n, len - n, &value);
+    this->base.raw ^= value;
+  } else {
+    n += getVarint(record + n, len - n, &value);
+    this->base.count += unzigzag(value);
+  }
+  this->tail = (this->tail + n) % this->size;
+  this->used -= n;
+  this->droppedBytes += n;
+  this->dropped++;
+}
+
+size_t InputTraceBuffer::snapshot(uint8_t* out, size_t max){
+  TraceCursor cursor;
+  if (!this->snapshotBegin(out, max, &cursor)){
+    return 0;
+  }
+  this->snapshotCopy(out, &cursor, cursor.length);
+  return this->snapshotEnd(out, &cursor);
+}
+
+bool InputTraceBuffer::snapshotBegin(uint8_t* out, size_t max, TraceCursor* cursor){
+  if (max < this->snapshotSize() || !this->started){
+    return false;
+  }
+  memcpy(out, TRACE_MAGIC, 4);
+  out[4] = TRACE_VERSION;
+  memset(out + 5, 0, 3);
+  putLe(out + 8, this->base.timeUs, 8);
+  putLe(out + 16, this->base.raw, 4);
+  putLe(out + 20, (uint16_t)this->base.count, 2);
+  cursor->from = this->tail;
+  cursor->length = this->used;
+  cursor->copied = 0;
+  cursor->droppedBytes = this->droppedBytes;
+  cursor->lastLen = 0;
+  // Samples since the last record would otherwise be lost
+  if (this->run > 0){
+    cursor->lastLen = encodeMatrix(cursor->last, this->lastSampleUs - this->lastRecordUs, this->run - 1, 0);
+  }
+  return true;
+}
+
+// Bytes sample() has dropped since the snapshot began are the only ones it may have written over
+bool InputTraceBuffer::snapshotCopy(uint8_t* out, TraceCursor* cursor, size_t chunk){
+  if (this->droppedBytes - cursor->droppedBytes > cursor->copied){
+    return false;
+  }
+  size_t n = cursor->length - cursor->copied < chunk ? cursor->length - cursor->copied : chunk;
+  size_t at = (cursor->from + cursor->copied) % this->size;
+  size_t first = this->size - at < n ? this->size - at : n;
+  uint8_t* to = out + TRACE_HEADER_SIZE + cursor->copied;
+  memcpy(to, this->buffer + at, first);
+  memcpy(to + first, this->buffer, n - first);
+  cursor->copied += n;
+  return true;
+}
+
+size_t InputTraceBuffer::snapshotEnd(uint8_t* out, const TraceCursor* cursor){
+  memcpy(out + TRACE_HEADER_SIZE + cursor->length, cursor->last, cursor->lastLen);
+  return TRACE_HEADER_SIZE + cursor->length + cursor->lastLen;
+}
+
+InputTraceReader::InputTraceReader(const uint8_t* data, size_t size){
+  this->data = data;
+  this->size = size;
+  if (size < TRACE_HEADER_SIZE || memcmp(data, TRACE_MAGIC, 4) != 0 || data[4] != TRACE_VERSION){
+    return;
+  }
+  this->base.timeUs = getLe(data + 8, 8);
+  this->base.raw = getLe(data + 16, 4);
+  this->base.count = (int16_t)getLe(data + 20, 2);
+  this->state = this->base;
+  this->pos = TRACE_HEADER_SIZE;
+  this->ok = true;
+}
+
+bool InputTraceReader::varint(uint32_t* value){
+  size_t n = getVarint(this->data + this->pos, this->size - this->pos, value);
+  this->pos += n;
+  return n > 0;
+}
+
+bool InputTraceReader::next(TraceRecord* record){
+  uint32_t tag = 0, run = 0, value = 0;
+  if (!this->ok || this->pos >= this->size || !this->varint(&tag)){
+    return false;
+  }
+  this->state.timeUs += tag >> 1;
+  record->type = tag & 1;
+  record->timeUs = this->state.timeUs;
+  record->run = 0;
+  if (record->type == TRACE_RECORD_MATRIX){
+    if (!this->varint(&run) || !this->varint(&value)){
+      return false;
+    }
+    this->state.raw ^= value;
+    record->run = run;
+  } else {
+    if (!this->varint(&value)){
+      return false;
+    }
+    this->state.count += unzigzag(value);
+  }
+  record->raw = this->state.raw;
+  record->count = this->state.count;
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRACE_BUFFER_SIZE 16384 //Bytes of RAM for recorded input, oldest records are dropped first
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 22
+#define TRACE_RECORD_MAX 16 //Longest encoded record
+#define TRACE_MAX_RUN 1000 //Unchanged matrix samples folded into one record
+#define TRACE_SNAPSHOT_CHUNK 256 //Record bytes snapshotCopy() is asked for per hold of the caller's lock
+
+#define TRACE_RECORD_MATRIX 0
+#define TRACE_RECORD_ENCODER 1
+
+// Raw input as sampled: the KeyboardMatrix::sample() bitmap and the PCNT counter
+typedef struct {
+  uint64_t timeUs;
+  uint32_t raw;
+  int16_t count;
+} TraceState;
+
+typedef struct {
+  uint8_t type;
+  uint64_t timeUs;
+  uint32_t run;   // Matrix: samples of the previous bitmap between the last matrix record and this one
+  uint32_t raw;   // Matrix: bitmap sampled at timeUs
+  int16_t count;  // Encoder: counter sampled at timeUs
+} TraceRecord;
+
+// How far a snapshot taken a chunk at a time has got
+typedef struct {
+  size_t from;                    // Ring index of the oldest record when the snapshot began
+  size_t length;                  // Record bytes in the snapshot
+  size_t copied;                  // Record bytes copied so far
+  uint32_t droppedBytes;          // InputTraceBuffer::droppedBytes when the snapshot began
+  uint8_t last[TRACE_RECORD_MAX]; // Samples since the last record, as a record of their own
+  size_t lastLen;
+} TraceCursor;
+
+// Records raw scans into a RAM ring buffer. A record is only written when the matrix bitmap or
+// the encoder counter changes; unchanged samples are counted so replay sees every scan the
+// debounce saw. Each record is varint(time delta << 1 | type) followed by either
+// varint(run), varint(bitmap xor previous) or zigzag varint(counter delta).
+//
+// Not thread safe; InputTask serialises sample() and each snapshot call.
+class InputTraceBuffer {
+public:
+  InputTraceBuffer(uint8_t* buffer, size_t size);
+  void sample(uint64_t nowUs, uint32_t raw, int16_t count);
+  // Header followed by every record still held; returns bytes written, 0 if max is too small
+  size_t snapshot(uint8_t* out, size_t max);
+  // The same snapshot a chunk at a time, so a caller sharing the buffer with sample() only locks
+  // around each call. snapshotBegin() writes the header, snapshotCopy() copies up to chunk more
+  // record bytes and fails once sample() has dropped records not yet copied, and snapshotEnd(),
+  // which only reads the cursor, returns the bytes written.
+  bool snapshotBegin(uint8_t* out, size_t max, TraceCursor* cursor);
+  bool snapshotCopy(uint8_t* out, TraceCursor* cursor, size_t chunk);
+  size_t snapshotEnd(uint8_t* out, const TraceCursor* cursor);
+  size_t snapshotSize(void) const { return TRACE_HEADER_SIZE + this->used + TRACE_RECORD_MAX; }
+  void clear(void);
+  uint32_t dropped = 0; // Records overwritten because the buffer was full
+private:
+  void append(const uint8_t* record, size_t len);
+  void dropOldest(void);
+  uint8_t* buffer;
+  size_t size;
+  size_t head = 0;
+  size_t tail = 0;
+  size_t used = 0;
+  uint32_t droppedBytes = 0; // Bytes ever taken off the tail, wrapping
+  bool started = false;
+  TraceState base;      // State before the oldest record still held
+  uint64_t lastRecordUs = 0;
+  uint64_t lastSampleUs = 0;
+  uint32_t lastRaw = 0;
+  int16_t lastCount = 0;
+  uint32_t run = 0;
+};
+
+// Decodes a snapshot, resolving deltas back to absolute times, bitmaps and counts
+class InputTraceReader {
+public:
+  InputTraceReader(const uint8_t* data, size_t size);
+  bool valid(void) const { return this->ok; }
+  TraceState start(void) const { return this->base; }
+  bool next(TraceRecord* record);
+private:
+  bool varint(uint32_t* value);
+  const uint8_t* data;
+  size_t size;
+  size_t pos = 0;
+  bool ok = false;
+  TraceState base;
+  TraceState state;
+};
+
+#endif // INPUT_TRACE_H
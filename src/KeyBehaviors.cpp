@@ -0,0 +1,230 @@
+#include "KeyBehaviors.h"
+
+KeyBehaviorEngine::KeyBehaviorEngine(KeyBehaviorCallbacks* callbacks) : callbacks(callbacks) {
+}
+
+void KeyBehaviorEngine::configure(void){
+  this->dualRole = 0;
+  this->chordKeys = 0;
+  for (int k = 0; k < KEY_BEHAVIOR_KEYS; k++){
+    this->chordsOf[k] = 0;
+    if (this->config.tapHold[k].hold.type != KEY_ACTION_NONE){
+      this->dualRole |= KEY_BIT(k);
+    }
+  }
+  for (int i = 0; i < this->config.chordCount && i < KEY_BEHAVIOR_MAX_CHORDS; i++){
+    KeyMask keys = this->config.chords[i].keys;
+    this->chordKeys |= keys;
+    for (int k = 0; k < KEY_BEHAVIOR_KEYS; k++){
+      if (keys & KEY_BIT(k)) this->chordsOf[k] |= 1 << i;
+    }
+  }
+}
+
+void KeyBehaviorEngine::press(int k, uint32_t now){
+  if (k < 0){
+    return;
+  }
+  // No binding can name a key past the masks, so it goes out like any other unbound key
+  if (k >= KEY_BEHAVIOR_KEYS){
+    if (this->gathered != 0){
+      this->flushChord(now);
+    }
+    this->settleHold();
+    this->callbacks->onKey(k, true);
+    return;
+  }
+  if ((this->chordKeys & KEY_BIT(k)) && this->chordDown == 0){
+    this->chordPress(k, now);
+    return;
+  }
+  if (this->gathered != 0){
+    this->flushChord(now);
+  }
+  this->tapHoldPress(k, now);
+}
+
+void KeyBehaviorEngine::release(int k, uint32_t now){
+  if (k < 0){
+    return;
+  }
+  if (k >= KEY_BEHAVIOR_KEYS){
+    this->callbacks->onKey(k, false);
+    return;
+  }
+  if (this->chordDown & KEY_BIT(k)){
+    if (this->chordAction != nullptr){
+      this->callbacks->onAction(*this->chordAction, false);
+      this->chordAction = nullptr;
+    }
+    this->chordDown &= ~KEY_BIT(k);
+    return;
+  }
+  if (this->gathered & KEY_BIT(k)){
+    // Let go before the window closed: a complete chord still counts
+    if (this->exactChord() >= 0){
+      this->fireChord(k, now);
+      return;
+    }
+    this->flushChord(now);
+  }
+  this->tapHoldRelease(k, now);
+}
+
+void KeyBehaviorEngine::update(uint32_t now){
+  if (this->gathered != 0 && now - this->gatherStarted >= this->config.chordWindow){
+    if (this->exactChord() >= 0){
+      this->fireChord(-1, now);
+    } else {
+      this->flushChord(now);
+    }
+  }
+  if (this->tapHoldKey >= 0 && now - this->tapHoldAt >= this->config.tappingTerm){
+    this->settleHold();
+  }
+}
+
+// The earlier of the chord window closing and the tapping term running out
+bool KeyBehaviorEngine::deadline(uint32_t* at) const {
+  bool timed = false;
+  if (this->gathered != 0){
+    *at = this->gatherStarted + this->config.chordWindow;
+    timed = true;
+  }
+  if (this->tapHoldKey >= 0){
+    uint32_t held = this->tapHoldAt + this->config.tappingTerm;
+    if (!timed || (int32_t)(held - *at) < 0){
+      *at = held;
+    }
+    timed = true;
+  }
+  return timed;
+}
+
+// Gathers while the keys down so far still fit some chord. Fires as soon as they make a chord
+// that no longer candidate contains; otherwise the window or a release decides.
+void KeyBehaviorEngine::chordPress(int k, uint32_t now){
+  uint8_t fits = this->gathered == 0 ? this->chordsOf[k] : this->candidates & this->chordsOf[k];
+  if (fits == 0){
+    this->flushChord(now);
+    this->chordPress(k, now);
+    return;
+  }
+  if (this->gathered == 0){
+    this->gatherStarted = now;
+  }
+  this->gathered |= KEY_BIT(k);
+  this->candidates = fits;
+  this->order[this->gatheredCount] = k;
+  this->times[this->gatheredCount++] = now;
+  int exact = this->exactChord();
+  if (exact >= 0 && this->candidates == (1 << exact)){
+    this->fireChord(-1, now);
+  }
+}
+
+int KeyBehaviorEngine::exactChord(void) const {
+  for (int i = 0; i < KEY_BEHAVIOR_MAX_CHORDS; i++){
+    if ((this->candidates & (1 << i)) && this->config.chords[i].keys == this->gathered){
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Counts as another key going down for a waiting dual-role key, which becomes a hold
+void KeyBehaviorEngine::fireChord(int releasing, uint32_t now){
+  int i = this->exactChord();
+  this->settleHold();
+  this->chordAction = &this->config.chords[i].action;
+  this->callbacks->onAction(*this->chordAction, true);
+  this->chordDown = this->gathered;
+  this->gathered = 0;
+  this->gatheredCount = 0;
+  if (releasing >= 0){
+    this->release(releasing, now);
+  }
+}
+
+// Not a chord after all: the keys go on as pressed, in order, with their own times
+void KeyBehaviorEngine::flushChord(uint32_t now){
+  uint8_t count = this->gatheredCount;
+  this->gathered = 0;
+  this->gatheredCount = 0;
+  for (uint8_t i = 0; i < count; i++){
+    this->tapHoldPress(this->order[i], this->times[i]);
+  }
+}
+
+void KeyBehaviorEngine::tapHoldPress(int k, uint32_t now){
+  this->settleHold();
+  if (this->dualRole & KEY_BIT(k)){
+    this->tapHoldKey = k;
+    this->tapHoldAt = now;
+    return;
+  }
+  this->sendPress(k);
+}
+
+void KeyBehaviorEngine::tapHoldRelease(int k, uint32_t now){
+  if (k == this->tapHoldKey){
+    this->tapHoldKey = -1;
+    const KeyAction& tap = this->config.tapHold[k].tap;
+    if (tap.type == KEY_ACTION_NONE){
+      this->sendPress(k);
+      this->sendRelease(k);
+    } else {
+      this->callbacks->onAction(tap, true);
+      this->callbacks->onAction(tap, false);
+    }
+  } else if (this->holding & KEY_BIT(k)){
+    this->holding &= ~KEY_BIT(k);
+    this->applyHold(this->config.tapHold[k].hold, false);
+  } else {
+    this->sendRelease(k);
+  }
+}
+
+void KeyBehaviorEngine::settleHold(void){
+  if (this->tapHoldKey < 0){
+    return;
+  }
+  int k = this->tapHoldKey;
+  this->tapHoldKey = -1;
+  this->holding |= KEY_BIT(k);
+  this->applyHold(this->config.tapHold[k].hold, true);
+}
+
+void KeyBehaviorEngine::applyHold(const KeyAction& action, bool pressed){
+  if (action.type == KEY_ACTION_LAYER){
+    this->layer = pressed && action.layer <= KEY_BEHAVIOR_LAYERS ? action.layer : 0;
+  } else {
+    this->callbacks->onAction(action, pressed);
+  }
+}
+
+void KeyBehaviorEngine::sendPress(int k){
+  const KeyAction* action = this->layer > 0 ? &this->config.layers[this->layer - 1][k] : nullptr;
+  if (action != nullptr && action->type == KEY_ACTION_NONE){
+    action = nullptr;
+  }
+  this->sent |= KEY_BIT(k);
+  this->sentAction[k] = action;
+  if (action != nullptr){
+    this->callbacks->onAction(*action, true);
+  } else {
+    this->callbacks->onKey(k, true);
+  }
+}
+
+void KeyBehaviorEngine::sendRelease(int k){
+  if (!(this->sent & KEY_BIT(k))){
+    return;
+  }
+  this->sent &= ~KEY_BIT(k);
+  if (this->sentAction[k] != nullptr){
+    this->callbacks->onAction(*this->sentAction[k], false);
+  } else {
+    this->callbacks->onKey(k, false);
+  }
+}
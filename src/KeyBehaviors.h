@@ -0,0 +1,119 @@
+#ifndef KEY_BEHAVIORS_H
+#define KEY_BEHAVIORS_H
+
+#include <stdint.h>
+
+#define KEY_BEHAVIOR_KEYS 32 //Matrix indexes a KeyMask can hold, as many as a matrix sample
+#define KEY_BEHAVIOR_LAYERS 2 //Layers on top of the keymap, which is layer 0
+#define KEY_BEHAVIOR_MAX_CHORDS 8
+#define KEY_BEHAVIOR_TAPPING_TERM 200 //Milliseconds a dual-role key must be held to act as its hold
+#define KEY_BEHAVIOR_CHORD_WINDOW 50 //Milliseconds in which all keys of a chord must go down
+
+typedef uint32_t KeyMask; // Bit k is matrix index k
+#define KEY_BIT(k) ((KeyMask)1 << (k))
+
+enum KeyActionType {
+  KEY_ACTION_NONE,      // Unbound: the key's own keymap entry
+  KEY_ACTION_KEYS,      // Key plus KEY_LEFT_* modifiers, held as long as the binding is
+  KEY_ACTION_MODIFIERS, // Just the modifiers
+  KEY_ACTION_LAYER      // Keys pressed meanwhile use layers[layer - 1]
+};
+
+struct KeyAction {
+  KeyActionType type;
+  uint8_t key;
+  uint8_t ctrl;
+  uint8_t alt;
+  uint8_t shift;
+  uint8_t layer;
+};
+
+// A key with a hold binding is dual-role: released within tappingTerm it sends tap (or its own
+// keymap entry if tap is unbound), held longer, or held while another key goes down, it acts as
+// hold until released.
+struct TapHoldBinding {
+  KeyAction tap = {KEY_ACTION_NONE, 0, 0, 0, 0, 0};
+  KeyAction hold = {KEY_ACTION_NONE, 0, 0, 0, 0, 0};
+};
+
+// Two or more keys pressed within chordWindow send action instead, held until one of them is let go
+struct ChordBinding {
+  KeyMask keys;
+  KeyAction action;
+};
+
+// For example, 'g' held as Ctrl and 's' with 'd' together as Ctrl+Z:
+//   config.tapHold[6].hold = {KEY_ACTION_MODIFIERS, 0, 1, 0, 0, 0};
+//   config.chords[0] = {KEY_BIT(0) | KEY_BIT(3), {KEY_ACTION_KEYS, 'z', 1, 0, 0, 0}};
+//   config.chordCount = 1;
+// then configure().
+struct KeyBehaviorConfig {
+  TapHoldBinding tapHold[KEY_BEHAVIOR_KEYS];
+  ChordBinding chords[KEY_BEHAVIOR_MAX_CHORDS];
+  uint8_t chordCount = 0;
+  KeyAction layers[KEY_BEHAVIOR_LAYERS][KEY_BEHAVIOR_KEYS] = {}; // KEY_ACTION_NONE falls through to the keymap
+  uint32_t tappingTerm = KEY_BEHAVIOR_TAPPING_TERM;
+  uint32_t chordWindow = KEY_BEHAVIOR_CHORD_WINDOW;
+};
+
+class KeyBehaviorCallbacks {
+public:
+  virtual ~KeyBehaviorCallbacks() {}
+  virtual void onKey(int k, bool pressed) = 0;                       // The key's own keymap entry
+  virtual void onAction(const KeyAction& action, bool pressed) = 0;
+};
+
+// Resolves dual-role keys and chords from timestamped key events. Like DialGestureEngine it never
+// reads a clock; update() runs the tapping term and chord window out.
+//
+// Only keys that are part of a binding ever wait. Any other key goes out in the same call that
+// reports it: it first settles a waiting dual-role key as held and ends a chord still being
+// gathered, so it also can't be delayed by them. Membership and chord matching are masks
+// precomputed by configure(), so each event costs the same however many bindings there are.
+class KeyBehaviorEngine {
+public:
+  KeyBehaviorEngine(KeyBehaviorCallbacks* callbacks);
+  void configure(void); // After changing config
+  void press(int k, uint32_t now);
+  void release(int k, uint32_t now);
+  void update(uint32_t now);
+  bool deadline(uint32_t* at) const; // When update() next has something to do; false if nothing waits on time
+  bool waiting() const { return this->gathered != 0 || this->tapHoldKey >= 0; }
+  KeyBehaviorConfig config;
+private:
+  void chordPress(int k, uint32_t now);
+  void fireChord(int releasing, uint32_t now);
+  void flushChord(uint32_t now);
+  int exactChord(void) const;
+  void tapHoldPress(int k, uint32_t now);
+  void tapHoldRelease(int k, uint32_t now);
+  void settleHold(void);
+  void sendPress(int k);
+  void sendRelease(int k);
+  void applyHold(const KeyAction& action, bool pressed);
+  KeyBehaviorCallbacks* callbacks;
+  // From configure()
+  KeyMask dualRole = 0;
+  KeyMask chordKeys = 0;
+  uint8_t chordsOf[KEY_BEHAVIOR_KEYS] = {}; // Bit i: key is part of chords[i]
+  // Chord being gathered: keys in press order, the chords they still fit
+  KeyMask gathered = 0;
+  uint8_t candidates = 0;
+  uint8_t order[KEY_BEHAVIOR_KEYS];
+  uint32_t times[KEY_BEHAVIOR_KEYS];
+  uint8_t gatheredCount = 0;
+  uint32_t gatherStarted = 0;
+  // Chord that fired, until one of its keys is let go; the others' releases are swallowed
+  KeyMask chordDown = 0;
+  const KeyAction* chordAction = nullptr;
+  // Dual-role key waiting to be a tap or a hold, and keys settled as held
+  int tapHoldKey = -1;
+  uint32_t tapHoldAt = 0;
+  KeyMask holding = 0;
+  uint8_t layer = 0;
+  // What each sent key pressed, so it releases the same thing after a layer change
+  KeyMask sent = 0;
+  const KeyAction* sentAction[KEY_BEHAVIOR_KEYS] = {};
+};
+
+#endif // KEY_BEHAVIORS_H
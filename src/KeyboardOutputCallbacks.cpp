@@ -11,8 +11,8 @@
 KeyboardOutputCallbacks::KeyboardOutputCallbacks(void) {
 }
 
-void KeyboardOutputCallbacks::onWrite(BLECharacteristic* me) {
-  uint8_t* value = (uint8_t*)(me->getValue().c_str());
-  ESP_LOGI(LOG_TAG, "special keys: %d", *value);
+void KeyboardOutputCallbacks::onWrite(const uint8_t* data, size_t len) {
+  if (len > 0){
+    ESP_LOGI(LOG_TAG, "special keys: %d", data[0]);
+  }
 }
-
@@ -3,15 +3,13 @@
 #include "sdkconfig.h"
 #if defined(CONFIG_BT_ENABLED)
 
-#include <BLEServer.h>
-#include "BLE2902.h"
-#include "BLECharacteristic.h"
+#include "HidTransport.h"
 
-class KeyboardOutputCallbacks : public BLECharacteristicCallbacks
+class KeyboardOutputCallbacks : public TransportWriter
 {
 public:
   KeyboardOutputCallbacks(void);
-  void onWrite(BLECharacteristic* me);
+  void onWrite(const uint8_t* data, size_t len);
 };
 
 #endif // CONFIG_BT_ENABLED
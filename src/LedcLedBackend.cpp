@@ -0,0 +1,36 @@
+#include "LedcLedBackend.h"
+
+bool LedcLedBackend::begin(int pin){
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = LEDC_TIMER_13_BIT;
+  timer.timer_num = STATUS_LED_TIMER;
+  timer.freq_hz = STATUS_LED_FREQ_HZ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = pin;
+  channel.speed_mode = LEDC_LOW_SPEED_MODE;
+  channel.channel = STATUS_LED_CHANNEL;
+  channel.intr_type = LEDC_INTR_DISABLE;
+  channel.timer_sel = STATUS_LED_TIMER;
+  channel.duty = 0;
+  // The fade service's interrupt only fires at the end of a fade, to release the channel
+  this->ready = ledc_timer_config(&timer) == ESP_OK && ledc_channel_config(&channel) == ESP_OK &&
+                ledc_fade_func_install(0) == ESP_OK;
+  return this->ready;
+}
+
+// Holds cost nothing: the hardware just keeps the duty it has. Both calls below wait for a running
+// fade to end; StatusLed never asks for a new duty before the last fade's time is up.
+void LedcLedBackend::fade(uint16_t duty, uint32_t ms){
+  if (!this->ready || duty == this->duty){
+    return;
+  }
+  this->duty = duty;
+  if (ms == 0){
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, STATUS_LED_CHANNEL, duty);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, STATUS_LED_CHANNEL);
+  } else {
+    ledc_set_fade_time_and_start(LEDC_LOW_SPEED_MODE, STATUS_LED_CHANNEL, duty, ms, LEDC_FADE_NO_WAIT);
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef LEDC_LED_BACKEND_H
+#define LEDC_LED_BACKEND_H
+
+#include "driver/ledc.h"
+#include "StatusLed.h"
+
+// What the Arduino core uses for ledcSetup() channel 15, the last one
+#define STATUS_LED_TIMER LEDC_TIMER_3
+#define STATUS_LED_CHANNEL LEDC_CHANNEL_7
+#define STATUS_LED_FREQ_HZ 5000
+
+// The status LED on the LEDC peripheral. Fades run in the LEDC hardware, which steps the duty by
+// itself until the target is reached, so nothing on the CPU runs while a segment plays.
+class LedcLedBackend : public LedBackend
+{
+public:
+  bool begin(int pin);
+  void fade(uint16_t duty, uint32_t ms);
+private:
+  uint16_t duty = 0;
+  bool ready = false;
+};
+
+#endif // LEDC_LED_BACKEND_H
@@ -0,0 +1,92 @@
+#include <arduino.h>
+
+#include "LoopbackHidTransport.h"
+
+LoopbackHidTransport::LoopbackHidTransport(FILE* out, bool autoConnect) : out(out), autoConnect(autoConnect) {
+}
+
+void LoopbackHidTransport::begin(const HidDeviceInfo& info, BleConnectionStatus* status)
+{
+  this->status = status;
+  fprintf(this->out, "# %llu begin %s\n", (unsigned long long)micros(), info.name);
+}
+
+uint8_t LoopbackHidTransport::addReport(uint8_t id, HidReportType type)
+{
+  if (this->count == TRANSPORT_MAX_ATTRIBUTES){
+    return TRANSPORT_NO_HANDLE;
+  }
+  this->kinds[this->count] = type == HID_INPUT_REPORT ? 'I' : type == HID_OUTPUT_REPORT ? 'O' : 'F';
+  this->ids[this->count] = id;
+  return this->count++;
+}
+
+uint8_t LoopbackHidTransport::addCharacteristic(const char* uuid, uint8_t properties)
+{
+  if (this->count == TRANSPORT_MAX_ATTRIBUTES){
+    return TRANSPORT_NO_HANDLE;
+  }
+  this->kinds[this->count] = 'V';
+  this->ids[this->count] = this->count;
+  return this->count++;
+}
+
+void LoopbackHidTransport::start(void)
+{
+  if (this->autoConnect){
+    this->connect(true, BLE_DEFAULT_INTERVAL_US);
+  }
+}
+
+bool LoopbackHidTransport::notify(uint8_t handle, const uint8_t* data, size_t len)
+{
+  if (handle >= this->count){
+    return false;
+  }
+  fprintf(this->out, "%llu %c%u", (unsigned long long)micros(), this->kinds[handle], this->ids[handle]);
+  for (size_t i = 0; i < len; i++){
+    fprintf(this->out, i == 0 ? " %02x" : "%02x", data[i]);
+  }
+  fputc('\n', this->out);
+  return true;
+}
+
+// A bonded host gets back the CCCDs it last wrote, which is every input report unless it
+// unsubscribed one
+void LoopbackHidTransport::connect(bool bonded, uint32_t intervalUs)
+{
+  fprintf(this->out, "# %llu connect%s\n", (unsigned long long)micros(), bonded ? " bonded" : "");
+  this->connected = true;
+  this->bonded = this->bonded || bonded;
+  this->status->onConnect(bonded, intervalUs);
+}
+
+void LoopbackHidTransport::disconnect(void)
+{
+  if (!this->connected){
+    return;
+  }
+  this->connected = false;
+  fprintf(this->out, "# %llu disconnect\n", (unsigned long long)micros());
+  this->status->onDisconnect();
+}
+
+void LoopbackHidTransport::subscribe(uint8_t handle, bool on)
+{
+  this->status->onSubscribe(handle, on);
+}
+
+void LoopbackHidTransport::write(uint8_t handle, const uint8_t* data, size_t len)
+{
+  fprintf(this->out, "# %llu write %u %u bytes\n", (unsigned long long)micros(), handle, (unsigned)len);
+  this->written(handle, data, len);
+}
+
+uint8_t LoopbackHidTransport::find(uint8_t id, HidReportType type) const
+{
+  char kind = type == HID_INPUT_REPORT ? 'I' : type == HID_OUTPUT_REPORT ? 'O' : 'F';
+  for (uint8_t i = 0; i < this->count; i++){
+    if (this->kinds[i] == kind && this->ids[i] == id) return i;
+  }
+  return TRANSPORT_NO_HANDLE;
+}
@@ -0,0 +1,64 @@
+#ifndef ESP32_BLE_LOOPBACK_HID_TRANSPORT_H
+#define ESP32_BLE_LOOPBACK_HID_TRANSPORT_H
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <stdio.h>
+#include "HidTransport.h"
+#include "BleConnectionStatus.h"
+
+// Advertising that goes nowhere; the loopback host connects when it is told to
+class LoopbackAdvertising : public AdvertisingBackend
+{
+public:
+  bool startDirected() { return false; }
+  void startUndirected(uint16_t minInterval, uint16_t maxInterval) {}
+  void stop() {}
+};
+
+// A transport without a radio. Every notification is written to a stdio stream, one line each,
+// in the format tools/replay prints:
+//
+//   <time us> <I|O|F><report id> <hex bytes>     HID reports
+//   <time us> V<handle> <hex bytes>              vendor characteristics
+//   # <time us> <event>                          connects, disconnects and host writes
+//
+// The host side is driven through connect(), disconnect(), subscribe() and write(); it never
+// refuses a notification. Built for every target, so the firmware can also run with its reports
+// going to the serial port through stdout.
+class LoopbackHidTransport : public HidTransport
+{
+public:
+  // With autoConnect a bonded host connects as soon as start() is done, so reports flow at once
+  LoopbackHidTransport(FILE* out, bool autoConnect = false);
+  void begin(const HidDeviceInfo& info, BleConnectionStatus* status);
+  uint8_t addReport(uint8_t id, HidReportType type);
+  void start(void);
+  void beginService(const char* uuid) {}
+  uint8_t addCharacteristic(const char* uuid, uint8_t properties);
+  void endService(void) {}
+  AdvertisingBackend* advertising(void) { return &this->advertisingBackend; }
+  bool notify(uint8_t handle, const uint8_t* data, size_t len);
+  void setValue(uint8_t handle, const uint8_t* data, size_t len) {}
+  void setBatteryLevel(uint8_t level) {}
+  void disconnect(void);                     // Either side may drop the link
+  int bonds(void) { return this->bonded ? 1 : 0; }
+  // Host side
+  void connect(bool bonded, uint32_t intervalUs);
+  void subscribe(uint8_t handle, bool on);
+  void write(uint8_t handle, const uint8_t* data, size_t len);
+  uint8_t find(uint8_t id, HidReportType type) const; // TRANSPORT_NO_HANDLE if there is no such report
+private:
+  FILE* out;
+  BleConnectionStatus* status = nullptr;
+  LoopbackAdvertising advertisingBackend;
+  char kinds[TRANSPORT_MAX_ATTRIBUTES];
+  uint8_t ids[TRANSPORT_MAX_ATTRIBUTES];
+  uint8_t count = 0;
+  bool autoConnect;
+  bool connected = false;
+  bool bonded = false;
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // ESP32_BLE_LOOPBACK_HID_TRANSPORT_H
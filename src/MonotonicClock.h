@@ -0,0 +1,25 @@
+#ifndef MONOTONIC_CLOCK_H
+#define MONOTONIC_CLOCK_H
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+// The firmware's time base: esp_timer's microseconds since boot. At 64 bits it won't wrap for
+// 292,000 years, so deadlines kept on it compare directly. millis() and the uint32_t
+// milliseconds that input events and the engines carry wrap every 49.7 days; they are only ever
+// subtracted over short spans, and widenMs() puts them back on this clock.
+inline uint64_t monotonicUs(){
+  return (uint64_t)esp_timer_get_time();
+}
+
+inline uint64_t monotonicMs(){
+  return monotonicUs() / 1000;
+}
+
+// The time on the 64-bit millisecond clock whose low 32 bits are ms, taking the one nearest
+// reference; right as long as the two are less than 24.8 days apart
+inline uint64_t widenMs(uint32_t ms, uint64_t reference){
+  return reference + (uint64_t)(int64_t)(int32_t)(ms - (uint32_t)reference);
+}
+
+#endif // MONOTONIC_CLOCK_H
@@ -0,0 +1,211 @@
+#include <arduino.h>
+
+#include "NimbleHidTransport.h"
+#if defined(CONFIG_BT_ENABLED) && defined(BLE_TRANSPORT_NIMBLE)
+
+NimbleAdvertisingBackend::NimbleAdvertisingBackend(NimBLEAdvertising* advertising) : advertising(advertising) {
+}
+
+void NimbleAdvertisingBackend::rememberPeer(const NimBLEAddress& address){
+  this->lastPeer = address;
+  this->hasLastPeer = true;
+}
+
+bool NimbleAdvertisingBackend::startDirected(){
+  int bonds = NimBLEDevice::getNumBonds();
+  if (bonds <= 0){
+    return false;
+  }
+  NimBLEAddress peer = this->hasLastPeer && NimBLEDevice::isBonded(this->lastPeer) ?
+                       this->lastPeer : NimBLEDevice::getBondedAddress(bonds - 1);
+  this->advertising->setAdvertisementType(BLE_GAP_CONN_MODE_DIR);
+  return this->advertising->start(RECONNECT_DIRECTED_MS, nullptr, &peer);
+}
+
+void NimbleAdvertisingBackend::startUndirected(uint16_t minInterval, uint16_t maxInterval){
+  this->advertising->setAdvertisementType(BLE_GAP_CONN_MODE_UND);
+  this->advertising->setMinInterval(minInterval);
+  this->advertising->setMaxInterval(maxInterval);
+  this->advertising->start();
+}
+
+void NimbleAdvertisingBackend::stop(){
+  this->advertising->stop();
+}
+
+// Copies the value out of the stack's buffer; NimBLE has no way to look at it in place
+void NimbleAttribute::onWrite(NimBLECharacteristic* pCharacteristic)
+{
+  NimBLEAttValue value = pCharacteristic->getValue();
+  this->transport->written(this->handle, value.data(), value.length());
+}
+
+void NimbleAttribute::onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue)
+{
+  this->transport->status->onSubscribe(this->handle, subValue & 1);
+}
+
+void NimbleAttribute::onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code)
+{
+  this->notified = s == SUCCESS_NOTIFY || s == SUCCESS_INDICATE;
+}
+
+// The GAP handler is a plain function, so it reaches the (single) transport through this
+static NimbleHidTransport* gapTransport = nullptr;
+
+NimbleHidTransport::NimbleHidTransport(void) {
+  gapTransport = this;
+}
+
+void NimbleHidTransport::begin(const HidDeviceInfo& info, BleConnectionStatus* status)
+{
+  this->info = info;
+  this->status = status;
+  NimBLEDevice::init(info.name);
+  NimBLEDevice::setCustomGapHandler(NimbleHidTransport::handleGap);
+  NimBLEDevice::setMTU(BLE_MAX_MTU);
+  NimBLEDevice::setSecurityAuth(true, false, false); // Bonding, as ESP_LE_AUTH_BOND on Bluedroid
+  this->pServer = NimBLEDevice::createServer();
+  this->pServer->setCallbacks(this, false);
+  this->pServer->advertiseOnDisconnect(false); // ReconnectManager owns advertising
+  this->hid = this->hidSlot.create(this->pServer);
+}
+
+uint8_t NimbleHidTransport::add(NimBLECharacteristic* characteristic)
+{
+  if (this->count == TRANSPORT_MAX_ATTRIBUTES){
+    return TRANSPORT_NO_HANDLE;
+  }
+  NimbleAttribute* attribute = &this->attributes[this->count];
+  attribute->transport = this;
+  attribute->characteristic = characteristic;
+  attribute->handle = this->count;
+  characteristic->setCallbacks(attribute);
+  return this->count++;
+}
+
+uint8_t NimbleHidTransport::addReport(uint8_t id, HidReportType type)
+{
+  return this->add(type == HID_INPUT_REPORT ? this->hid->inputReport(id) :
+                   type == HID_OUTPUT_REPORT ? this->hid->outputReport(id) :
+                   this->hid->featureReport(id));
+}
+
+void NimbleHidTransport::start(void)
+{
+  this->hid->manufacturer()->setValue(std::string(this->info.manufacturer));
+
+  this->hid->pnp(0x02, this->info.vendorId, this->info.productId, this->info.version);
+  this->hid->hidInfo(0x00,0x01);
+
+  this->hid->reportMap((uint8_t*)this->info.reportMap, this->info.reportMapSize);
+  this->hid->startServices();
+
+  NimBLEAdvertising* pAdvertising = this->pServer->getAdvertising();
+  pAdvertising->setAppearance(HID_KEYBOARD);
+  pAdvertising->addServiceUUID(this->hid->hidService()->getUUID());
+  this->advertisingBackend = this->advertisingSlot.create(pAdvertising);
+}
+
+void NimbleHidTransport::beginService(const char* uuid)
+{
+  this->service = this->pServer->createService(uuid);
+}
+
+// NimBLE adds the CCCD of a notify characteristic itself
+uint8_t NimbleHidTransport::addCharacteristic(const char* uuid, uint8_t properties)
+{
+  uint32_t flags = 0;
+  bool encrypted = properties & TRANSPORT_ENCRYPTED;
+  if (properties & TRANSPORT_READ) flags |= NIMBLE_PROPERTY::READ;
+  if (properties & TRANSPORT_WRITE) flags |= encrypted ? NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_ENC : NIMBLE_PROPERTY::WRITE;
+  if (properties & TRANSPORT_WRITE_NR) flags |= encrypted ? NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::WRITE_ENC : NIMBLE_PROPERTY::WRITE_NR;
+  if (properties & TRANSPORT_NOTIFY) flags |= NIMBLE_PROPERTY::NOTIFY;
+  return this->add(this->service->createCharacteristic(uuid, flags));
+}
+
+void NimbleHidTransport::endService(void)
+{
+  this->service->start();
+  this->service = nullptr;
+}
+
+AdvertisingBackend* NimbleHidTransport::advertising(void)
+{
+  return this->advertisingBackend;
+}
+
+// notify() reports through onStatus before it returns
+bool NimbleHidTransport::notify(uint8_t handle, const uint8_t* data, size_t len)
+{
+  if (handle >= this->count){
+    return false;
+  }
+  NimbleAttribute* attribute = &this->attributes[handle];
+  attribute->characteristic->setValue(data, len);
+  attribute->notified = true;
+  attribute->characteristic->notify();
+  return attribute->notified;
+}
+
+void NimbleHidTransport::setValue(uint8_t handle, const uint8_t* data, size_t len)
+{
+  if (handle < this->count){
+    this->attributes[handle].characteristic->setValue(data, len);
+  }
+}
+
+void NimbleHidTransport::setBatteryLevel(uint8_t level)
+{
+  if (this->hid != nullptr){
+    this->hid->setBatteryLevel(level);
+  }
+}
+
+// Bonds are looked up by identity address, which NimBLE has already resolved
+void NimbleHidTransport::onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc)
+{
+  NimBLEAddress peer(desc->peer_id_addr);
+  this->connHandle = desc->conn_handle;
+  this->connected = true;
+  if (this->advertisingBackend != nullptr){
+    this->advertisingBackend->rememberPeer(peer);
+  }
+  this->status->onConnect(NimBLEDevice::isBonded(peer), desc->conn_itvl * 1250);
+}
+
+void NimbleHidTransport::onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc)
+{
+  this->connected = false;
+  this->status->onDisconnect();
+}
+
+void NimbleHidTransport::disconnect(void)
+{
+  if (this->connected){
+    this->pServer->disconnect(this->connHandle);
+  }
+}
+
+int NimbleHidTransport::bonds(void)
+{
+  return NimBLEDevice::getNumBonds();
+}
+
+void NimbleHidTransport::onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc)
+{
+  this->status->mtu = MTU;
+}
+
+// Hosts usually renegotiate the interval shortly after connecting
+int NimbleHidTransport::handleGap(ble_gap_event* event, void* arg)
+{
+  ble_gap_conn_desc desc;
+  if (event->type == BLE_GAP_EVENT_CONN_UPDATE && event->conn_update.status == 0 && gapTransport != nullptr &&
+      gapTransport->status != nullptr && ble_gap_conn_find(event->conn_update.conn_handle, &desc) == 0){
+    gapTransport->status->intervalUs = desc.conn_itvl * 1250;
+  }
+  return 0;
+}
+
+#endif // CONFIG_BT_ENABLED && BLE_TRANSPORT_NIMBLE
@@ -0,0 +1,84 @@
+#ifndef ESP32_BLE_NIMBLE_HID_TRANSPORT_H
+#define ESP32_BLE_NIMBLE_HID_TRANSPORT_H
+#include "sdkconfig.h"
+#include "HidTransport.h"
+#if defined(CONFIG_BT_ENABLED) && defined(BLE_TRANSPORT_NIMBLE)
+
+#include <NimBLEDevice.h>
+#include <NimBLEHIDDevice.h>
+#include "BleConnectionStatus.h"
+#include "StaticSlot.h"
+
+// ReconnectManager's schedule on NimBLE's advertising object. NimBLE keeps the bonds, so the
+// directed target is the last peer if it is still bonded, else the most recent bond.
+class NimbleAdvertisingBackend : public AdvertisingBackend
+{
+public:
+  NimbleAdvertisingBackend(NimBLEAdvertising* advertising);
+  bool startDirected();
+  void startUndirected(uint16_t minInterval, uint16_t maxInterval);
+  void stop();
+  void rememberPeer(const NimBLEAddress& address);
+private:
+  NimBLEAdvertising* advertising;
+  NimBLEAddress lastPeer;
+  bool hasLastPeer = false;
+};
+
+class NimbleHidTransport;
+
+// One characteristic: relays the host's writes, its subscriptions and the result of the last notify
+class NimbleAttribute : public NimBLECharacteristicCallbacks
+{
+public:
+  void onWrite(NimBLECharacteristic* pCharacteristic);
+  void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue);
+  void onStatus(NimBLECharacteristic* pCharacteristic, Status s, int code);
+  NimbleHidTransport* transport = nullptr;
+  NimBLECharacteristic* characteristic = nullptr;
+  uint8_t handle = TRANSPORT_NO_HANDLE;
+  bool notified = true;
+};
+
+// NimBLE-Arduino. A smaller host than Bluedroid on the same controller, and it stores bonded
+// hosts' CCCDs itself, so a reconnecting host is subscribed again without help. There is no
+// congestion event: a full buffer shows up as a failed notify, which the channels already retry.
+class NimbleHidTransport : public HidTransport, public NimBLEServerCallbacks
+{
+public:
+  NimbleHidTransport(void);
+  void begin(const HidDeviceInfo& info, BleConnectionStatus* status);
+  uint8_t addReport(uint8_t id, HidReportType type);
+  void start(void);
+  void beginService(const char* uuid);
+  uint8_t addCharacteristic(const char* uuid, uint8_t properties);
+  void endService(void);
+  AdvertisingBackend* advertising(void);
+  bool notify(uint8_t handle, const uint8_t* data, size_t len);
+  void setValue(uint8_t handle, const uint8_t* data, size_t len);
+  void setBatteryLevel(uint8_t level);
+  void disconnect(void);
+  int bonds(void);
+  void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
+  void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
+  void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc);
+  static int handleGap(ble_gap_event* event, void* arg);
+private:
+  friend class NimbleAttribute;
+  uint8_t add(NimBLECharacteristic* characteristic);
+  HidDeviceInfo info;
+  BleConnectionStatus* status = nullptr;
+  NimBLEServer* pServer = nullptr;
+  NimBLEService* service = nullptr; // Vendor service being built
+  NimBLEHIDDevice* hid = nullptr;
+  NimbleAdvertisingBackend* advertisingBackend = nullptr;
+  StaticSlot<NimBLEHIDDevice> hidSlot;
+  StaticSlot<NimbleAdvertisingBackend> advertisingSlot;
+  NimbleAttribute attributes[TRANSPORT_MAX_ATTRIBUTES];
+  uint8_t count = 0;
+  volatile bool connected = false;
+  uint16_t connHandle = 0;
+};
+
+#endif // CONFIG_BT_ENABLED && BLE_TRANSPORT_NIMBLE
+#endif // ESP32_BLE_NIMBLE_HID_TRANSPORT_H
@@ -0,0 +1,44 @@
+#include "OtaFlashBackend.h"
+
+#if defined(CONFIG_ARDUHAL_ESP_LOG)
+  #include "esp32-hal-log.h"
+  #define LOG_TAG ""
+#else
+  #include "esp_log.h"
+  static const char* LOG_TAG = "OTA";
+#endif
+
+bool OtaFlashBackend::begin(uint32_t size){
+  this->abort();
+  this->partition = esp_ota_get_next_update_partition(NULL);
+  if (this->partition == nullptr || size > this->partition->size){
+    ESP_LOGW(LOG_TAG, "No update partition for %u bytes", (unsigned)size);
+    return false;
+  }
+  return esp_ota_begin(this->partition, OTA_WITH_SEQUENTIAL_WRITES, &this->handle) == ESP_OK;
+}
+
+bool OtaFlashBackend::write(const uint8_t* data, size_t len){
+  return esp_ota_write(this->handle, data, len) == ESP_OK;
+}
+
+bool OtaFlashBackend::finish(){
+  esp_err_t err = esp_ota_end(this->handle);
+  this->handle = 0;
+  if (err != ESP_OK){
+    ESP_LOGW(LOG_TAG, "Image rejected: %d", err);
+    return false;
+  }
+  return true;
+}
+
+bool OtaFlashBackend::activate(){
+  return esp_ota_set_boot_partition(this->partition) == ESP_OK;
+}
+
+void OtaFlashBackend::abort(){
+  if (this->handle != 0){
+    esp_ota_abort(this->handle);
+    this->handle = 0;
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef OTA_FLASH_BACKEND_H
+#define OTA_FLASH_BACKEND_H
+
+#include "esp_ota_ops.h"
+#include "FirmwareUpdate.h"
+
+// The inactive app partition through the ESP-IDF OTA API. Sectors are erased as the writes reach
+// them, so starting an update doesn't stall the BLE stack for a whole-partition erase, and
+// esp_ota_end() checks the image before it may be set to boot.
+class OtaFlashBackend : public FlashBackend
+{
+public:
+  bool begin(uint32_t size);
+  bool write(const uint8_t* data, size_t len);
+  bool finish();
+  bool activate();
+  void abort();
+private:
+  const esp_partition_t* partition = nullptr;
+  esp_ota_handle_t handle = 0;
+};
+
+#endif // OTA_FLASH_BACKEND_H
@@ -0,0 +1,133 @@
+#include "ReconnectManager.h"
+
+const uint32_t ReconnectHistogram::bucketLimits[RECONNECT_HISTOGRAM_BUCKETS] = {
+  100, 250, 500, 1000, 2000, 5000, 10000, 30000, 60000, UINT32_MAX
+};
+
+void ReconnectHistogram::record(uint32_t ms){
+  for (int i = 0; i < RECONNECT_HISTOGRAM_BUCKETS; i++){
+    if (ms <= bucketLimits[i]){
+      buckets[i]++;
+      break;
+    }
+  }
+  if (count == 0 || ms < min) min = ms;
+  if (ms > max) max = ms;
+  last = ms;
+  count++;
+}
+
+void ReconnectHistogram::clear(){
+  *this = ReconnectHistogram();
+}
+
+ReconnectManager::ReconnectManager(AdvertisingBackend* backend) : backend(backend) {
+}
+
+// Boot: same schedule as a disconnect, but there is nothing to time
+void ReconnectManager::start(uint32_t now){
+  this->timing = false;
+  this->enter(RECONNECT_DIRECTED, now);
+}
+
+void ReconnectManager::onConnected(uint32_t now){
+  this->post(true, now);
+}
+
+void ReconnectManager::onDisconnected(uint32_t now){
+  this->post(false, now);
+}
+
+// The release store of posted orders the slot's write before it, so update() never reads a half
+// written event; the acquire load of applied keeps a slot update() still reads from being reused
+void ReconnectManager::post(bool connected, uint32_t now){
+  this->linkUp.store(connected, std::memory_order_release);
+  uint8_t at = this->posted.load(std::memory_order_relaxed);
+  uint8_t next = (at + 1) % RECONNECT_EVENTS;
+  if (next == this->applied.load(std::memory_order_acquire)){
+    this->overflows.store(this->overflows.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return;
+  }
+  this->events[at] = {connected, now};
+  this->posted.store(next, std::memory_order_release);
+}
+
+void ReconnectManager::connected(uint32_t now){
+  // The controller stops advertising by itself once a connection is made
+  this->current = RECONNECT_IDLE;
+  this->pairing = false;
+  if (this->timing){
+    this->stats.record(now - this->disconnectedAt);
+    this->timing = false;
+  }
+}
+
+void ReconnectManager::disconnected(uint32_t now){
+  this->disconnectedAt = now;
+  this->timing = !this->pairing;
+  this->enter(this->pairing ? RECONNECT_PAIRING : RECONNECT_DIRECTED, now);
+}
+
+void ReconnectManager::pair(uint32_t now){
+  this->pairing = true;
+  if (this->current != RECONNECT_IDLE){
+    this->enter(RECONNECT_PAIRING, now);
+  }
+}
+
+void ReconnectManager::update(uint32_t now){
+  uint8_t at = this->applied.load(std::memory_order_relaxed);
+  uint8_t end = this->posted.load(std::memory_order_acquire);
+  while (at != end){
+    LinkEvent event = this->events[at];
+    at = (at + 1) % RECONNECT_EVENTS;
+    this->applied.store(at, std::memory_order_release);
+    if (event.connected){
+      this->connected(event.at);
+    } else {
+      this->disconnected(event.at);
+    }
+  }
+  // Changes were lost; follow the link as it is now, without timing it
+  uint8_t overflows = this->overflows.load(std::memory_order_acquire);
+  if (overflows != this->overflowsSeen){
+    this->overflowsSeen = overflows;
+    bool linkUp = this->linkUp.load(std::memory_order_acquire);
+    if (linkUp && this->current != RECONNECT_IDLE){
+      this->timing = false;
+      this->connected(now);
+    } else if (!linkUp && this->current == RECONNECT_IDLE){
+      this->disconnected(now);
+      this->timing = false;
+    }
+  }
+  // An event can be stamped after now was read; its phase has not started yet
+  int32_t elapsed = (int32_t)(now - this->phaseStarted);
+  if (this->current == RECONNECT_DIRECTED && elapsed >= RECONNECT_DIRECTED_MS){
+    this->enter(RECONNECT_FAST, now);
+  } else if (this->current == RECONNECT_FAST && elapsed >= RECONNECT_FAST_MS){
+    this->enter(RECONNECT_SLOW, now);
+  } else if (this->current == RECONNECT_PAIRING && elapsed >= RECONNECT_PAIRING_MS){
+    this->pairing = false;
+    this->enter(RECONNECT_SLOW, now);
+  }
+}
+
+void ReconnectManager::enter(ReconnectPhase next, uint32_t now){
+  this->phaseStarted = now;
+  if (next == RECONNECT_DIRECTED){
+    this->backend->stop();
+    if (this->backend->startDirected()){
+      this->current = RECONNECT_DIRECTED;
+      return;
+    }
+    next = RECONNECT_FAST; // No bonded host to aim at
+  }
+  this->current = next;
+  this->backend->stop();
+  if (next == RECONNECT_FAST || next == RECONNECT_PAIRING){
+    this->backend->startUndirected(RECONNECT_FAST_INTERVAL_MIN, RECONNECT_FAST_INTERVAL_MAX);
+  } else if (next == RECONNECT_SLOW){
+    this->backend->startUndirected(RECONNECT_SLOW_INTERVAL_MIN, RECONNECT_SLOW_INTERVAL_MAX);
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef ESP32_BLE_RECONNECT_MANAGER_H
+#define ESP32_BLE_RECONNECT_MANAGER_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Advertising schedule after a disconnect (or at boot):
+//   1. high-duty directed advertising to the last bonded host (the controller caps it at 1.28s)
+//   2. fast undirected advertising for RECONNECT_FAST_MS
+//   3. slow undirected advertising until a host connects
+// Pairing mode skips the directed phase, so a new host can find the pad, and advertises fast
+// for RECONNECT_PAIRING_MS before dropping to slow advertising.
+#define RECONNECT_DIRECTED_MS 1280
+#define RECONNECT_FAST_MS 30000
+#define RECONNECT_PAIRING_MS 60000
+// Advertising intervals are in 0.625ms units
+#define RECONNECT_FAST_INTERVAL_MIN 0x20 // 20ms
+#define RECONNECT_FAST_INTERVAL_MAX 0x30 // 30ms
+#define RECONNECT_SLOW_INTERVAL_MIN 0x640 // 1s
+#define RECONNECT_SLOW_INTERVAL_MAX 0xFA0 // 2.5s
+
+#define RECONNECT_HISTOGRAM_BUCKETS 10
+#define RECONNECT_EVENTS 8 //Link changes the stack can post before update() applies them
+
+enum ReconnectPhase {
+  RECONNECT_IDLE,
+  RECONNECT_DIRECTED,
+  RECONNECT_FAST,
+  RECONNECT_SLOW,
+  RECONNECT_PAIRING
+};
+
+// Radio side of the reconnect state machine. The ESP32 implementation lives in
+// BleAdvertisingBackend; anything else (e.g. a fake that records calls) can be swapped in.
+class AdvertisingBackend {
+public:
+  virtual ~AdvertisingBackend() {}
+  // Starts high-duty directed advertising to the last bonded host. Returns false if there is none.
+  virtual bool startDirected() = 0;
+  virtual void startUndirected(uint16_t minInterval, uint16_t maxInterval) = 0;
+  virtual void stop() = 0;
+};
+
+// Disconnect-to-reconnect times in milliseconds
+class ReconnectHistogram {
+public:
+  static const uint32_t bucketLimits[RECONNECT_HISTOGRAM_BUCKETS];
+  void record(uint32_t ms);
+  void clear();
+  uint32_t buckets[RECONNECT_HISTOGRAM_BUCKETS] = {};
+  uint32_t count = 0;
+  uint32_t min = 0;
+  uint32_t max = 0;
+  uint32_t last = 0;
+};
+
+// onConnected() and onDisconnected() run on the Bluetooth stack's task. They only post the change
+// and update() applies it, so the schedule, the backend and the histogram are only touched from
+// the task that calls update(), pair() and start().
+class ReconnectManager {
+public:
+  ReconnectManager(AdvertisingBackend* backend);
+  void start(uint32_t now);
+  void onConnected(uint32_t now);
+  void onDisconnected(uint32_t now);
+  void update(uint32_t now);
+  // While connected, pairing starts once the caller has dropped the link
+  void pair(uint32_t now);
+  ReconnectPhase phase() const { return this->current; }
+  const ReconnectHistogram& histogram() const { return this->stats; }
+private:
+  struct LinkEvent {
+    bool connected;
+    uint32_t at;
+  };
+  void post(bool connected, uint32_t now);
+  void connected(uint32_t now);
+  void disconnected(uint32_t now);
+  void enter(ReconnectPhase next, uint32_t now);
+  AdvertisingBackend* backend;
+  LinkEvent events[RECONNECT_EVENTS];
+  // The callbacks and update() run on different cores. Each index has one writer, which publishes
+  // with a release store; the other side reads it with an acquire load before it touches events.
+  std::atomic<uint8_t> posted{0};    // Next event slot; only the callbacks write it
+  std::atomic<uint8_t> applied{0};   // Next event update() applies; only update() writes it
+  std::atomic<uint8_t> overflows{0}; // Events lost to a full ring; only the callbacks write it
+  std::atomic<bool> linkUp{false};   // The link as of the last callback
+  uint8_t overflowsSeen = 0;
+  ReconnectPhase current = RECONNECT_IDLE;
+  uint32_t phaseStarted = 0;
+  uint32_t disconnectedAt = 0;
+  bool timing = false;
+  bool pairing = false;
+  ReconnectHistogram stats;
+};
+
+#endif // ESP32_BLE_RECONNECT_MANAGER_H
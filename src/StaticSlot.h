@@ -0,0 +1,28 @@
+#ifndef STATIC_SLOT_H
+#define STATIC_SLOT_H
+
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+// Storage for one T, reserved at compile time and constructed once later, for objects whose
+// constructor needs something that only exists at run time (the BLE server, the advertising
+// object). Inside a static object it lives in .bss, so it never touches the heap. It is never
+// destroyed, like everything else set up in begin().
+template<typename T>
+class StaticSlot {
+public:
+  template<typename... Args>
+  T* create(Args&&... args){
+    if (this->object == nullptr){
+      this->object = new (this->storage) T(std::forward<Args>(args)...);
+    }
+    return this->object;
+  }
+  T* get() const { return this->object; }
+private:
+  alignas(T) uint8_t storage[sizeof(T)];
+  T* object = nullptr;
+};
+
+#endif // STATIC_SLOT_H
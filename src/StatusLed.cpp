@@ -0,0 +1,128 @@
+#include "StatusLed.h"
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+static const LedSegment offPattern[] = {{0, 0}};
+static const LedSegment pairingPattern[] = {{STATUS_LED_BRIGHT, 400}, {0, 400}};
+static const LedSegment lowBatteryPattern[] = {
+  {STATUS_LED_BRIGHT, 40}, {STATUS_LED_BRIGHT, 60}, {0, 40}, {0, 160},
+  {STATUS_LED_BRIGHT, 40}, {STATUS_LED_BRIGHT, 60}, {0, 40}, {0, 9560}
+};
+static const LedSegment reconnectingPattern[] = {{STATUS_LED_BRIGHT, 40}, {STATUS_LED_BRIGHT, 60}, {0, 40}, {0, 360}};
+static const LedSegment advertisingPattern[] = {{STATUS_LED_DIM, 1500}, {0, 1500}, {0, 3000}};
+static const LedSegment connectedPattern[] = {{STATUS_LED_BRIGHT, 200}, {STATUS_LED_BRIGHT, 600}, {0, 600}};
+
+struct LedPattern {
+  const LedSegment* segments;
+  uint8_t length;
+  bool repeat;
+};
+
+// In StatusLedState order
+static const LedPattern patterns[] = {
+  {offPattern, ARRAY_LENGTH(offPattern), false},
+  {pairingPattern, ARRAY_LENGTH(pairingPattern), true},
+  {lowBatteryPattern, ARRAY_LENGTH(lowBatteryPattern), true},
+  {reconnectingPattern, ARRAY_LENGTH(reconnectingPattern), true},
+  {advertisingPattern, ARRAY_LENGTH(advertisingPattern), true},
+  {connectedPattern, ARRAY_LENGTH(connectedPattern), false}
+};
+
+StatusLed::StatusLed(LedBackend* backend) : backend(backend) {
+}
+
+// A blink code keeps playing through a state change and hands over to the new state when it ends
+void StatusLed::show(StatusLedState state, uint32_t now){
+  if (state == this->current){
+    return;
+  }
+  this->current = state;
+  if (this->codeRepeats == 0){
+    this->change(now);
+  }
+}
+
+void StatusLed::blinkCode(uint8_t count, uint8_t repeats, uint32_t now){
+  if (count == 0 || repeats == 0){
+    return;
+  }
+  if (count > STATUS_LED_BLINK_CODE_MAX){
+    count = STATUS_LED_BLINK_CODE_MAX;
+  }
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < count; i++){
+    this->code[n++] = {STATUS_LED_BRIGHT, 40};
+    this->code[n++] = {STATUS_LED_BRIGHT, 200};
+    this->code[n++] = {0, 40};
+    this->code[n++] = {0, 300};
+  }
+  this->code[n++] = {0, 1200};
+  this->codeRepeats = repeats;
+  this->codeLength = n;
+  this->change(now);
+}
+
+// Starts the blink code, or else the state's pattern. LEDC takes no new duty while a fade runs, and
+// the caller is the HID task, so a change during a fade is left for the update() that ends it.
+void StatusLed::change(uint32_t now){
+  if (this->fading && this->pattern != nullptr && now - this->segmentStarted < this->pattern[this->index].ms){
+    this->pending = true;
+    return;
+  }
+  this->pending = false;
+  if (this->codeRepeats > 0){
+    this->play(this->code, this->codeLength, false, now);
+  } else {
+    const LedPattern& p = patterns[this->current];
+    this->play(p.segments, p.length, p.repeat, now);
+  }
+}
+
+void StatusLed::update(uint32_t now){
+  if (this->pattern == nullptr || now - this->segmentStarted < this->pattern[this->index].ms){
+    return;
+  }
+  if (this->pending){
+    this->change(now);
+  } else if (this->index + 1 < this->length){
+    this->index++;
+    this->next(now);
+  } else if (this->repeat || this->codeRepeats > 1){
+    if (this->codeRepeats > 1){
+      this->codeRepeats--;
+    }
+    this->index = 0;
+    this->next(now);
+  } else if (this->codeRepeats == 1){
+    this->codeRepeats = 0;
+    const LedPattern& p = patterns[this->current];
+    this->play(p.segments, p.length, p.repeat, now);
+  } else {
+    this->pattern = nullptr; // Played once; the LED stays at the last duty
+  }
+}
+
+bool StatusLed::deadline(uint32_t* at) const {
+  if (this->pattern == nullptr){
+    return false;
+  }
+  *at = this->segmentStarted + this->pattern[this->index].ms;
+  return true;
+}
+
+void StatusLed::play(const LedSegment* pattern, uint8_t length, bool repeat, uint32_t now){
+  this->pattern = pattern;
+  this->length = length;
+  this->repeat = repeat;
+  this->index = 0;
+  this->next(now);
+}
+
+void StatusLed::next(uint32_t now){
+  const LedSegment& segment = this->pattern[this->index];
+  this->fading = segment.ms != 0 && segment.duty != this->duty;
+  this->duty = segment.duty;
+  this->backend->fade(segment.duty, segment.ms);
+  this->segmentStarted = now;
+  this->started++;
+}
@@ -0,0 +1,72 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include <stdint.h>
+
+// Status LED patterns as lists of fade segments. Each segment fades the LED to a duty over a time
+// (a hold when the duty doesn't change); the fade itself runs in hardware, so the CPU only touches
+// the LED once per segment. Duties are on the 13 bit LEDC scale and kept low, since the LED runs
+// off the same battery as the radio.
+#define STATUS_LED_MAX_DUTY 8191
+#define STATUS_LED_BRIGHT 2048 //25%
+#define STATUS_LED_DIM 512 //6%
+#define STATUS_LED_BLINK_CODE_MAX 8
+#define STATUS_LED_CODE_SEGMENTS (4 * STATUS_LED_BLINK_CODE_MAX + 1)
+
+struct LedSegment {
+  uint16_t duty;
+  uint16_t ms;
+};
+
+// What the LED shows, most urgent first when several apply (the sketch picks one)
+enum StatusLedState {
+  STATUS_LED_OFF,
+  STATUS_LED_PAIRING,      // Fast breathing while a new host can pair
+  STATUS_LED_LOW_BATTERY,  // Double blip every 10 s
+  STATUS_LED_RECONNECTING, // 2 Hz blink while advertising to get the host back
+  STATUS_LED_ADVERTISING,  // Slow dim breathing once advertising has slowed down
+  STATUS_LED_CONNECTED     // One fade up and down, then off
+};
+
+// Hardware side of the LED. The ESP32 implementation lives in LedcLedBackend.
+class LedBackend {
+public:
+  virtual ~LedBackend() {}
+  // Starts fading to duty over ms and returns at once; ms 0 sets the duty straight away. Must not
+  // be called with a new duty while a fade it started is still running: LEDC waits for it.
+  virtual void fade(uint16_t duty, uint32_t ms) = 0;
+};
+
+// Plays the pattern for the current state. Like ReconnectManager it never reads a clock; the
+// caller passes the time to show() and update(). A state change or blink code that comes while a
+// fade is running starts when that fade ends, on the update() at its deadline.
+class StatusLed {
+public:
+  StatusLed(LedBackend* backend);
+  void show(StatusLedState state, uint32_t now);          // Restarts the pattern only if the state changed
+  void blinkCode(uint8_t count, uint8_t repeats, uint32_t now); // count blinks, repeated, then back to the state
+  void update(uint32_t now);
+  bool deadline(uint32_t* at) const; // When the playing segment ends; false once a pattern has played out
+  StatusLedState state() const { return this->current; }
+  uint32_t segments() const { return this->started; }     // Segments handed to the hardware so far
+private:
+  void change(uint32_t now);
+  void play(const LedSegment* pattern, uint8_t length, bool repeat, uint32_t now);
+  void next(uint32_t now);
+  LedBackend* backend;
+  StatusLedState current = STATUS_LED_OFF;
+  const LedSegment* pattern = nullptr;
+  uint8_t length = 0;
+  uint8_t index = 0;
+  bool repeat = false;
+  uint8_t codeRepeats = 0;
+  uint8_t codeLength = 0;
+  uint16_t duty = 0;       // Where the last segment takes the LED
+  bool fading = false;     // The playing segment started a hardware fade
+  bool pending = false;    // change() waits for that fade to end
+  uint32_t segmentStarted = 0;
+  uint32_t started = 0;
+  LedSegment code[STATUS_LED_CODE_SEGMENTS];
+};
+
+#endif // STATUS_LED_H
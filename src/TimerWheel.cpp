@@ -0,0 +1,86 @@
+#include "TimerWheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+TimerWheel::TimerWheel(){
+  for (int i = 0; i < TIMER_WHEEL_SLOTS; i++){
+    this->slots[i].next = &this->slots[i];
+    this->slots[i].prev = &this->slots[i];
+  }
+}
+
+void TimerWheel::start(uint64_t now){
+  this->current = now;
+}
+
+// Already due goes in the current slot, so the next advance() runs it
+void TimerWheel::schedule(WheelTimer* timer, uint64_t deadline){
+  this->cancel(timer);
+  timer->at = deadline;
+  uint64_t slot = deadline > this->current ? deadline : this->current;
+  this->link(&this->slots[slot & TIMER_WHEEL_MASK], timer);
+  this->count++;
+}
+
+void TimerWheel::cancel(WheelTimer* timer){
+  if (timer->pending()){
+    this->unlink(timer);
+  }
+}
+
+// Walks the slots from the last advance() up to now, the last one again since it may have been
+// scheduled into since. Each slot's list is taken off first: a timer that is not due yet goes
+// back, and one a callback schedules lands in the live list and waits for the next call.
+void TimerWheel::advance(uint64_t now){
+  if (now < this->current){
+    return;
+  }
+  uint64_t from = this->current;
+  uint64_t slots = now - from + 1;
+  if (slots > TIMER_WHEEL_SLOTS){
+    slots = TIMER_WHEEL_SLOTS;
+  }
+  this->current = now;
+  for (uint64_t i = 0; i < slots; i++){
+    WheelTimer* head = &this->slots[(from + i) & TIMER_WHEEL_MASK];
+    if (head->next == head){
+      continue;
+    }
+    WheelTimer taken;
+    taken.next = head->next;
+    taken.prev = head->prev;
+    taken.next->prev = &taken;
+    taken.prev->next = &taken;
+    head->next = head;
+    head->prev = head;
+    while (taken.next != &taken){
+      WheelTimer* timer = taken.next;
+      // Off the list before the callback, so it can schedule the timer again
+      timer->next->prev = &taken;
+      taken.next = timer->next;
+      if (timer->at <= now){
+        timer->next = nullptr;
+        timer->prev = nullptr;
+        this->count--;
+        timer->callbacks->onTimer(timer, now);
+      } else {
+        this->link(head, timer);
+      }
+    }
+  }
+}
+
+void TimerWheel::link(WheelTimer* head, WheelTimer* timer){
+  timer->next = head->next;
+  timer->prev = head;
+  head->next->prev = timer;
+  head->next = timer;
+}
+
+void TimerWheel::unlink(WheelTimer* timer){
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = nullptr;
+  timer->prev = nullptr;
+  this->count--;
+}
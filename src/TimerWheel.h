@@ -0,0 +1,57 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMER_WHEEL_SLOTS 256 //Power of two; one slot per millisecond, deadlines further out go round again
+
+class WheelTimer;
+
+class TimerCallbacks {
+public:
+  virtual ~TimerCallbacks() {}
+  virtual void onTimer(WheelTimer* timer, uint64_t now) = 0;
+};
+
+// One deferred action. The owner keeps it, usually as a member next to the state it acts on, so
+// scheduling never allocates; it links itself into the wheel while pending.
+class WheelTimer {
+public:
+  WheelTimer(TimerCallbacks* callbacks = nullptr) : callbacks(callbacks) {}
+  bool pending() const { return this->next != nullptr; }
+  uint64_t deadline() const { return this->at; }
+private:
+  friend class TimerWheel;
+  TimerCallbacks* callbacks;
+  WheelTimer* next = nullptr;
+  WheelTimer* prev = nullptr;
+  uint64_t at = 0;
+};
+
+// Hashed timer wheel on the 64-bit millisecond clock (see MonotonicClock.h). A timer goes in the
+// slot its deadline hashes to, in a doubly linked list, so schedule() and cancel() are O(1)
+// however many are pending. Like the engines it never reads a clock: advance() is handed the
+// time and runs every timer due by then, in order of their slots.
+//
+// A jump of more than TIMER_WHEEL_SLOTS milliseconds, say after a stall, still visits each slot
+// just once; everything overdue fires in that one call.
+class TimerWheel {
+public:
+  TimerWheel();
+  void start(uint64_t now);                              // Sets the wheel's time without firing anything
+  void schedule(WheelTimer* timer, uint64_t deadline);   // Moves the timer if it was pending
+  void after(WheelTimer* timer, uint32_t ms) { this->schedule(timer, this->current + ms); }
+  void cancel(WheelTimer* timer);
+  void advance(uint64_t now);
+  uint64_t now() const { return this->current; }
+  size_t pending() const { return this->count; }
+private:
+  void link(WheelTimer* head, WheelTimer* timer);
+  void unlink(WheelTimer* timer);
+  WheelTimer slots[TIMER_WHEEL_SLOTS]; // List heads; each list is circular through its head
+  uint64_t current = 0;
+  size_t count = 0;
+};
+
+#endif // TIMER_WHEEL_H
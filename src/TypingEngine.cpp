@@ -0,0 +1,65 @@
+#include "TypingEngine.h"
+
+extern const uint8_t _asciimap[128];
+
+#define SHIFT 0x80
+
+TypingEngine::TypingEngine(const uint8_t* text, size_t size){
+  this->text = text;
+  this->size = size;
+}
+
+// Same mapping as BleKeyboard::press(uint8_t)
+bool TypingEngine::lookup(uint8_t c, uint8_t* modifiers, uint8_t* usage){
+  if (c >= 136){
+    *modifiers = 0;
+    *usage = c - 136;
+  } else if (c >= 128){
+    *modifiers = 1 << (c - 128);
+    *usage = 0;
+  } else {
+    uint8_t k = _asciimap[c];
+    if (!k){
+      return false;
+    }
+    *modifiers = (k & SHIFT) ? 0x02 : 0;
+    *usage = k & ~SHIFT;
+  }
+  return true;
+}
+
+bool TypingEngine::next(uint8_t* modifiers, uint8_t* usage){
+  if (this->done){
+    return false;
+  }
+  while (this->pos < this->size && this->text[this->pos] == '\r'){
+    this->pos++;
+  }
+  uint8_t m, u;
+  if (this->pos == this->size || !this->lookup(this->text[this->pos], &m, &u)){
+    this->done = true;
+    if (this->heldModifiers == 0 && this->heldUsage == 0){
+      return false;
+    }
+    this->heldModifiers = 0;
+    this->heldUsage = 0;
+    *modifiers = 0;
+    *usage = 0;
+    return true;
+  }
+  if ((u != 0 && u == this->heldUsage) || (u == 0 && m == this->heldModifiers)){
+    // Let go of the key without touching the modifiers, the next call presses it again
+    this->heldUsage = 0;
+    if (u == 0) this->heldModifiers = 0;
+    *modifiers = this->heldModifiers;
+    *usage = 0;
+    return true;
+  }
+  this->heldModifiers = m;
+  this->heldUsage = u;
+  this->pos++;
+  this->count++;
+  *modifiers = m;
+  *usage = u;
+  return true;
+}
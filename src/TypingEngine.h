@@ -0,0 +1,31 @@
+#ifndef TYPING_ENGINE_H
+#define TYPING_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Turns text into the shortest key report sequence that types it. Consecutive characters roll
+// over from one report to the next instead of each getting a press and a release, shift stays
+// down across a run of shifted characters, and a release is only inserted between two identical
+// keys, which the host would otherwise see as one held key. The last report releases everything.
+//
+// Stops at the first character with no key, like Print::write. Nothing here touches BLE, so the
+// sequence can be checked and timed off target.
+class TypingEngine {
+public:
+  TypingEngine(const uint8_t* text, size_t size);
+  bool next(uint8_t* modifiers, uint8_t* usage);
+  size_t typed(void) const { return this->count; } // Characters pressed so far
+  bool stopped(void) const { return this->done && this->pos < this->size; } // Hit an untypeable character
+private:
+  bool lookup(uint8_t c, uint8_t* modifiers, uint8_t* usage);
+  const uint8_t* text;
+  size_t size;
+  size_t pos = 0;
+  size_t count = 0;
+  uint8_t heldModifiers = 0;
+  uint8_t heldUsage = 0;
+  bool done = false;
+};
+
+#endif // TYPING_ENGINE_H
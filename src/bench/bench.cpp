@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "bench.h"
+
+static void emptyBench(void){
+}
+
+void Bench::begin(void){
+  this->overhead = 0;
+  this->run(NULL, emptyBench);
+  this->overhead = this->samples[0];
+}
+
+void Bench::run(const char* name, BenchFunction fn, int iterations){
+  if (iterations > BENCH_MAX_SAMPLES) iterations = BENCH_MAX_SAMPLES;
+  fn(); // Warm the cache
+  for (int i = 0; i < iterations; i++){
+    uint32_t start = xthal_get_ccount();
+    fn();
+    uint32_t cycles = xthal_get_ccount() - start;
+    this->samples[i] = cycles > this->overhead ? cycles - this->overhead : 0;
+  }
+  std::sort(this->samples, this->samples + iterations);
+  if (name == NULL){
+    return;
+  }
+  uint64_t total = 0;
+  for (int i = 0; i < iterations; i++){
+    total += this->samples[i];
+  }
+  Serial.printf("{\"bench\":\"%s\",\"iters\":%d,\"min\":%u,\"median\":%u,\"p99\":%u,\"max\":%u,\"mean\":%u,\"unit\":\"cycles\",\"cpu_mhz\":%u}\n",
+                name, iterations,
+                (unsigned)this->samples[0],
+                (unsigned)this->samples[iterations / 2],
+                (unsigned)this->samples[(iterations * 99) / 100],
+                (unsigned)this->samples[iterations - 1],
+                (unsigned)(total / iterations),
+                (unsigned)getCpuFrequencyMhz());
+}
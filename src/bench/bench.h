@@ -0,0 +1,23 @@
+#ifndef OPENDIAL_BENCH_H
+#define OPENDIAL_BENCH_H
+
+#include <arduino.h>
+#include <xtensa/hal.h>
+
+#define BENCH_MAX_SAMPLES 1024
+
+// Times a function with the Xtensa cycle counter, one sample per call, and prints one JSON
+// line per benchmark on serial:
+//   {"bench":"matrix_scan","iters":1000,"min":..,"median":..,"p99":..,"max":..,"mean":..,"unit":"cycles","cpu_mhz":240}
+// The calling overhead of the counter itself is measured once and subtracted.
+class Bench {
+public:
+  typedef void (*BenchFunction)(void);
+  void begin(void);
+  void run(const char* name, BenchFunction fn, int iterations = BENCH_MAX_SAMPLES);
+private:
+  uint32_t samples[BENCH_MAX_SAMPLES];
+  uint32_t overhead = 0;
+};
+
+#endif // OPENDIAL_BENCH_H
@@ -0,0 +1,89 @@
+// Benchmark firmware for the input path; build with `pio run -e bench -t upload` and read the
+// results with `pio device monitor -e bench`. BLE is never started, so the BleKeyboard numbers
+// are report building only: with no subscribed host sendReport returns before any notify.
+// tools/input_bench times the same paths on the host.
+#include <arduino.h>
+
+#include "bench.h"
+#include "../BleKeyboard.h"
+#include "../BluedroidHidTransport.h"
+#include "../matrix.h"
+#include "../keymap.h"
+#include "../InputTrace.h"
+
+Bench bench;
+PadMatrix matrix_handler;
+// The same pins through digitalWrite/digitalRead, to compare with the register scan
+KeyboardMatrix<4, 3, GpioMatrixBackend<PadRowPins, PadColPins>, MATRIX_DIODES> hal_matrix;
+BluedroidHidTransport bench_transport;
+BleKeyboard bleKeyboard(&bench_transport, "Bench", "Bench", 100);
+int changes_buff[PadMatrix::keys];
+int bench_key = 0;
+uint8_t trace_storage[TRACE_BUFFER_SIZE];
+InputTraceBuffer trace(trace_storage, TRACE_BUFFER_SIZE);
+uint64_t trace_time = 0;
+
+void benchMatrixScan(){
+  matrix_handler.scan(changes_buff);
+}
+
+void benchMatrixScanHal(){
+  hal_matrix.scan(changes_buff);
+}
+
+void benchPressRelease(){
+  bleKeyboard.press('a');
+  bleKeyboard.release('a');
+}
+
+void benchPressReleaseModifier(){
+  bleKeyboard.press(KEY_LEFT_CTRL);
+  bleKeyboard.press('z');
+  bleKeyboard.release('z');
+  bleKeyboard.release(KEY_LEFT_CTRL);
+}
+
+void benchRotate(){
+  bleKeyboard.rotate(1);
+}
+
+void benchKeymapDispatch(){
+  keymapPress(&bleKeyboard, bench_key);
+  keymapRelease(&bleKeyboard, bench_key);
+  bench_key = (bench_key + 1) % 11; // Index 11 is the dial button
+}
+
+void benchFeatureReport(){
+  RadialFeatureReport report = {};
+  report.vibration_amount = 25;
+  report.enabled = 1;
+  bleKeyboard.applyFeatureReport(&report);
+}
+
+// Worst case for the recorder: every sample changes both the bitmap and the counter
+void benchTraceSample(){
+  trace_time += 1000;
+  trace.sample(trace_time, trace_time >> 10, trace_time >> 12);
+}
+
+void setup(){
+  Serial.begin(115200);
+  delay(1000);
+  hal_matrix.init();
+  matrix_handler.init();
+  bench.begin();
+}
+
+void loop(){
+  Serial.println("{\"bench_run\":\"start\"}");
+  bench.run("matrix_scan", benchMatrixScan);
+  bench.run("matrix_scan_hal", benchMatrixScanHal);
+  bench.run("keyboard_press_release", benchPressRelease);
+  bench.run("keyboard_press_release_ctrl", benchPressReleaseModifier);
+  bench.run("radial_rotate", benchRotate);
+  bench.run("keymap_dispatch", benchKeymapDispatch);
+  bench.run("feature_report_parse", benchFeatureReport);
+  bench.run("trace_sample", benchTraceSample);
+  Serial.println("{\"bench_run\":\"end\"}");
+  delay(5000);
+}
@@ -42,10 +42,11 @@ void RotaryEncoder::init(){
 }
 
 int16_t RotaryEncoder::getPosition(){
+  return delta(readCounter());
+}
+
+int16_t RotaryEncoder::readCounter(){
   int16_t encoder_count;
   pcnt_get_counter_value(PCNT_UNIT_0, &encoder_count);  
-  int16_t diff = encoder_count - last_encoder_count;
-  last_encoder_count = encoder_count;
-  return diff;
-  
+  return encoder_count;
 }
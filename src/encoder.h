@@ -1,10 +1,22 @@
+#ifndef ROTARY_ENCODER_H
+#define ROTARY_ENCODER_H
+
+#include <stdint.h>
+
 const int PIN_ENC_A = 16;
 const int PIN_ENC_B = 4;
 class RotaryEncoder{
   int16_t last_encoder_count = 0;
-  uint8_t forward_key = '[';
-  uint8_t reverse_key = ']';
   public:
     void init();
     int16_t getPosition();
+    int16_t readCounter();
+    // Steps since the previous counter value; int16_t arithmetic handles the counter wrapping
+    int16_t delta(int16_t encoder_count){
+      int16_t diff = encoder_count - last_encoder_count;
+      last_encoder_count = encoder_count;
+      return diff;
+    }
 };
+
+#endif // ROTARY_ENCODER_H
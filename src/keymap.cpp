@@ -0,0 +1,36 @@
+#include "keymap.h"
+
+//        (from front to back) r1   r2   r3   
+uint8_t key_mapping[12] =   {'s', 'x', 'c',  //purple
+                             'd', 'd', 'f',  //blue
+                             'g', 'z', 'b',  //orange
+                             'k', 'z', KEY_DIAL}; //red
+
+uint8_t ctrl_mapping[12] =   {1, 0, 0,  
+                              0, 0, 0,
+                              0, 1, 0,
+                              0, 1, 0};
+
+uint8_t alt_mapping[12] =    {0, 0, 0,  
+                              0, 0, 0,
+                              0, 0, 0,
+                              0, 0, 0};
+
+uint8_t shift_mapping[12] =  {0, 0, 0,  
+                              1, 0, 0,
+                              0, 0, 0,
+                              0, 1, 0};
+
+void keymapPress(BleKeyboard* keyboard, int k){
+  if (ctrl_mapping[k]) keyboard->press(KEY_LEFT_CTRL);
+  if (alt_mapping[k]) keyboard->press(KEY_LEFT_ALT);
+  if (shift_mapping[k]) keyboard->press(KEY_LEFT_SHIFT);
+  keyboard->press(key_mapping[k]);
+}
+
+void keymapRelease(BleKeyboard* keyboard, int k){
+  if (ctrl_mapping[k]) keyboard->release(KEY_LEFT_CTRL);
+  if (alt_mapping[k]) keyboard->release(KEY_LEFT_ALT);
+  if (shift_mapping[k]) keyboard->release(KEY_LEFT_SHIFT);
+  keyboard->release(key_mapping[k]);
+}
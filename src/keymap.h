@@ -0,0 +1,17 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include "BleKeyboard.h"
+
+#define KEYMAP_SIZE 12
+
+extern uint8_t key_mapping[KEYMAP_SIZE];
+extern uint8_t ctrl_mapping[KEYMAP_SIZE];
+extern uint8_t alt_mapping[KEYMAP_SIZE];
+extern uint8_t shift_mapping[KEYMAP_SIZE];
+
+// Sends the key and modifiers mapped to matrix index k (j * PadMatrix::cols + i)
+void keymapPress(BleKeyboard* keyboard, int k);
+void keymapRelease(BleKeyboard* keyboard, int k);
+
+#endif // KEYMAP_H
@@ -1,17 +1,347 @@
+#ifndef KEYBOARD_MATRIX_H
+#define KEYBOARD_MATRIX_H
+
+#include <arduino.h>
+#include <Wire.h>
+#include <stdint.h>
+#include <soc/gpio_struct.h>
+#include <xtensa/hal.h>
+
 #define KEY_UNPRESS_EVENT 1
 #define KEY_PRESS_EVENT   2
 
-const int COL_PINS = 3;
-const int ROW_PINS = 4;
-const int PIN_ROW[4] = {32, 33, 25, 26};
-const int PIN_COL[3] = {23, 14, 12};
+#define MATRIX_DEBOUNCE_VALUE 3
+#define MATRIX_SETTLE_NS 1000 //Wait after driving a column, for the rows to settle through the internal pull-ups
+
+// Raw switch state, bit j * Cols + i set while the key at row j, column i is down
+typedef uint32_t MatrixBits;
+
+// Pin numbers as a compile-time table
+template<int... P>
+struct MatrixPins {
+  static constexpr int count = sizeof...(P);
+  static constexpr int pins[sizeof...(P)] = {P...};
+};
+template<int... P> constexpr int MatrixPins<P...>::count;
+template<int... P> constexpr int MatrixPins<P...>::pins[sizeof...(P)];
+
+// Bit mask of every pin in a table, bit n for GPIO n
+template<typename Pins, int N = Pins::count>
+struct MatrixPinMask {
+  static constexpr uint64_t value = MatrixPinMask<Pins, N - 1>::value | (uint64_t)1 << Pins::pins[N - 1];
+};
+template<typename Pins>
+struct MatrixPinMask<Pins, 0> {
+  static constexpr uint64_t value = 0;
+};
+
+// Scan backends drive one column at a time and read every row of it in one go:
+//   init()           configure the pins or the chip
+//   select(i)        drive column i low
+//   uint32_t rows()  bit j set while row j reads low
+//   deselect(i)      release column i
+// A full scan is one select/rows/deselect per column, so its cost grows with the columns and
+// whatever one rows() read costs, instead of one pin call per key.
+
+// Columns and rows on ESP32 pins, through the Arduino HAL
+template<typename RowPins, typename ColPins>
+class GpioMatrixBackend {
+public:
+  static constexpr int rowCount = RowPins::count;
+  static constexpr int colCount = ColPins::count;
+
+  void init(){
+    for (int j = 0; j < rowCount; j++){
+      pinMode(RowPins::pins[j], INPUT_PULLUP);
+    }
+    for (int i = 0; i < colCount; i++){
+      pinMode(ColPins::pins[i], OUTPUT);
+      digitalWrite(ColPins::pins[i], HIGH);
+    }
+  }
+  void select(int i){ digitalWrite(ColPins::pins[i], LOW); }
+  void deselect(int i){ digitalWrite(ColPins::pins[i], HIGH); }
+  uint32_t rows(){
+    uint32_t bits = 0;
+    for (int j = 0; j < rowCount; j++){
+      if (!digitalRead(RowPins::pins[j])){
+        bits |= 1 << j;
+      }
+    }
+    return bits;
+  }
+};
+
+// ESP32 GPIO registers, for RegisterGpioBackend. setLow/setHigh take a mask of GPIO 0-31 and
+// change only those pins; read() is every input, bit n for GPIO n, and only touches the input
+// register banks that hold a pin of Mask. settle() busy-waits MATRIX_SETTLE_NS on the cycle
+// counter, with the cycle count worked out from the CPU clock in init().
+template<uint64_t Mask>
+class EspGpioRegisters {
+public:
+  void init(){ this->settleCycles = (uint32_t)MATRIX_SETTLE_NS * getCpuFrequencyMhz() / 1000; }
+  void setLow(uint32_t mask){ GPIO.out_w1tc = mask; }
+  void setHigh(uint32_t mask){ GPIO.out_w1ts = mask; }
+  uint64_t read(){
+    uint64_t in = 0;
+    if (Mask & 0xFFFFFFFFull) in |= GPIO.in;
+    if (Mask >> 32) in |= (uint64_t)GPIO.in1.data << 32;
+    return in;
+  }
+  void settle(){
+    uint32_t start = xthal_get_ccount();
+    while (xthal_get_ccount() - start < this->settleCycles){}
+  }
+private:
+  uint32_t settleCycles = 0;
+};
+
+// Columns and rows on ESP32 pins, through the GPIO registers instead of the HAL: one register
+// write per column change, one read of the input registers for every row, and a fixed settle
+// time after the column goes low, so the sample no longer depends on call overhead. Io is the
+// register access; host tools swap in a model with the same calls.
+template<typename RowPins, typename ColPins, typename Io = EspGpioRegisters<MatrixPinMask<RowPins>::value>>
+class RegisterGpioBackend {
+public:
+  static constexpr int rowCount = RowPins::count;
+  static constexpr int colCount = ColPins::count;
+  static_assert((MatrixPinMask<ColPins>::value >> 32) == 0, "Register columns must be on GPIO 0-31");
+  Io io;
+
+  void init(){
+    for (int j = 0; j < rowCount; j++){
+      pinMode(RowPins::pins[j], INPUT_PULLUP);
+    }
+    for (int i = 0; i < colCount; i++){
+      pinMode(ColPins::pins[i], OUTPUT);
+    }
+    this->io.setHigh((uint32_t)MatrixPinMask<ColPins>::value);
+    this->io.init();
+  }
+  void select(int i){
+    this->io.setLow(1u << ColPins::pins[i]);
+    this->io.settle();
+  }
+  void deselect(int i){ this->io.setHigh(1u << ColPins::pins[i]); }
+  uint32_t rows(){ return rowBits(this->io.read()); }
+
+  // Row bits of one input register sample, bit j set while row j reads low
+  static uint32_t rowBits(uint64_t in){
+    uint32_t bits = 0;
+    for (int j = 0; j < rowCount; j++){
+      if (!(in >> RowPins::pins[j] & 1)){
+        bits |= 1 << j;
+      }
+    }
+    return bits;
+  }
+};
+
+// Columns on ESP32 pins, rows on the parallel inputs of a 74HC165 chain (row 0 on the input that
+// shifts out first). One load pulse samples every row of the column at the same instant.
+template<int Rows, int LoadPin, int ClockPin, int DataPin, typename ColPins>
+class ShiftRegisterBackend {
+public:
+  static constexpr int rowCount = Rows;
+  static constexpr int colCount = ColPins::count;
+
+  void init(){
+    pinMode(LoadPin, OUTPUT);
+    pinMode(ClockPin, OUTPUT);
+    pinMode(DataPin, INPUT);
+    digitalWrite(LoadPin, HIGH);
+    digitalWrite(ClockPin, LOW);
+    for (int i = 0; i < colCount; i++){
+      pinMode(ColPins::pins[i], OUTPUT);
+      digitalWrite(ColPins::pins[i], HIGH);
+    }
+  }
+  void select(int i){ digitalWrite(ColPins::pins[i], LOW); }
+  void deselect(int i){ digitalWrite(ColPins::pins[i], HIGH); }
+  uint32_t rows(){
+    digitalWrite(LoadPin, LOW);
+    digitalWrite(LoadPin, HIGH);
+    uint32_t bits = 0;
+    for (int j = 0; j < Rows; j++){
+      if (!digitalRead(DataPin)){
+        bits |= 1 << j;
+      }
+      digitalWrite(ClockPin, HIGH);
+      digitalWrite(ClockPin, LOW);
+    }
+    return bits;
+  }
+};
+
+// Matrix on an MCP23017: columns on port A, rows on port B with its pull-ups. Selecting a column
+// writes GPIOA, which leaves the register pointer on GPIOB, so reading every row is one
+// repeated-start read: two bus transactions per column whatever the row count.
+// Wire must be started before init().
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IODIRB 0x01
+#define MCP23017_GPPUB 0x0D
+#define MCP23017_GPIOA 0x12
+#define MCP23017_GPIOB 0x13
+#define MCP23017_OLATA 0x14
 
+template<uint8_t Address, int Rows, int Cols>
+class I2cExpanderBackend {
+public:
+  static constexpr int rowCount = Rows;
+  static constexpr int colCount = Cols;
+  static_assert(Rows <= 8 && Cols <= 8, "An MCP23017 port has 8 pins");
 
+  void init(){
+    this->writeRegister(MCP23017_IODIRA, 0x00);
+    this->writeRegister(MCP23017_IODIRB, 0xFF);
+    this->writeRegister(MCP23017_GPPUB, 0xFF);
+    this->writeRegister(MCP23017_OLATA, 0xFF);
+  }
+  void select(int i){
+    Wire.beginTransmission(Address);
+    Wire.write(MCP23017_GPIOA);
+    Wire.write(~(1 << i));
+    Wire.endTransmission(false);
+  }
+  void deselect(int i){}  // The next select() moves the low column on
+  uint32_t rows(){
+    Wire.requestFrom(Address, (uint8_t)1);
+    uint8_t port = Wire.available() ? Wire.read() : 0xFF;
+    return ~port & ((1 << Rows) - 1);
+  }
+private:
+  void writeRegister(uint8_t reg, uint8_t value){
+    Wire.beginTransmission(Address);
+    Wire.write(reg);
+    Wire.write(value);
+    Wire.endTransmission();
+  }
+};
+
+// Keys of a raw sample that a matrix without diodes cannot resolve. Without diodes a held key
+// joins its row and column, so every row and column linked through held keys reads as one full
+// rectangle. A group spanning one row or one column is exactly what is held; a group spanning
+// two or more of both could be any of several key sets, one of them with phantom keys.
+// Groups are found with row-mask operations, so the cost depends on Rows only.
+template<int Rows, int Cols>
+MatrixBits matrixAmbiguous(MatrixBits raw){
+  const MatrixBits colMask = (MatrixBits)(((uint64_t)1 << Cols) - 1);
+  MatrixBits ambiguous = 0;
+  uint32_t grouped = 0;
+  for (int j = 0; j < Rows; j++){
+    MatrixBits cols = (raw >> (j * Cols)) & colMask;
+    if (cols == 0 || (grouped & (1u << j))){
+      continue;
+    }
+    // Pull in every row sharing a column with the group, until it stops growing
+    uint32_t rows = 1u << j;
+    for (bool grew = true; grew; ){
+      grew = false;
+      for (int k = j + 1; k < Rows; k++){
+        MatrixBits other = (raw >> (k * Cols)) & colMask;
+        if (!(rows & (1u << k)) && (other & cols)){
+          rows |= 1u << k;
+          cols |= other;
+          grew = true;
+        }
+      }
+    }
+    grouped |= rows;
+    if ((rows & (rows - 1)) && (cols & (cols - 1))){
+      for (int k = j; k < Rows; k++){
+        if (rows & (1u << k)){
+          ambiguous |= cols << (k * Cols);
+        }
+      }
+    }
+  }
+  return ambiguous;
+}
+
+// Debounced key matrix of Rows x Cols keys on any scan backend. Key index k = j * Cols + i, the
+// same as the bit in the raw sample. Without Diodes, keys that matrixAmbiguous() can't resolve
+// keep their last resolved state until the ambiguity clears, so a phantom key never fires.
+template<int Rows, int Cols, typename Backend, bool Diodes = true>
 class KeyboardMatrix {
+  static_assert(Rows * Cols <= 32, "The raw sample holds at most 32 keys");
+  static_assert(Backend::rowCount == Rows && Backend::colCount == Cols, "Backend pins do not match the matrix size");
   bool initialized = false;
-                       
+  uint8_t debounce[Rows * Cols] = {};
+  MatrixBits resolved = 0;
+  MatrixBits held = 0;
+
   public:
-    int key_pressed[4][3] = {};  
-    void scan(int *buff);
-    void init();
+    static constexpr int rows = Rows;
+    static constexpr int cols = Cols;
+    static constexpr int keys = Rows * Cols;
+    Backend backend;
+
+    void init(){
+      this->backend.init();
+      this->initialized = true;
+    }
+
+    void scan(int *buff){
+      if (!this->initialized){
+        Serial.println("Keyboard Matrix not initialized");
+        return;
+      }
+      this->process(this->sample(), buff);
+    }
+
+    MatrixBits sample(){
+      MatrixBits raw = 0;
+      for (int i = 0; i < Cols; i++){
+        this->backend.select(i);
+        uint32_t bits = this->backend.rows();
+        this->backend.deselect(i);
+        for (int j = 0; j < Rows; j++){
+          if (bits & (1 << j)){
+            raw |= (MatrixBits)1 << (j * Cols + i);
+          }
+        }
+      }
+      return raw;
+    }
+
+    // Debounce one raw sample into press/unpress events
+    void process(MatrixBits raw, int *buff){
+      if (!Diodes){
+        MatrixBits ambiguous = matrixAmbiguous<Rows, Cols>(raw);
+        MatrixBits kept = (raw & ~ambiguous) | (this->resolved & ambiguous);
+        this->held = raw ^ kept;
+        this->resolved = raw = kept;
+      }
+      for (int k = 0; k < Rows * Cols; k++){
+        if (raw & ((MatrixBits)1 << k)){
+          if (this->debounce[k] == MATRIX_DEBOUNCE_VALUE){
+            buff[k] = KEY_PRESS_EVENT;
+          }
+          if (this->debounce[k] <= MATRIX_DEBOUNCE_VALUE){
+            this->debounce[k]++;
+          }
+        } else if (this->debounce[k] != 0){
+          buff[k] = KEY_UNPRESS_EVENT;
+          this->debounce[k] = 0;
+        }
+      }
+    }
+
+    // Keys the last process() held back as ambiguous; always 0 with diodes
+    MatrixBits blocked() const { return this->held; }
 };
+
+// Build the diode-less variant with -DMATRIX_NO_DIODES
+#if defined(MATRIX_NO_DIODES)
+#define MATRIX_DIODES false
+#else
+#define MATRIX_DIODES true
+#endif
+
+// This board: 4 rows x 3 columns on direct GPIO. Another layout is one more typedef, e.g.
+//   typedef KeyboardMatrix<5, 5, I2cExpanderBackend<0x20, 5, 5>> PadMatrix;
+typedef MatrixPins<32, 33, 25, 26> PadRowPins;
+typedef MatrixPins<23, 14, 12> PadColPins;
+typedef KeyboardMatrix<4, 3, RegisterGpioBackend<PadRowPins, PadColPins>, MATRIX_DIODES> PadMatrix;
+
+#endif // KEYBOARD_MATRIX_H
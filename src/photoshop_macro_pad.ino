@@ -1,59 +1,110 @@
-#include "BleConnectionStatus.h"
+#include "HidTransport.h"
 #include "BleKeyboard.h"
-#include "KeyboardOutputCallbacks.h"
+#if defined(BLE_TRANSPORT_NIMBLE)
+#include "NimbleHidTransport.h"
+#elif defined(BLE_TRANSPORT_LOOPBACK)
+#include "LoopbackHidTransport.h"
+#else
+#include "BluedroidHidTransport.h"
+#endif
 
 #include "matrix.h"
 #include "encoder.h"
+#include "InputPipeline.h"
+#include "InputTask.h"
+#include "InputTrace.h"
+#include "BootTimeline.h"
+#include "FirmwareUpdate.h"
+#include "OtaFlashBackend.h"
+#include "StatusLed.h"
+#include "LedcLedBackend.h"
+#include "TimerWheel.h"
+#include "MonotonicClock.h"
+#include "keymap.h"
 
 #include <EEPROM.h>
 
-#define EEPROM_SIZE 13
+#define EEPROM_SIZE (1 + 4 * KEYMAP_SIZE) //Magic byte, then the plain, ctrl, alt and shift tables
 #define EEPROM_MAGIC_BYTE 0x42 //Magic byte; if we've stored a keymapping before, this will be the first byte in the EEPROM. Otherwise use the default.
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
-
-#define DIAL_ROTATION_DIRECTION -1 //Depends on how encoder is wired
-#define DIAL_LONGPRESS_DELAY 400 //Milliseconds before we trigger the vibration on longpress
+#define TRACE_CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a9"
+#define TRACE_NOTIFY_CHUNK 20 //Fits the default ATT MTU
+#define TRACE_NOTIFY_GAP_MS 2 //Lets the BLE stack drain between trace notifications
+#define FIRMWARE_SERVICE_UUID "4fafc201-1fb5-459e-8fcc-c5c9c331914c"
+#define FIRMWARE_CONTROL_UUID "beb5483e-36e1-4688-b7f5-ea07361b26aa"
+#define FIRMWARE_DATA_UUID "beb5483e-36e1-4688-b7f5-ea07361b26ab"
+#define FIRMWARE_RESTART_DELAY_MS 500 //Lets the last acknowledgement go out before rebooting into the new image
+#define HID_TASK_CORE 0
+#define HID_TASK_PRIORITY 2
+#define HID_TASK_STACK 8192
+#define HID_TASK_IDLE_MS 5 //Longest the HID task sleeps without input, so timers run at most this late
+#define SCAN_STATS_INTERVAL 10000 //Milliseconds between scan period reports on serial
+#define HEAP_STATS_INTERVAL 3600000 //Milliseconds between heap reports on serial
+#define BOOT_INPUT_HOLD_MS 3000 //Longest input waits in the queue for the host to reconnect after boot
+#define KEYMAP_SAVE_DELAY_MS 2000 //Quiet time after a keymap write before it goes to flash
+#define PAIR_DEBOUNCE_MS 30
+#define PAIR_HOLD_MS 2000 //Holding the pairing button this long enters pairing mode; a shorter press blinks the bond count
+#define BOND_BLINK_REPEATS 2
+#define LOW_BATTERY_LEVEL 15 //Percent at and below which the LED shows low battery
 const int PIN_LED = 5;
 const int PIN_PAIR = 17;
 const int PIN_VIBRATOR = 13;
 
 bool scan_flag = false;
 int dial_pos = 0;
-float vibe_strength = 100;
-int vibe_until = 0;
-int longpress_trigger = 0;
-
-//        (from front to back) r1   r2   r3   
-uint8_t key_mapping[12] =   {'s', 'x', 'c',  //purple
-                             'd', 'd', 'f',  //blue
-                             'g', 'z', 'b',  //orange
-                             'k', 'z', KEY_DIAL}; //red
-
-uint8_t ctrl_mapping[12] =   {1, 0, 0,  
-                              0, 0, 0,
-                              0, 1, 0,
-                              0, 1, 0};
-
-uint8_t alt_mapping[12] =    {0, 0, 0,  
-                              0, 0, 0,
-                              0, 0, 0,
-                              0, 0, 0};
-
-uint8_t shift_mapping[12] =  {0, 0, 0,  
-                              1, 0, 0,
-                              0, 0, 0,
-                              0, 1, 0};
-
-                               
-KeyboardMatrix matrix_handler;
+volatile bool trace_requested = false;
+volatile bool keymap_dirty = false;
+bool pair_down = false;
+bool pair_held = false;
+uint32_t pair_changed_at = 0;
+
+PadMatrix matrix_handler;
 RotaryEncoder encoder_handler;
+InputTask input_task;
+uint8_t trace_storage[TRACE_BUFFER_SIZE];
+InputTraceBuffer input_trace(trace_storage, TRACE_BUFFER_SIZE);
+BootTimeline boot_timeline;
+OtaFlashBackend ota_flash;
+FirmwareUpdate firmware_update(&ota_flash);
+LedcLedBackend status_led_backend;
+StatusLed status_led(&status_led_backend);
+uint32_t status_led_armed = 0; // status_led.segments() when led_timer was last set
+
+// Every deferred action runs from the HID task's timer wheel
+class hidTimerCallbacks: public TimerCallbacks {
+  public:
+    void onTimer(WheelTimer* timer, uint64_t now);
+};
+hidTimerCallbacks hid_timer_callbacks;
+TimerWheel timers;
+WheelTimer keymap_save_timer(&hid_timer_callbacks);
+WheelTimer pair_hold_timer(&hid_timer_callbacks);
+WheelTimer led_timer(&hid_timer_callbacks);
+WheelTimer stats_timer(&hid_timer_callbacks);
+WheelTimer heap_timer(&hid_timer_callbacks);
+
+class vibratorPin: public HapticBackend {
+    void vibrate(bool on) {
+      digitalWrite(PIN_VIBRATOR, on ? HIGH : LOW);
+    }
+};
+vibratorPin vibrator;
 
 
-BleKeyboard bleKeyboard("Bluetooth Macro Pad", "Victor Noordhoek", 100);
-BLEServer* bleKeyboardServer;
-BLEService* bleKeymappingService;
-BLECharacteristic* bleKeymapping;
+#if defined(BLE_TRANSPORT_NIMBLE)
+NimbleHidTransport ble_transport;
+#elif defined(BLE_TRANSPORT_LOOPBACK)
+LoopbackHidTransport ble_transport(stdout, true); // Reports go to the serial port
+#else
+BluedroidHidTransport ble_transport;
+#endif
+BleKeyboard bleKeyboard(&ble_transport, "Bluetooth Macro Pad", "Victor Noordhoek", 100);
+InputPipeline pipeline(&bleKeyboard, &timers, &vibrator);
+uint8_t bleKeymapping;
+uint8_t bleTrace;
+uint8_t bleFirmwareControl;
+uint8_t bleFirmwareData;
 
 
 
@@ -62,128 +113,358 @@ void IRAM_ATTR keyboard_isr(){
 }
 
 
-class keymapCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
-
-      if (value.length() == 12) {
+// Runs in the BLE stack's task, so the mapping goes to flash later from the HID task, and only
+// if it actually changed
+class keymapCallbacks: public TransportWriter {
+    void onWrite(const uint8_t* data, size_t len) {
+      if (len == KEYMAP_SIZE) {
         Serial.print("New value: ");
-        for (int i = 0; i < 12; i++){
-          Serial.print(value[i]);
-          key_mapping[i] = value[i];
+        bool changed = false;
+        for (int i = 0; i < KEYMAP_SIZE; i++){
+          Serial.print((char)data[i]);
+          changed = changed || key_mapping[i] != data[i];
+          key_mapping[i] = data[i];
         }
         Serial.println();
-        saveKeymap();
+        if (changed){
+          keymap_dirty = true;
+        }
       }
     }
 };
 
+class traceCallbacks: public TransportWriter {
+    void onWrite(const uint8_t* data, size_t len) {
+      trace_requested = true;
+    }
+};
+
+// Runs in the BLE stack's task, so every chunk goes to flash as it arrives; the window keeps the
+// client from getting further ahead than the stack can buffer meanwhile
+class firmwareCallbacks: public TransportWriter {
+  public:
+    firmwareCallbacks(bool control) : control(control) {}
+    void onWrite(const uint8_t* data, size_t len) {
+      uint8_t reply[FIRMWARE_UPDATE_REPLY_SIZE];
+      size_t n;
+      firmware_update.setMtu(bleKeyboard.mtu());
+      if (this->control){
+        n = firmware_update.control(data, len, millis(), reply);
+      } else {
+        n = firmware_update.data(data, len, millis(), reply);
+      }
+      if (n > 0){
+        ble_transport.notify(bleFirmwareControl, reply, n);
+      }
+    }
+  private:
+    bool control;
+};
+
+// Callbacks live as long as the services, so they are static rather than new'd
+keymapCallbacks keymap_callbacks;
+traceCallbacks trace_callbacks;
+firmwareCallbacks firmware_control_callbacks(true);
+firmwareCallbacks firmware_data_callbacks(false);
+
 void loadKeymap(){
-  for (int i = 0; i < 12; i++){
+  for (int i = 0; i < KEYMAP_SIZE; i++){
       key_mapping[i] = EEPROM.read(i + 1);
-      ctrl_mapping[i] = EEPROM.read((i+ 12) + 1);
-      alt_mapping[i] = EEPROM.read((i + 24) + 1);
-      shift_mapping[i] = EEPROM.read((i + 36) + 1);
+      ctrl_mapping[i] = EEPROM.read((i + KEYMAP_SIZE) + 1);
+      alt_mapping[i] = EEPROM.read((i + 2 * KEYMAP_SIZE) + 1);
+      shift_mapping[i] = EEPROM.read((i + 3 * KEYMAP_SIZE) + 1);
   }
 }
-void saveKeymap(){
-  EEPROM.write(0, EEPROM_MAGIC_BYTE);
-    for (int i = 0; i < 12; i++){
-      EEPROM.write(i + 1, key_mapping[i]);
-      EEPROM.write(i + 12 + 1, ctrl_mapping[i]);
-      EEPROM.write(i + 24 + 1, alt_mapping[i]);
-      EEPROM.write(i + 25 + 1, shift_mapping[i]);
-    }
-}
-void vibratorOn(){
-  digitalWrite(PIN_VIBRATOR, HIGH);
-}
-
-void vibratorOff(){
-  digitalWrite(PIN_VIBRATOR, LOW);
+// Writes only the bytes that differ and commits only if there were any, so saving an unchanged
+// keymap never touches flash
+void saveKeymapByte(int address, uint8_t value, bool* changed){
+  if (EEPROM.read(address) != value){
+    EEPROM.write(address, value);
+    *changed = true;
+  }
 }
-void vibratorCheck(){
-  if (vibe_until > millis()){
-    digitalWrite(PIN_VIBRATOR, HIGH);
-  } else {
-    digitalWrite(PIN_VIBRATOR, LOW);
+void saveKeymap(){
+  bool changed = false;
+  saveKeymapByte(0, EEPROM_MAGIC_BYTE, &changed);
+  for (int i = 0; i < KEYMAP_SIZE; i++){
+    saveKeymapByte(i + 1, key_mapping[i], &changed);
+    saveKeymapByte(i + KEYMAP_SIZE + 1, ctrl_mapping[i], &changed);
+    saveKeymapByte(i + 2 * KEYMAP_SIZE + 1, alt_mapping[i], &changed);
+    saveKeymapByte(i + 3 * KEYMAP_SIZE + 1, shift_mapping[i], &changed);
+  }
+  if (changed){
+    EEPROM.commit();
   }
 }
+// Boot in order of what a key press right after wake needs: scanning first, so input is sampled
+// and queued within milliseconds; then the keymap and the BLE stack up to advertising; then the
+// HID task; then the services no host needs for typing. The HID task holds queued input until
+// the host is back (see hidTask), so presses made while BLE starts reach the host: dial turns
+// merge into one event while it waits, and releases have slots of their own (see InputTask).
 void setup() {
-  // put your setup code here, to run once:
-  
+  boot_timeline.mark("setup");
+  matrix_handler.init();
+  encoder_handler.init();
+  pinMode(PIN_VIBRATOR, OUTPUT);
+  digitalWrite(PIN_VIBRATOR, LOW);
+  pinMode(PIN_PAIR, INPUT_PULLUP);
+  input_task.start(&matrix_handler, &encoder_handler, &input_trace);
+  boot_timeline.mark("input");
+
   Serial.begin(115200);
-  
+  boot_timeline.mark("serial");
+
   EEPROM.begin(EEPROM_SIZE);
   //Check if we've saved a keymap to EEPROM before; if so load it, if not, use the default. 
   if (EEPROM.read(0) == EEPROM_MAGIC_BYTE){
-    //loadKeymap();
+    loadKeymap();
   }
-  
+  boot_timeline.mark("keymap");
+
   bleKeyboard.begin();
- 
-  bleKeymappingService = bleKeyboard.pServer->createService(SERVICE_UUID);
-  bleKeymapping = bleKeymappingService->createCharacteristic(CHARACTERISTIC_UUID, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
-  bleKeymapping->setValue((uint8_t*)key_mapping, 12);
-  bleKeymapping->setCallbacks(new keymapCallbacks());
-  bleKeymappingService->start();
-  
-  matrix_handler.init();
-  encoder_handler.init();
-  pinMode(PIN_VIBRATOR, OUTPUT);
-  digitalWrite(PIN_VIBRATOR, LOW);
-  saveKeymap();
+  boot_timeline.mark("advertising");
+  xTaskCreatePinnedToCore(hidTask, "hid", HID_TASK_STACK, NULL, HID_TASK_PRIORITY, NULL, HID_TASK_CORE);
+  boot_timeline.mark("hid_task");
+
+  // Services are numbered in the order they are created, so the attribute handles are the
+  // same every boot and a bonded host's cached copy of the database stays valid
+  ble_transport.beginService(SERVICE_UUID);
+  bleKeymapping = ble_transport.addCharacteristic(CHARACTERISTIC_UUID, TRANSPORT_READ | TRANSPORT_WRITE);
+  ble_transport.setValue(bleKeymapping, key_mapping, KEYMAP_SIZE);
+  ble_transport.setWriter(bleKeymapping, &keymap_callbacks);
+  bleTrace = ble_transport.addCharacteristic(TRACE_CHARACTERISTIC_UUID, TRANSPORT_WRITE | TRANSPORT_NOTIFY);
+  ble_transport.setWriter(bleTrace, &trace_callbacks);
+  ble_transport.endService();
+
+  // Only a bonded host can flash the pad
+  ble_transport.beginService(FIRMWARE_SERVICE_UUID);
+  bleFirmwareControl = ble_transport.addCharacteristic(FIRMWARE_CONTROL_UUID, TRANSPORT_WRITE | TRANSPORT_NOTIFY | TRANSPORT_ENCRYPTED);
+  ble_transport.setWriter(bleFirmwareControl, &firmware_control_callbacks);
+  bleFirmwareData = ble_transport.addCharacteristic(FIRMWARE_DATA_UUID, TRANSPORT_WRITE_NR | TRANSPORT_ENCRYPTED);
+  ble_transport.setWriter(bleFirmwareData, &firmware_data_callbacks);
+  ble_transport.endService();
+  status_led_backend.begin(PIN_LED);
+  boot_timeline.mark("services");
+
   //esp_sleep_enable_gpio_wakeup();
+  if (input_task.firstScanUs() != 0){
+    boot_timeline.mark("first_scan", input_task.firstScanUs());
+  }
+  printBootTimeline();
+  printHeap();
 }
 
-void loop() {
-  vibratorCheck();
-  int changes_buff[12] = {};
-  matrix_handler.scan(changes_buff);
-  for (int j = 0; j < 4; j++){
-    for (int i = 0; i < 3; i++){
-      if (changes_buff[j * 3 + i] == KEY_PRESS_EVENT){
-        if (key_mapping[j*3 + i] == KEY_DIAL){
-          bleKeyboard.pressDial();
-          longpress_trigger = millis() + DIAL_LONGPRESS_DELAY;
-        } else {
-          
-          if (ctrl_mapping[j*3+i]) bleKeyboard.press(KEY_LEFT_CTRL);
-          if (alt_mapping[j*3+i]) bleKeyboard.press(KEY_LEFT_ALT);
-          if (shift_mapping[j*3+i]) bleKeyboard.press(KEY_LEFT_SHIFT);
-          bleKeyboard.press(key_mapping[j*3 + i]);
-          
-        }
-      } else if (changes_buff[j * 3 + i] == KEY_UNPRESS_EVENT){
-        if (key_mapping[j*3 + i] == KEY_DIAL){
-          bleKeyboard.releaseDial();
-          longpress_trigger = 0;
-        } else {
-          if (ctrl_mapping[j*3+i]) bleKeyboard.release(KEY_LEFT_CTRL);
-          if (alt_mapping[j*3+i]) bleKeyboard.release(KEY_LEFT_ALT);
-          if (shift_mapping[j*3+i]) bleKeyboard.release(KEY_LEFT_SHIFT);
-          bleKeyboard.release(key_mapping[j*3 + i]);
-        }
+// One line per stage in microseconds since the app started, then the two numbers to watch
+void printBootTimeline(){
+  for (size_t i = 0; i < boot_timeline.count(); i++){
+    const BootStage& stage = boot_timeline.stage(i);
+    Serial.printf("boot %s at %u us\n", stage.name, (unsigned)stage.us);
+  }
+  Serial.printf("boot time to first scan %u us, to advertising %u us\n",
+                (unsigned)boot_timeline.at("first_scan"), (unsigned)boot_timeline.at("advertising"));
+}
+
+// Snapshot of the input trace, freed by the caller. Copied a chunk at a time under the input
+// task's lock so the copy is consistent, then sent without holding it.
+uint8_t* takeTrace(size_t* len){
+  size_t max = input_task.traceSnapshotSize() + TRACE_RECORD_MAX;
+  uint8_t* copy = (uint8_t*)malloc(max);
+  if (copy == NULL) return NULL;
+  *len = input_task.traceSnapshot(copy, max);
+  if (*len == 0){
+    free(copy);
+    return NULL;
+  }
+  return copy;
+}
+
+// Hex between TRACE-BEGIN and TRACE-END lines, which tools/replay reads back
+void dumpTraceSerial(){
+  size_t len;
+  uint8_t* trace = takeTrace(&len);
+  if (trace == NULL){
+    Serial.println("TRACE-EMPTY");
+    return;
+  }
+  Serial.printf("TRACE-BEGIN %u\n", (unsigned)len);
+  for (size_t i = 0; i < len; i++){
+    Serial.printf("%02x", trace[i]);
+    if (i % 32 == 31 || i == len - 1) Serial.println();
+  }
+  Serial.println("TRACE-END");
+  free(trace);
+}
+
+// Little endian length, then the snapshot in TRACE_NOTIFY_CHUNK byte notifications
+void dumpTraceGatt(){
+  size_t len;
+  uint8_t* trace = takeTrace(&len);
+  uint8_t header[4] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24)};
+  if (trace == NULL) len = 0;
+  ble_transport.notify(bleTrace, header, 4);
+  for (size_t i = 0; i < len; i += TRACE_NOTIFY_CHUNK){
+    size_t n = len - i < TRACE_NOTIFY_CHUNK ? len - i : TRACE_NOTIFY_CHUNK;
+    ble_transport.notify(bleTrace, trace + i, n);
+    vTaskDelay(pdMS_TO_TICKS(TRACE_NOTIFY_GAP_MS));
+  }
+  free(trace);
+}
+
+// The new image is verified and set to boot; report the transfer and restart into it
+void finishFirmwareUpdate(){
+  const FirmwareUpdateStats& stats = firmware_update.stats();
+  uint32_t rate = stats.bytesPerSecond();
+  Serial.printf("firmware update %u bytes in %u ms, %u.%u KB/s, rewinds %u resumes %u\n",
+                (unsigned)stats.bytes, (unsigned)(stats.finishedAt - stats.startedAt),
+                (unsigned)(rate / 1024), (unsigned)(rate % 1024 * 10 / 1024),
+                (unsigned)stats.rewinds, (unsigned)stats.resumes);
+  vTaskDelay(pdMS_TO_TICKS(FIRMWARE_RESTART_DELAY_MS));
+  ESP.restart();
+}
+
+// Free heap next to the largest block one allocation could still get; the two drifting apart
+// over hours of use would mean something keeps fragmenting the heap
+void printHeap(){
+  Serial.printf("heap at %u s free %u largest %u min free %u\n", (unsigned)(millis() / 1000),
+                (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxAllocHeap(), (unsigned)ESP.getMinFreeHeap());
+}
+
+void printScanStats(){
+  ScanPeriodStats stats = input_task.stats();
+  input_task.resetStats();
+  if (stats.count == 0) return;
+  Serial.printf("scan period us min %u avg %u max %u overruns %u dropped %u merged %u ghosted %u\n",
+                (unsigned)stats.minUs, (unsigned)(stats.totalUs / stats.count), (unsigned)stats.maxUs,
+                (unsigned)stats.overruns, (unsigned)stats.dropped, (unsigned)stats.merged, (unsigned)stats.ghosted);
+  // Cumulative, to compare one transport's notify cost against another's
+  const HidQueueStats& queue = bleKeyboard.queueStats();
+  if (queue.notifies == 0) return;
+  Serial.printf("notify us n %u avg %u max %u\n", (unsigned)queue.notifies,
+                (unsigned)(queue.notifyUs / queue.notifies), (unsigned)queue.maxNotifyUs);
+}
+
+// Most urgent first: pairing, then low battery while connected, then the state of the link
+StatusLedState statusLedState(){
+  ReconnectPhase phase = bleKeyboard.reconnectPhase();
+  if (phase == RECONNECT_PAIRING){
+    return STATUS_LED_PAIRING;
+  }
+  if (bleKeyboard.isConnected()){
+    return bleKeyboard.batteryLevel <= LOW_BATTERY_LEVEL ? STATUS_LED_LOW_BATTERY : STATUS_LED_CONNECTED;
+  }
+  if (phase == RECONNECT_DIRECTED || phase == RECONNECT_FAST){
+    return STATUS_LED_RECONNECTING;
+  }
+  return phase == RECONNECT_SLOW ? STATUS_LED_ADVERTISING : STATUS_LED_OFF;
+}
+
+// The fades run in hardware; led_timer only starts the next segment once the last one has played
+void statusLedCheck(uint32_t now){
+  status_led.show(statusLedState(), now);
+  if (status_led.segments() != status_led_armed){
+    statusLedArm();
+  }
+}
+
+void statusLedArm(){
+  uint32_t at;
+  status_led_armed = status_led.segments();
+  if (status_led.deadline(&at)){
+    timers.schedule(&led_timer, widenMs(at, timers.now()));
+  } else {
+    timers.cancel(&led_timer);
+  }
+}
+
+// The button pulls PIN_PAIR low. A press shorter than PAIR_HOLD_MS blinks the number of bonded
+// hosts; holding it drops the current host and lets a new one pair.
+void pairButtonCheck(uint32_t now){
+  bool down = digitalRead(PIN_PAIR) == LOW;
+  if (down != pair_down && now - pair_changed_at >= PAIR_DEBOUNCE_MS){
+    pair_down = down;
+    pair_changed_at = now;
+    if (down){
+      timers.after(&pair_hold_timer, PAIR_HOLD_MS);
+    } else {
+      timers.cancel(&pair_hold_timer);
+      if (!pair_held){
+        status_led.blinkCode(bleKeyboard.bonds(), BOND_BLINK_REPEATS, now);
       }
-      changes_buff[j * 3 + i] = 0;
     }
+    pair_held = false;
   }
+}
 
-  if (longpress_trigger > 0 && longpress_trigger < millis()){
-    vibe_until = millis() + vibe_strength;
-    longpress_trigger = 0;
-  }
-  int d = encoder_handler.getPosition();
-  if (d != 0){
-    
-    bleKeyboard.dial_pos += d;
-    if (bleKeyboard.dial_pos % bleKeyboard.dial_interval == 0){
-      bleKeyboard.dial_pos = 0;
-      bleKeyboard.rotate(d * DIAL_ROTATION_DIRECTION);
-      if (bleKeyboard.dial_vibrate){
-        vibe_until = millis() + vibe_strength;
-        vibratorCheck();
-      }
+void hidTimerCallbacks::onTimer(WheelTimer* timer, uint64_t now){
+  if (timer == &keymap_save_timer){
+    saveKeymap();
+  } else if (timer == &pair_hold_timer){
+    pair_held = true;
+    Serial.printf("pairing for %u s\n", (unsigned)(RECONNECT_PAIRING_MS / 1000));
+    bleKeyboard.startPairing();
+  } else if (timer == &led_timer){
+    status_led.update((uint32_t)now);
+    statusLedArm();
+  } else if (timer == &stats_timer){
+    printScanStats();
+    timers.after(&stats_timer, SCAN_STATS_INTERVAL);
+  } else if (timer == &heap_timer){
+    printHeap();
+    timers.after(&heap_timer, HEAP_STATS_INTERVAL);
+  }
+}
+
+// Owns bleKeyboard and the timer wheel: every report, the vibrator, the status LED and the
+// gesture timers are driven from here. The wheel runs on the 64-bit clock, so nothing here
+// compares wrapping times against a deadline.
+// Input sampled while the host reconnects after boot stays in the queue, with its sample times,
+// until the host is back or BOOT_INPUT_HOLD_MS has passed; sent earlier it would be dropped
+void hidTask(void* arg){
+  timers.start(monotonicMs());
+  timers.after(&stats_timer, SCAN_STATS_INTERVAL);
+  timers.after(&heap_timer, HEAP_STATS_INTERVAL);
+  bool holding = true;
+  for (;;){
+    InputEvent event;
+    if (holding && (bleKeyboard.isConnected() || millis() >= BOOT_INPUT_HOLD_MS)){
+      holding = false;
+      Serial.printf("boot input released at %u us, host %s\n", (unsigned)micros(),
+                    bleKeyboard.isConnected() ? "connected" : "not connected");
+    }
+    if (holding){
+      vTaskDelay(pdMS_TO_TICKS(HID_TASK_IDLE_MS));
+    } else if (input_task.receive(&event, pdMS_TO_TICKS(HID_TASK_IDLE_MS))){
+      do {
+        if (event.type == INPUT_EVENT_KEY){
+          pipeline.key(event.key, event.value, event.time);
+        } else if (event.type == INPUT_EVENT_DIAL){
+          pipeline.dial(event.value, event.time);
+        }
+      } while (input_task.receive(&event, 0));
+    }
+    bleKeyboard.update();
+    timers.advance(monotonicMs());
+    pairButtonCheck((uint32_t)timers.now());
+    statusLedCheck((uint32_t)timers.now());
+    if (Serial.available() && Serial.read() == 't'){
+      dumpTraceSerial();
+    }
+    if (trace_requested){
+      trace_requested = false;
+      dumpTraceGatt();
+    }
+    // Each write starts the quiet time over
+    if (keymap_dirty){
+      keymap_dirty = false;
+      timers.after(&keymap_save_timer, KEYMAP_SAVE_DELAY_MS);
+    }
+    if (firmware_update.state() == FW_STATE_DONE){
+      finishFirmwareUpdate();
     }
   }
 }
+
+void loop() {
+  // Input sampling and reporting run in their own tasks
+  vTaskDelete(NULL);
+}
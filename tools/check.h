@@ -0,0 +1,33 @@
+// Pass/fail lines shared by the host tools. Each check prints one JSON line through checkLine(),
+// which appends its "ok" and counts it if it failed; main() returns checkStatus(), so `make check`
+// in tools/ stops on a tool with any failed line.
+#ifndef TOOLS_CHECK_H
+#define TOOLS_CHECK_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+static inline const char* jsonBool(bool value){
+  return value ? "true" : "false";
+}
+
+// Prints {<fields>,"ok":<ok>}; the format holds the fields without the braces
+static bool checkLine(bool ok, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static bool checkLine(bool ok, const char* format, ...){
+  va_list args;
+  va_start(args, format);
+  putchar('{');
+  vprintf(format, args);
+  va_end(args);
+  printf(",\"ok\":%s}\n", jsonBool(ok));
+  if (!ok) checkFailures++;
+  return ok;
+}
+
+static inline int checkStatus(){
+  return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,121 @@
+// Host check of the dial's key tap mode. Spins the dial at scripted speeds through
+// InputPipeline, decodes the key reports a host would see, and checks that every step turned
+// into exactly one tap and that no one-second window holds more taps than the rate cap allows
+// (maxRate, plus the burst the bucket starts with). With the opt-in backlog cap set, steps past
+// it are dropped instead and taps must stop within maxPendingMs of the dial. Prints one JSON
+// line per spin.
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "BluedroidHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define USAGE_FORWARD 0x2F // '['
+#define USAGE_REVERSE 0x30 // ']'
+
+static KeyReport last;
+static std::vector<uint32_t> tapTimes;
+static long net;
+
+// A key that is in this report but not the previous one is a tap
+static bool linkNotify(BLECharacteristic* characteristic){
+  if (characteristic->reportId != KEYBOARD_ID || characteristic->kind != 'I'){
+    return true;
+  }
+  const KeyReport* report = (const KeyReport*)characteristic->getData();
+  for (int i = 0; i < 6; i++){
+    uint8_t k = report->keys[i];
+    bool held = false;
+    for (int j = 0; j < 6; j++){
+      held = held || (k != 0 && last.keys[j] == k);
+    }
+    if (held) continue;
+    if (k == USAGE_FORWARD || k == USAGE_REVERSE){
+      tapTimes.push_back(replay_clock_us / 1000);
+      net += k == USAGE_FORWARD ? 1 : -1;
+    }
+  }
+  last = *report;
+  return true;
+}
+
+static BleKeyboard* connect(){
+  BluedroidHidTransport* transport = new BluedroidHidTransport();
+  BleKeyboard* keyboard = new BleKeyboard(transport, "Bench", "Bench", 100);
+  keyboard->begin();
+  esp_ble_gatts_cb_param_t param = {};
+  param.connect.conn_params.interval = 12;
+  transport->server()->callbacks->onConnect(transport->server());
+  transport->server()->callbacks->onConnect(transport->server(), &param);
+  return keyboard;
+}
+
+static void step(BleKeyboard* keyboard, TimerWheel* timers){
+  replay_clock_us += 1000;
+  timers->advance(replay_clock_us / 1000);
+  keyboard->update();
+}
+
+// Spins stepsPerSecond for spinMs in one direction, then lets the carried taps drain
+static void spin(int stepsPerSecond, uint32_t spinMs, int direction, uint16_t maxPendingMs){
+  BleKeyboard* keyboard = connect();
+  TimerWheel timers;
+  InputPipeline pipeline(keyboard, &timers);
+  pipeline.dial_keys.config.maxPendingMs = maxPendingMs;
+  keyboard->setDialOutput(DIAL_OUTPUT_KEYS);
+  replay_clock_us = 0;
+  last = KeyReport();
+  tapTimes.clear();
+  net = 0;
+  replay_notify = linkNotify;
+
+  long steps = 0;
+  for (uint32_t ms = 0; ms < spinMs; ms++){
+    long due = (long)(ms + 1) * stepsPerSecond / 1000;
+    for (; steps < due; steps++){
+      // The pipeline applies DIAL_ROTATION_DIRECTION, so undo it to spin in direction
+      pipeline.dial(direction * DIAL_ROTATION_DIRECTION, replay_clock_us / 1000);
+    }
+    step(keyboard, &timers);
+  }
+  uint32_t spinEnd = replay_clock_us / 1000;
+  for (int ms = 0; ms < 60000 && pipeline.dial_keys.pending() != 0; ms++){
+    step(keyboard, &timers);
+  }
+  step(keyboard, &timers);
+
+  const DialKeysConfig& config = pipeline.dial_keys.config;
+  size_t maxWindow = 0;
+  for (size_t i = 0, j = 0; i < tapTimes.size(); i++){
+    while (tapTimes[i] - tapTimes[j] >= 1000) j++;
+    if (i - j + 1 > maxWindow) maxWindow = i - j + 1;
+  }
+  uint32_t drainMs = tapTimes.empty() ? 0 : tapTimes.back() - spinEnd;
+  long dropped = pipeline.dial_keys.dropped();
+  bool counted = maxPendingMs == 0 ? dropped == 0 && (long)tapTimes.size() == steps && net == direction * steps
+                                    : net == direction * (steps - dropped) && drainMs <= maxPendingMs;
+  bool ok = counted && maxWindow <= (size_t)config.maxRate + config.burst;
+  checkLine(ok, "\"steps_per_s\":%d,\"spin_ms\":%u,\"max_pending_ms\":%u,\"steps\":%ld,\"dropped\":%ld,\"taps\":%zu,\"net\":%ld,"
+            "\"max_taps_per_s\":%zu,\"cap\":%u,\"drain_ms\":%u",
+            stepsPerSecond, spinMs, maxPendingMs, steps, dropped, tapTimes.size(), net, maxWindow,
+            config.maxRate + config.burst, drainMs);
+  replay_notify = NULL;
+}
+
+int main(int argc, char** argv){
+  spin(5, 2000, 1, 0);       // Slow, one tap per step as it happens
+  spin(30, 2000, -1, 0);     // At the cap
+  spin(120, 1000, 1, 0);     // Fast spin, every step carries over and is tapped out
+  spin(1000, 500, -1, 0);    // Flick, the same
+  spin(120, 1000, 1, 2000);  // With the backlog cap, taps carry over up to it
+  spin(1000, 500, -1, 2000); // Flick, most of it dropped
+  return checkStatus();
+}
@@ -0,0 +1,30 @@
+# Firmware sources the host tools build against the replay shim, so a new module is added here
+# once. Include it after setting SRC; a tool adds one of the transports and its own files.
+SHIM = ../replay/shim
+
+# BleKeyboard and what it always links
+KEYBOARD_SOURCES = \
+	$(SRC)/BleKeyboard.cpp \
+	$(SRC)/BleConnectionStatus.cpp \
+	$(SRC)/KeyboardOutputCallbacks.cpp \
+	$(SRC)/ReconnectManager.cpp \
+	$(SRC)/TypingEngine.cpp
+
+# InputPipeline and its engines
+PIPELINE_SOURCES = \
+	$(SRC)/DialGestures.cpp \
+	$(SRC)/DialKeys.cpp \
+	$(SRC)/DialModes.cpp \
+	$(SRC)/InputPipeline.cpp \
+	$(SRC)/KeyBehaviors.cpp \
+	$(SRC)/TimerWheel.cpp \
+	$(SRC)/keymap.cpp
+
+BLUEDROID_SOURCES = \
+	$(SRC)/BluedroidHidTransport.cpp \
+	$(SRC)/BleAdvertisingBackend.cpp
+
+LOOPBACK_SOURCES = \
+	$(SRC)/LoopbackHidTransport.cpp
+
+FIRMWARE_HEADERS = $(wildcard $(SHIM)/*.h $(SHIM)/*/*.h $(SRC)/*.h)
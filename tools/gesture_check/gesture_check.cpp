@@ -0,0 +1,125 @@
+// Host check of DialGestureEngine with explicit timestamps. Each script presses, releases and
+// turns the dial at fixed milliseconds; between events update() runs at every deadline() the
+// engine asks for, the way InputPipeline arms its timer. The gestures that come out, with the
+// time each fired, must match the script's expectation exactly. Covers tap with and without a
+// double tap action, double tap, a second press too late or held too long, long press,
+// press-and-rotate and rotation with nothing pressed. Prints one JSON line per script.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "DialGestures.h"
+#include "check.h"
+
+static const char* const gestureNames[] = {"tap", "double", "long", "rotate"};
+
+// Every gesture as name@ms, rotations with their delta, ends as /name@ms
+class Recorder : public DialGestureCallbacks {
+public:
+  void onGesture(DialGesture gesture, const DialAction& action, int delta){
+    char entry[32];
+    if (gesture == DIAL_GESTURE_PRESS_ROTATE){
+      snprintf(entry, sizeof(entry), "%s%+d@%u ", gestureNames[gesture], delta, this->now);
+    } else {
+      snprintf(entry, sizeof(entry), "%s@%u ", gestureNames[gesture], this->now);
+    }
+    this->log += entry;
+  }
+  void onGestureEnd(DialGesture gesture, const DialAction& action){
+    char entry[32];
+    snprintf(entry, sizeof(entry), "/%s@%u ", gestureNames[gesture], this->now);
+    this->log += entry;
+  }
+  std::string log;
+  uint32_t now = 0;
+};
+
+// 'p' press, 'r' release, 't' turn by delta; the script ends with '.' at the last update
+struct Event {
+  char what;
+  uint32_t at;
+  int delta;
+};
+
+struct Script {
+  const char* name;
+  bool doubleTap;   // Configure a double tap action
+  bool pressRotate; // Configure a press-and-rotate action
+  Event events[8];
+  const char* expect;
+  bool taken;       // What every rotate() in the script must return
+};
+
+static const Script scripts[] = {
+  // No double tap action: the tap goes out on the release itself
+  {"tap", false, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'.', 3000, 0}}, "tap@1080 ", true},
+  // With one it waits the double tap window, then goes out on the first update past it
+  {"tap_waits_for_double", true, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'.', 3000, 0}},
+   "tap@1331 ", true},
+  {"double_tap", true, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'p', 1200, 0}, {'r', 1260, 0}, {'.', 3000, 0}},
+   "double@1260 ", true},
+  // One millisecond past the window: two taps
+  {"second_press_late", true, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'p', 1331, 0}, {'r', 1400, 0}, {'.', 3000, 0}},
+   "tap@1331 tap@1651 ", true},
+  // Second press at the edge of the window, then held: a tap, then a long press
+  {"second_press_held", true, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'p', 1330, 0}, {'r', 2000, 0}, {'.', 3000, 0}},
+   "tap@1730 long@1730 /long@2000 ", true},
+  {"long_press", false, true, {{'p', 1000, 0}, {'r', 1900, 0}, {'.', 3000, 0}},
+   "long@1400 /long@1900 ", true},
+  {"press_rotate", false, true, {{'p', 1000, 0}, {'t', 1050, 3}, {'t', 1600, -2}, {'r', 1700, 0}, {'.', 3000, 0}},
+   "rotate+3@1050 rotate-2@1600 /rotate@1700 ", true},
+  {"long_press_then_rotate", false, true, {{'p', 1000, 0}, {'t', 1500, 1}, {'r', 1600, 0}, {'.', 3000, 0}},
+   "long@1400 rotate+1@1500 /rotate@1600 /long@1600 ", true},
+  // Turning on the second press ends the double tap: the first press was a tap
+  {"rotate_on_second_press", true, true, {{'p', 1000, 0}, {'r', 1080, 0}, {'p', 1200, 0}, {'t', 1250, 2}, {'r', 1300, 0}, {'.', 3000, 0}},
+   "tap@1250 rotate+2@1250 /rotate@1300 ", true},
+  // Without a press-and-rotate action turning is left to the caller and the press stays a tap
+  {"rotate_not_taken", false, false, {{'p', 1000, 0}, {'t', 1050, 3}, {'r', 1100, 0}, {'.', 3000, 0}},
+   "tap@1100 ", false},
+  {"rotate_unpressed", false, true, {{'t', 1000, 4}, {'.', 3000, 0}}, "", false},
+};
+
+// update() at each deadline up to and including until, as the pipeline's timer would
+static void advance(DialGestureEngine* engine, Recorder* recorder, uint32_t* now, uint32_t until){
+  uint32_t at;
+  while (engine->deadline(&at) && at <= until){
+    *now = at > *now ? at : *now;
+    recorder->now = *now;
+    engine->update(*now);
+  }
+  *now = until;
+  recorder->now = until;
+}
+
+static void run(const Script& script){
+  Recorder recorder;
+  DialGestureEngine engine(&recorder);
+  if (script.doubleTap) engine.config.doubleTap = {DIAL_ACTION_KEYS, 'z', 1, 0, 0};
+  if (!script.pressRotate) engine.config.pressRotate = {DIAL_ACTION_NONE, 0, 0, 0, 0};
+  uint32_t now = 0;
+  bool taken = true;
+  for (const Event& event : script.events){
+    advance(&engine, &recorder, &now, event.at);
+    if (event.what == 'p'){
+      engine.press(now);
+    } else if (event.what == 'r'){
+      engine.release(now);
+    } else if (event.what == 't'){
+      taken = taken && engine.rotate(event.delta, now) == script.taken;
+    } else {
+      break;
+    }
+  }
+  uint32_t at;
+  bool settled = !engine.deadline(&at) && !engine.pressed();
+  bool ok = recorder.log == script.expect && taken && settled;
+  checkLine(ok, "\"script\":\"%s\",\"gestures\":\"%s\",\"expected\":\"%s\",\"rotation_taken\":%s,\"settled\":%s",
+            script.name, recorder.log.c_str(), script.expect, jsonBool(taken), jsonBool(settled));
+}
+
+int main(int argc, char** argv){
+  for (const Script& script : scripts){
+    run(script);
+  }
+  return checkStatus();
+}
@@ -0,0 +1,133 @@
+// Host check that the BLE layer stops touching the heap once begin() is done. Brings the
+// keyboard up, then simulates a day of use through InputPipeline: key presses, dial spins, the
+// host writing the LED output report and both feature reports, and an hourly disconnect and
+// reconnect. Every operator new is counted and malloc's in-use bytes sampled, once at boot and
+// once after the simulated day; steady use must not allocate at all. Allocations at boot include
+// the characteristics the BLE stack stand-ins create, as the real stack does. On the device the
+// sketch prints free heap and the largest free block at boot and every hour.
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+#include "BluedroidHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "matrix.h"
+#include "keymap.h"
+#include "counting_new.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define SIM_HOURS 24
+#define STEP_MS 10
+#define KEY_EVERY_MS 2000
+#define KEY_HOLD_MS 120
+#define DIAL_EVERY_MS 5000
+#define DIAL_STEPS 12
+#define LED_EVERY_MS 60000
+#define FEATURE_EVERY_MS 600000
+#define RECONNECT_EVERY_MS 3600000
+
+static uint64_t reports = 0;
+
+static bool countNotify(BLECharacteristic* characteristic){
+  reports++;
+  return true;
+}
+
+static BLECharacteristic* find(char kind, uint8_t id){
+  for (BLECharacteristic* characteristic : replay_characteristics()){
+    if (characteristic->kind == kind && characteristic->reportId == id) return characteristic;
+  }
+  return NULL;
+}
+
+// The stack stores what the host wrote, then calls the characteristic's callbacks
+static void hostWrite(BLECharacteristic* characteristic, const void* data, size_t len){
+  characteristic->value.assign((const char*)data, len);
+  characteristic->callbacks->onWrite(characteristic);
+}
+
+static void connect(BluedroidHidTransport* transport){
+  esp_ble_gatts_cb_param_t param = {};
+  param.connect.conn_params.interval = 12;
+  transport->server()->callbacks->onConnect(transport->server());
+  transport->server()->callbacks->onConnect(transport->server(), &param);
+}
+
+static void printPhase(const char* phase, uint64_t hours, uint64_t allocated, size_t inUse){
+  printf("{\"phase\":\"%s\",\"hours\":%llu,\"allocations\":%llu,\"heap_in_use\":%zu,\"reports\":%llu}\n",
+         phase, (unsigned long long)hours, (unsigned long long)allocated, inUse, (unsigned long long)reports);
+}
+
+int main(int argc, char** argv){
+  // stdio would otherwise allocate its buffer on the first printf, in the middle of the day
+  static char output[BUFSIZ];
+  setvbuf(stdout, output, _IOLBF, sizeof(output));
+  BluedroidHidTransport* transport = new BluedroidHidTransport();
+  BleKeyboard* keyboard = new BleKeyboard(transport, "Bench", "Bench", 100);
+  keyboard->begin();
+  TimerWheel* timers = new TimerWheel();
+  InputPipeline* pipeline = new InputPipeline(keyboard, timers);
+  connect(transport);
+  replay_notify = countNotify;
+  BLECharacteristic* led = find('O', KEYBOARD_ID);
+  BLECharacteristic* radialFeature = find('F', RADIAL_ID);
+  BLECharacteristic* wheelFeature = find('F', WHEEL_ID);
+  if (led == NULL || radialFeature == NULL || wheelFeature == NULL){
+    checkLine(false, "\"error\":\"report characteristics not found\"");
+    return checkStatus();
+  }
+  size_t bootInUse = mallinfo2().uordblks;
+  uint64_t bootAllocations = replay_allocations;
+  printPhase("boot", 0, bootAllocations, bootInUse);
+
+  int key = 0;
+  for (uint64_t ms = 0; ms < (uint64_t)SIM_HOURS * 3600000; ms += STEP_MS){
+    replay_clock_us = ms * 1000;
+    uint32_t now = (uint32_t)ms;
+    if (ms % KEY_EVERY_MS == 0){
+      pipeline->key(key, KEY_PRESS_EVENT, now);
+    } else if (ms % KEY_EVERY_MS == KEY_HOLD_MS){
+      pipeline->key(key, KEY_UNPRESS_EVENT, now);
+      key = (key + 1) % (KEYMAP_SIZE - 1); // The last key is the dial button
+    }
+    if (ms % DIAL_EVERY_MS == 0){
+      for (int i = 0; i < DIAL_STEPS; i++){
+        pipeline->dial(ms % (2 * DIAL_EVERY_MS) == 0 ? 1 : -1, now);
+      }
+    }
+    if (ms % LED_EVERY_MS == 0){
+      uint8_t leds = (ms / LED_EVERY_MS) & 0x07;
+      hostWrite(led, &leds, 1);
+    }
+    if (ms % FEATURE_EVERY_MS == 0){
+      RadialFeatureReport feature = {};
+      feature.vibration_amount = (ms / FEATURE_EVERY_MS) % 2 ? 25 : 100;
+      feature.enabled = 1;
+      hostWrite(radialFeature, &feature, sizeof(feature));
+      WheelFeatureReport wheel = {};
+      wheel.wheel_multiplier = (ms / FEATURE_EVERY_MS) % 2;
+      hostWrite(wheelFeature, &wheel, sizeof(wheel));
+    }
+    if (ms % RECONNECT_EVERY_MS == RECONNECT_EVERY_MS / 2){
+      transport->server()->callbacks->onDisconnect(transport->server());
+    } else if (ms % RECONNECT_EVERY_MS == RECONNECT_EVERY_MS / 2 + 1000){
+      connect(transport);
+    }
+    timers->advance(ms);
+    keyboard->update();
+  }
+
+  size_t dayInUse = mallinfo2().uordblks;
+  uint64_t dayAllocations = replay_allocations - bootAllocations;
+  printPhase("day", SIM_HOURS, dayAllocations, dayInUse);
+  bool ok = dayAllocations == 0 && dayInUse == bootInUse;
+  checkLine(ok, "\"steady_allocations\":%llu,\"heap_growth\":%lld", (unsigned long long)dayAllocations,
+            (long long)dayInUse - (long long)bootInUse);
+  return checkStatus();
+}
@@ -0,0 +1,141 @@
+// Host half of the input path benchmark: the same paths src/bench times on target with the cycle
+// counter (KeyboardMatrix::scan, BleKeyboard press/release/rotate, keymap dispatch, feature
+// report parsing and the trace recorder), built against the replay shim and timed with the host
+// clock. Like the target bench, BLE is begun but no host connects, so the BleKeyboard numbers
+// are report building only. The scans read idle pins; the shim's register and pin reads stand in
+// for the hardware, so only the code around them is measured.
+//
+// Host numbers move with the machine and the compiler, so compare them against a run of the
+// previous commit on the same machine, not against the target's cycles. Prints one JSON line
+// per benchmark, in the target bench's format with ns instead of cycles.
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+
+#include "BluedroidHidTransport.h"
+#include "BleKeyboard.h"
+#include "matrix.h"
+#include "keymap.h"
+#include "InputTrace.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define BENCH_SAMPLES 1024
+#define BENCH_BATCH 64 //Calls timed together per sample, so the clock read is small next to them
+
+typedef void (*BenchFunction)(void);
+
+static double samples[BENCH_SAMPLES];
+static double overhead = 0;
+
+static PadMatrix matrix_handler;
+static KeyboardMatrix<4, 3, GpioMatrixBackend<PadRowPins, PadColPins>, MATRIX_DIODES> hal_matrix;
+static BleKeyboard* bleKeyboard;
+static int changes_buff[PadMatrix::keys];
+static int bench_key = 0;
+static uint8_t wheel_multiplier = 0;
+static uint8_t trace_storage[TRACE_BUFFER_SIZE];
+static InputTraceBuffer trace(trace_storage, TRACE_BUFFER_SIZE);
+static uint64_t trace_time = 0;
+
+static void emptyBench(){
+}
+
+static void benchMatrixScan(){
+  matrix_handler.scan(changes_buff);
+}
+
+static void benchMatrixScanHal(){
+  hal_matrix.scan(changes_buff);
+}
+
+static void benchPressRelease(){
+  bleKeyboard->press('a');
+  bleKeyboard->release('a');
+}
+
+static void benchPressReleaseModifier(){
+  bleKeyboard->press(KEY_LEFT_CTRL);
+  bleKeyboard->press('z');
+  bleKeyboard->release('z');
+  bleKeyboard->release(KEY_LEFT_CTRL);
+}
+
+static void benchRotate(){
+  bleKeyboard->rotate(1);
+}
+
+static void benchKeymapDispatch(){
+  keymapPress(bleKeyboard, bench_key);
+  keymapRelease(bleKeyboard, bench_key);
+  bench_key = (bench_key + 1) % (KEYMAP_SIZE - 1); // The last key is the dial button
+}
+
+static void benchFeatureReport(){
+  RadialFeatureReport report = {};
+  report.vibration_amount = 25;
+  report.enabled = 1;
+  bleKeyboard->applyFeatureReport(&report);
+}
+
+static void benchWheelFeatureReport(){
+  WheelFeatureReport report = {};
+  report.wheel_multiplier = wheel_multiplier ^= 1; // A change of resolution each time
+  bleKeyboard->applyWheelFeatureReport(&report);
+}
+
+// Worst case for the recorder: every sample changes both the bitmap and the counter
+static void benchTraceSample(){
+  trace_time += 1000;
+  trace.sample(trace_time, trace_time >> 10, trace_time >> 12);
+}
+
+// Sorted ns per call, the clock read subtracted
+static void measure(BenchFunction fn){
+  fn(); // Warm the cache
+  for (int i = 0; i < BENCH_SAMPLES; i++){
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < BENCH_BATCH; j++) fn();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / BENCH_BATCH - overhead;
+    samples[i] = ns > 0 ? ns : 0;
+  }
+  std::sort(samples, samples + BENCH_SAMPLES);
+}
+
+static void run(const char* name, BenchFunction fn){
+  measure(fn);
+  double total = 0;
+  for (int i = 0; i < BENCH_SAMPLES; i++){
+    total += samples[i];
+  }
+  printf("{\"bench\":\"%s\",\"iters\":%d,\"min\":%.1f,\"median\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"mean\":%.1f,\"unit\":\"ns\"}\n",
+         name, BENCH_SAMPLES, samples[0], samples[BENCH_SAMPLES / 2], samples[(BENCH_SAMPLES * 99) / 100],
+         samples[BENCH_SAMPLES - 1], total / BENCH_SAMPLES);
+}
+
+int main(int argc, char** argv){
+  // Every row reads high: nothing held, as on an idle pad
+  GPIO.in = GPIO.in1.data = UINT32_MAX;
+  hal_matrix.init();
+  matrix_handler.init();
+  bleKeyboard = new BleKeyboard(new BluedroidHidTransport(), "Bench", "Bench", 100);
+  bleKeyboard->begin();
+  measure(emptyBench);
+  overhead = samples[BENCH_SAMPLES / 2];
+
+  run("matrix_scan", benchMatrixScan);
+  run("matrix_scan_hal", benchMatrixScanHal);
+  run("keyboard_press_release", benchPressRelease);
+  run("keyboard_press_release_ctrl", benchPressReleaseModifier);
+  run("radial_rotate", benchRotate);
+  run("keymap_dispatch", benchKeymapDispatch);
+  run("feature_report_parse", benchFeatureReport);
+  run("wheel_feature_report_parse", benchWheelFeatureReport);
+  run("trace_sample", benchTraceSample);
+  return 0;
+}
@@ -0,0 +1,218 @@
+// Host check of the tap-hold and chord bindings. Each case feeds KeyBehaviorEngine timestamped
+// presses and releases and compares what comes out, call by call, with what should. The first
+// cases are the unbound keys: they have to come out in the very call that reports them, also
+// while a dual-role key or a chord is still undecided. Last, the cost of an event with a
+// few bindings against every binding slot in use, which should be about the same.
+#include <stdio.h>
+#include <string>
+#include <chrono>
+
+#include "KeyBehaviors.h"
+#include "check.h"
+
+#define CHORD_Z 0 //'s' + 'd'
+#define KEY_S 0
+#define KEY_X 1
+#define KEY_C 2
+#define KEY_D 3
+#define KEY_G 6 //Tap 'g', hold Ctrl
+#define KEY_K 9 //Tap 'k', hold layer 1
+
+// Logs what the engine sends, one token per callback: "+3" key 3 down, "-3" up, "+z" action down
+class Recorder : public KeyBehaviorCallbacks {
+public:
+  void onKey(int k, bool pressed){
+    this->log += pressed ? "+" : "-";
+    this->log += std::to_string(k) + " ";
+  }
+  void onAction(const KeyAction& action, bool pressed){
+    this->log += pressed ? "+" : "-";
+    this->log += action.type == KEY_ACTION_MODIFIERS ? std::string("ctrl") : std::string(1, (char)action.key);
+    this->log += " ";
+  }
+  // What came out since the last call
+  std::string take(){
+    std::string out = this->log;
+    this->log.clear();
+    return out;
+  }
+  std::string log;
+};
+
+static void bind(KeyBehaviorEngine& engine){
+  KeyBehaviorConfig& config = engine.config;
+  config.tapHold[KEY_G].hold = {KEY_ACTION_MODIFIERS, 0, 1, 0, 0, 0};
+  config.tapHold[KEY_K].tap = {KEY_ACTION_KEYS, 'k', 0, 0, 0, 0};
+  config.tapHold[KEY_K].hold = {KEY_ACTION_LAYER, 0, 0, 0, 0, 1};
+  config.layers[0][KEY_C] = {KEY_ACTION_KEYS, ']', 0, 0, 0, 0};
+  config.chords[CHORD_Z] = {KEY_BIT(KEY_S) | KEY_BIT(KEY_D), {KEY_ACTION_KEYS, 'z', 1, 0, 0, 0}};
+  config.chordCount = 1;
+  engine.configure();
+}
+
+static void expect(const char* name, Recorder& recorder, const char* want){
+  std::string got = recorder.take();
+  checkLine(got == want, "\"check\":\"%s\",\"want\":\"%s\",\"got\":\"%s\"", name, want, got.c_str());
+}
+
+// Unbound keys: out at once, alone, next to a waiting dual-role key, and into a gathering chord
+static void runUnbound(){
+  Recorder recorder;
+  KeyBehaviorEngine engine(&recorder);
+  bind(engine);
+  engine.press(KEY_X, 0);
+  expect("unbound_press", recorder, "+1 ");
+  engine.release(KEY_X, 1);
+  expect("unbound_release", recorder, "-1 ");
+
+  engine.press(KEY_G, 100);
+  expect("dual_role_waits", recorder, "");
+  engine.press(KEY_X, 101);
+  expect("unbound_during_tap_hold", recorder, "+ctrl +1 ");
+  engine.release(KEY_X, 102);
+  engine.release(KEY_G, 103);
+  expect("unbound_during_tap_hold_release", recorder, "-1 -ctrl ");
+
+  engine.press(KEY_S, 200);
+  expect("chord_key_waits", recorder, "");
+  engine.press(KEY_X, 201);
+  expect("unbound_during_chord", recorder, "+0 +1 ");
+  engine.release(KEY_S, 202);
+  engine.release(KEY_X, 203);
+  expect("unbound_during_chord_release", recorder, "-0 -1 ");
+
+  // A key of a 5x5 pad, and one past what a binding can name, which still goes out
+  engine.press(24, 300);
+  engine.release(24, 301);
+  expect("high_index_key", recorder, "+24 -24 ");
+  engine.press(KEY_G, 400);
+  engine.press(KEY_BEHAVIOR_KEYS, 401);
+  engine.release(KEY_BEHAVIOR_KEYS, 402);
+  engine.release(KEY_G, 403);
+  expect("key_past_the_masks", recorder, "+ctrl +32 -32 -ctrl ");
+  engine.update(1000);
+  expect("nothing_left_over", recorder, "");
+}
+
+static void runTapHold(){
+  Recorder recorder;
+  KeyBehaviorEngine engine(&recorder);
+  bind(engine);
+  engine.press(KEY_G, 0);
+  engine.update(KEY_BEHAVIOR_TAPPING_TERM - 1);
+  engine.release(KEY_G, KEY_BEHAVIOR_TAPPING_TERM - 1);
+  expect("tap_own_key", recorder, "+6 -6 ");
+  engine.press(KEY_K, 1000);
+  engine.release(KEY_K, 1050);
+  expect("tap_action", recorder, "+k -k ");
+
+  engine.press(KEY_G, 2000);
+  engine.update(2000 + KEY_BEHAVIOR_TAPPING_TERM - 1);
+  expect("hold_before_term", recorder, "");
+  engine.update(2000 + KEY_BEHAVIOR_TAPPING_TERM);
+  expect("hold_at_term", recorder, "+ctrl ");
+  engine.release(KEY_G, 3000);
+  expect("hold_release", recorder, "-ctrl ");
+
+  // Layer: the layer key's binding while it is held, the keymap again after, and a key pressed
+  // on the layer lets go of what it pressed even if the layer key went up first
+  engine.press(KEY_K, 4000);
+  engine.press(KEY_C, 4010);
+  expect("layer_key", recorder, "+] ");
+  engine.press(KEY_X, 4020);
+  expect("layer_unbound_falls_through", recorder, "+1 ");
+  engine.release(KEY_K, 4030);
+  engine.release(KEY_C, 4040);
+  engine.release(KEY_X, 4050);
+  expect("layer_release", recorder, "-] -1 ");
+  engine.press(KEY_C, 5000);
+  engine.release(KEY_C, 5010);
+  expect("layer_off", recorder, "+2 -2 ");
+}
+
+static void runChords(){
+  Recorder recorder;
+  KeyBehaviorEngine engine(&recorder);
+  bind(engine);
+  engine.press(KEY_S, 0);
+  engine.press(KEY_D, KEY_BEHAVIOR_CHORD_WINDOW - 1);
+  expect("chord_fires", recorder, "+z ");
+  engine.release(KEY_S, 100);
+  expect("chord_release", recorder, "-z ");
+  engine.release(KEY_D, 110);
+  expect("chord_release_swallowed", recorder, "");
+
+  engine.press(KEY_S, 1000);
+  engine.update(1000 + KEY_BEHAVIOR_CHORD_WINDOW - 1);
+  expect("chord_window_open", recorder, "");
+  engine.update(1000 + KEY_BEHAVIOR_CHORD_WINDOW);
+  expect("chord_window_closed", recorder, "+0 ");
+  engine.press(KEY_D, 1000 + KEY_BEHAVIOR_CHORD_WINDOW + 10);
+  expect("chord_late_key", recorder, "");
+  engine.release(KEY_D, 1100);
+  engine.release(KEY_S, 1110);
+  expect("chord_late_release", recorder, "+3 -3 -0 ");
+
+  engine.press(KEY_D, 2000);
+  engine.release(KEY_D, 2010);
+  expect("chord_key_tapped", recorder, "+3 -3 ");
+
+  // A waiting dual-role key counts a chord as a key going down
+  engine.press(KEY_G, 3000);
+  engine.press(KEY_S, 3010);
+  engine.press(KEY_D, 3020);
+  expect("chord_settles_hold", recorder, "+ctrl +z ");
+  engine.release(KEY_S, 3030);
+  engine.release(KEY_D, 3040);
+  engine.release(KEY_G, 3050);
+  expect("chord_settles_hold_release", recorder, "-z -ctrl ");
+}
+
+// Worst case for an event is a chord being gathered next to a waiting dual-role key
+static double nsPerEvent(KeyBehaviorEngine& engine, Recorder& recorder){
+  const int rounds = 200000;
+  auto start = std::chrono::steady_clock::now();
+  uint32_t t = 0;
+  for (int i = 0; i < rounds; i++){
+    engine.press(KEY_G, t);
+    engine.press(KEY_S, t + 1);
+    engine.press(KEY_X, t + 2);
+    engine.release(KEY_X, t + 3);
+    engine.release(KEY_S, t + 4);
+    engine.release(KEY_G, t + 5);
+    engine.update(t + 6);
+    t += 1000;
+    recorder.log.clear();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (rounds * 7.0);
+}
+
+static void runCost(){
+  Recorder recorder;
+  KeyBehaviorEngine few(&recorder);
+  bind(few);
+  KeyBehaviorEngine full(&recorder);
+  bind(full);
+  for (int k = 0; k < KEY_BEHAVIOR_KEYS; k++){
+    if (k != KEY_X && full.config.tapHold[k].hold.type == KEY_ACTION_NONE){
+      full.config.tapHold[k].hold = {KEY_ACTION_MODIFIERS, 0, 0, 1, 0, 0};
+    }
+  }
+  for (int i = 1; i < KEY_BEHAVIOR_MAX_CHORDS; i++){
+    full.config.chords[i] = {(KeyMask)(KEY_BIT(KEY_S) | KEY_BIT(10 + i % 6) | KEY_BIT(4 + i % 2)), {KEY_ACTION_KEYS, 'q', 0, 0, 0, 0}};
+  }
+  full.config.chordCount = KEY_BEHAVIOR_MAX_CHORDS;
+  full.configure();
+  double a = nsPerEvent(few, recorder);
+  double b = nsPerEvent(full, recorder);
+  printf("{\"check\":\"cost\",\"one_chord_ns\":%.1f,\"all_chords_ns\":%.1f}\n", a, b);
+}
+
+int main(int argc, char** argv){
+  runUnbound();
+  runTapHold();
+  runChords();
+  runCost();
+  return checkStatus();
+}
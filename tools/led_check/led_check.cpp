@@ -0,0 +1,232 @@
+// Host check and power model of the status LED. Each state's pattern plays for a simulated hour
+// with StatusLed::update() called on the HID task's idle period, against a fake LEDC that
+// ramps the duty the way the hardware fade does. One JSON line per state gives the pattern
+// period, how often the CPU touches the LED (segments per second; nothing runs in between),
+// how many of those start a hardware fade, and the average duty with the LED current it costs.
+// Then every state change is made mid-pattern against a channel that is busy while it fades, to
+// check no fade is started that LEDC would make the HID task wait for, and the blink code and the
+// pairing button's path through ReconnectManager are checked.
+//
+// The LED runs from the HID task on core 0, next to the BLE stack; the input task that scans the
+// matrix on core 1 never sees it, so the scan stats on serial are the check on target.
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "StatusLed.h"
+#include "ReconnectManager.h"
+#include "check.h"
+
+#define STEP_MS 5 //HID_TASK_IDLE_MS
+#define RUN_MS 3600000
+#define LED_FULL_MA 10.0 //LED current at full duty
+
+// Duty follows each fade as a straight line, like the LEDC stepping it. The channel is busy until
+// a fade ends; a new duty before then is a call LEDC would block the HID task on.
+class FakeLed : public LedBackend {
+public:
+  void fade(uint16_t duty, uint32_t ms){
+    this->segments++;
+    if (duty == this->to){
+      return; // LedcLedBackend skips holds too
+    }
+    if (this->now < this->startedAt + this->ms) this->waits++;
+    this->from = this->at(this->now);
+    this->to = duty;
+    this->startedAt = this->now;
+    this->ms = ms;
+    this->fades++;
+    if (duty > this->from){
+      this->rises++;
+      if (duty == STATUS_LED_BRIGHT) this->brightRises++;
+      if (duty == STATUS_LED_DIM) this->dimRises++;
+    }
+  }
+  double at(uint64_t t) const {
+    if (this->ms == 0 || t >= this->startedAt + this->ms) return this->to;
+    return this->from + (double)((int)this->to - (int)this->from) * (t - this->startedAt) / this->ms;
+  }
+  uint64_t now = 0;
+  uint32_t segments = 0;
+  uint32_t fades = 0;
+  uint32_t rises = 0;
+  uint32_t brightRises = 0;
+  uint32_t dimRises = 0;
+  uint32_t waits = 0;
+private:
+  double from = 0;
+  uint16_t to = 0;
+  uint64_t startedAt = 0;
+  uint32_t ms = 0;
+};
+
+class FakeAdvertising : public AdvertisingBackend {
+public:
+  bool startDirected(){ this->directed++; return true; }
+  void startUndirected(uint16_t minInterval, uint16_t maxInterval){ this->undirected++; this->lastMin = minInterval; }
+  void stop(){}
+  int directed = 0;
+  int undirected = 0;
+  uint16_t lastMin = 0;
+};
+
+struct Expect {
+  StatusLedState state;
+  const char* name;
+  uint32_t periodMs; // 0 for patterns that play once
+  uint32_t blinks;   // Rises per period
+};
+
+// Period over whole periods from the first rise; the update step adds up to STEP_MS per segment
+static double periodOf(const std::vector<uint64_t>& rises, const Expect& e){
+  size_t periods = rises.empty() ? 0 : (rises.size() - 1) / e.blinks;
+  return periods > 0 ? (double)(rises[periods * e.blinks] - rises.front()) / periods : 0;
+}
+
+static bool played(const std::vector<uint64_t>& rises, const Expect& e){
+  double period = periodOf(rises, e);
+  return e.periodMs == 0 ? rises.size() <= 1 : period >= e.periodMs && period <= e.periodMs * 1.1;
+}
+
+static void runState(const Expect& e){
+  FakeLed led;
+  StatusLed status(&led);
+  std::vector<uint64_t> rises;
+  double dutySum = 0;
+  uint64_t samples = 0;
+  status.show(e.state, 0);
+  for (uint64_t t = 0; t < RUN_MS; t += STEP_MS){
+    led.now = t;
+    uint32_t before = led.rises;
+    status.update((uint32_t)t);
+    if (led.rises != before) rises.push_back(t);
+    for (uint64_t ms = t; ms < t + STEP_MS; ms++){
+      dutySum += led.at(ms);
+      samples++;
+    }
+  }
+  double period = periodOf(rises, e);
+  double duty = dutySum / samples / STATUS_LED_MAX_DUTY;
+  bool ok = led.waits == 0 && played(rises, e);
+  checkLine(ok, "\"state\":\"%s\",\"period_ms\":%.1f,\"expected_ms\":%u,\"segments_per_s\":%.2f,\"fades_per_s\":%.2f,"
+            "\"avg_duty_pct\":%.2f,\"avg_ma\":%.3f",
+            e.name, period, e.periodMs, led.segments * 1000.0 / RUN_MS, led.fades * 1000.0 / RUN_MS,
+            duty * 100, duty * LED_FULL_MA);
+}
+
+// Every state change, landing at several points of the old pattern, mid-fade included. No fade is
+// started on a busy channel, the change waits at most for the running segment to end, and then the
+// new state's pattern plays.
+static void runChanges(const Expect* states, size_t count){
+  static const uint32_t offsets[] = {0, 37, 233, 777, 1499, 4321};
+  uint32_t changes = 0, waits = 0, maxDelayMs = 0;
+  bool follows = true;
+  for (size_t i = 0; i < count; i++){
+    for (size_t j = 0; j < count; j++){
+      if (i == j) continue;
+      for (uint32_t offset : offsets){
+        FakeLed led;
+        StatusLed status(&led);
+        status.show(states[i].state, 0);
+        uint64_t t = 0;
+        for (; t < offset; t += 1){
+          led.now = t;
+          status.update((uint32_t)t);
+        }
+        uint32_t deadline;
+        bool running = status.deadline(&deadline);
+        uint32_t before = status.segments();
+        status.show(states[j].state, (uint32_t)t);
+        changes++;
+        // The first segment of the new pattern: now, or when the running one ends
+        for (; status.segments() == before && t < offset + 60000; t++){
+          led.now = t;
+          status.update((uint32_t)t);
+        }
+        uint32_t delay = (uint32_t)(t - offset);
+        if (delay > maxDelayMs) maxDelayMs = delay;
+        follows = follows && (!running || t <= deadline + 1) && status.state() == states[j].state;
+        std::vector<uint64_t> rises;
+        for (uint64_t end = t + 60000; t < end; t += STEP_MS){
+          led.now = t;
+          uint32_t rose = led.rises;
+          status.update((uint32_t)t);
+          if (led.rises != rose && t > offset + 2000) rises.push_back(t);
+        }
+        follows = follows && played(rises, states[j]);
+        waits += led.waits;
+      }
+    }
+  }
+  bool ok = waits == 0 && follows;
+  checkLine(ok, "\"check\":\"state_changes\",\"changes\":%u,\"busy_waits\":%u,\"max_delay_ms\":%u,\"follows\":%s",
+            changes, waits, maxDelayMs, jsonBool(follows));
+}
+
+// Three blinks twice over, then back to the state's own pattern. Advertising breathes at
+// STATUS_LED_DIM, so every bright rise is a code blink.
+static void runBlinkCode(){
+  FakeLed led;
+  StatusLed status(&led);
+  status.show(STATUS_LED_ADVERTISING, 0);
+  status.blinkCode(3, 2, 0);
+  for (uint64_t t = 0; t < 20000; t += STEP_MS){
+    led.now = t;
+    status.update((uint32_t)t);
+  }
+  bool back = status.state() == STATUS_LED_ADVERTISING && led.dimRises > 0;
+  bool ok = led.brightRises == 6 && back && led.waits == 0;
+  checkLine(ok, "\"check\":\"blink_code\",\"count\":3,\"repeats\":2,\"blinks\":%u,\"back_to_state\":%s",
+            led.brightRises, jsonBool(back));
+}
+
+// Pairing while connected: no directed advertising at the old host, fast advertising for
+// RECONNECT_PAIRING_MS, then slow; a connection ends it and the next drop reconnects as usual.
+// The link callbacks only post; the HID task's next update() applies them.
+static void runPairing(){
+  FakeAdvertising advertising;
+  ReconnectManager manager(&advertising);
+  manager.start(0);
+  manager.onConnected(100);
+  manager.update(100);
+  manager.pair(1000);
+  bool waited = manager.phase() == RECONNECT_IDLE; // Until the link is down
+  manager.onDisconnected(1050);
+  manager.update(1050);
+  bool pairing = manager.phase() == RECONNECT_PAIRING && advertising.directed == 1 &&
+                 advertising.lastMin == RECONNECT_FAST_INTERVAL_MIN;
+  manager.update(1050 + RECONNECT_PAIRING_MS - 1);
+  bool stillPairing = manager.phase() == RECONNECT_PAIRING;
+  manager.update(1050 + RECONNECT_PAIRING_MS);
+  bool slow = manager.phase() == RECONNECT_SLOW;
+  manager.onConnected(100000);
+  manager.update(100000);
+  manager.onDisconnected(200000);
+  manager.update(200000);
+  bool normal = manager.phase() == RECONNECT_DIRECTED && advertising.directed == 2;
+  // Pairing while advertising starts at once
+  manager.pair(201000);
+  bool immediate = manager.phase() == RECONNECT_PAIRING;
+  bool ok = waited && pairing && stillPairing && slow && normal && immediate;
+  checkLine(ok, "\"check\":\"pairing\",\"waits_for_disconnect\":%s,\"skips_directed\":%s,\"times_out\":%s,"
+            "\"reconnects_after\":%s,\"starts_while_advertising\":%s",
+            jsonBool(waited), jsonBool(pairing), jsonBool(stillPairing && slow), jsonBool(normal), jsonBool(immediate));
+}
+
+int main(int argc, char** argv){
+  static const Expect states[] = {
+    {STATUS_LED_OFF, "off", 0, 1},
+    {STATUS_LED_PAIRING, "pairing", 800, 1},
+    {STATUS_LED_LOW_BATTERY, "low_battery", 10000, 2},
+    {STATUS_LED_RECONNECTING, "reconnecting", 500, 1},
+    {STATUS_LED_ADVERTISING, "advertising", 6000, 1},
+    {STATUS_LED_CONNECTED, "connected", 0, 1},
+  };
+  for (const Expect& e : states){
+    runState(e);
+  }
+  runChanges(states, sizeof(states) / sizeof(states[0]));
+  runBlinkCode();
+  runPairing();
+  return checkStatus();
+}
@@ -0,0 +1,329 @@
+// Host benchmark of the KeyboardMatrix scan backends. Each backend scans a simulated board
+// (direct GPIO, 74HC165 rows, MCP23017 over I2C) with random keys held; the sample must match
+// the held keys, and the pin and I2C calls it made are priced with the costs below to give a
+// modelled full-scan time. The costs are estimates for an ESP32 on the Arduino core, good for
+// comparing backends and layouts; the on-target bench measures the real thing.
+//
+// The register backend runs against the same board through a model of the GPIO registers, priced
+// per register access plus its settle time; the row extraction is also checked on its own
+// against every row state with the other input bits random.
+//
+// The ghost check scans every combination of the 12 keys on a simulated board without diodes,
+// then steps from every combination to every other one, and fails if a key that is not held
+// ever fires or if a combination without ambiguity is not reported exactly.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "matrix.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define COST_PIN_WRITE_NS 250 //digitalWrite through the HAL
+#define COST_PIN_READ_NS 200 //digitalRead through the HAL
+#define COST_REG_WRITE_NS 50 //Store to a GPIO set/clear register
+#define COST_REG_READ_NS 100 //Load from a GPIO input register over the peripheral bus
+#define COST_I2C_BIT_NS 2500 //400 kHz bus
+#define COST_I2C_OVERHEAD_NS 20000 //Driver setup and completion wait per transaction
+#define SAMPLES 1000
+
+#define LOAD_PIN 21
+#define CLOCK_PIN 22
+#define DATA_PIN 19
+#define EXPANDER_ADDRESS 0x20
+
+// The board behind the pins: which keys are held, and whatever chip reads them
+class MatrixModel : public ReplayIo {
+public:
+  MatrixModel(const int* rowPins, int rows, const int* colPins, int cols, bool diodes = true)
+    : rowPins(rowPins), rows(rows), colPins(colPins), cols(cols), diodes(diodes) {}
+
+  void pinWrite(int pin, int value){
+    this->pinWrites++;
+    int col = this->indexOf(this->colPins, this->cols, pin);
+    if (col >= 0){
+      this->colLow = value ? this->colLow & ~(1u << col) : this->colLow | 1u << col;
+    } else if (pin == LOAD_PIN && !value){
+      this->shifter = this->sense();
+    } else if (pin == CLOCK_PIN && value){
+      this->shifter >>= 1;
+    }
+  }
+
+  int pinRead(int pin){
+    this->pinReads++;
+    if (pin == DATA_PIN){
+      return !(this->shifter & 1);
+    }
+    int row = this->indexOf(this->rowPins, this->rows, pin);
+    return row >= 0 ? !(this->sense() & 1u << row) : HIGH;
+  }
+
+  void i2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop){
+    this->i2c(len);
+    if (len >= 2 && (data[0] == MCP23017_GPIOA || data[0] == MCP23017_OLATA)){
+      this->colLow = ~data[1] & ((1u << this->cols) - 1);
+    }
+    // The register pointer moves on past every byte written
+    if (len >= 1) this->reg = data[0] + len - 1;
+  }
+
+  // GPIO registers: columns driven by mask, all inputs read at once. Pins that aren't rows
+  // read as noise, which the backend must ignore.
+  void registerWrite(uint32_t mask, bool low){
+    this->regWrites++;
+    for (int i = 0; i < this->cols; i++){
+      if (!(mask & 1u << this->colPins[i])) continue;
+      this->colLow = low ? this->colLow | 1u << i : this->colLow & ~(1u << i);
+    }
+  }
+
+  uint64_t registerRead(int banks){
+    this->regReads += banks;
+    uint64_t in = (uint64_t)rand() << 32 ^ (uint64_t)rand() << 16 ^ rand();
+    uint32_t bits = this->sense();
+    for (int j = 0; j < this->rows; j++){
+      uint64_t pin = (uint64_t)1 << this->rowPins[j];
+      in = bits & 1u << j ? in & ~pin : in | pin;
+    }
+    return in;
+  }
+
+  size_t i2cRead(uint8_t address, uint8_t* data, size_t len){
+    this->i2c(len);
+    if (len >= 1) data[0] = this->reg == MCP23017_GPIOB ? ~this->sense() : 0xFF;
+    return len;
+  }
+
+  // Rows pulled low through a held key in a low column. Without diodes a pulled row pulls
+  // every column it has a held key in, and so on.
+  uint32_t sense(){
+    uint32_t low = this->colLow;
+    uint32_t bits = 0;
+    for (bool grew = true; grew; ){
+      grew = false;
+      for (int j = 0; j < this->rows; j++){
+        for (int i = 0; i < this->cols; i++){
+          if (!(this->held & (MatrixBits)1 << (j * this->cols + i))) continue;
+          if ((low & 1u << i) && !(bits & 1u << j)){
+            bits |= 1u << j;
+            grew = !this->diodes;
+          }
+          if (!this->diodes && (bits & 1u << j) && !(low & 1u << i)){
+            low |= 1u << i;
+            grew = true;
+          }
+        }
+      }
+    }
+    return bits;
+  }
+
+  uint64_t costNs(){
+    return this->pinWrites * COST_PIN_WRITE_NS + this->pinReads * COST_PIN_READ_NS +
+           this->regWrites * COST_REG_WRITE_NS + this->regReads * COST_REG_READ_NS +
+           this->settles * MATRIX_SETTLE_NS + this->i2cBits * COST_I2C_BIT_NS + this->i2cTransactions * COST_I2C_OVERHEAD_NS;
+  }
+
+  MatrixBits held = 0;
+  uint64_t pinWrites = 0, pinReads = 0, regWrites = 0, regReads = 0, settles = 0, i2cTransactions = 0, i2cBits = 0;
+private:
+  int indexOf(const int* pins, int count, int pin){
+    for (int k = 0; pins != NULL && k < count; k++){
+      if (pins[k] == pin) return k;
+    }
+    return -1;
+  }
+  // Start, address byte, data bytes with their ACKs, stop
+  void i2c(size_t len){
+    this->i2cTransactions++;
+    this->i2cBits += 2 + (1 + len) * 9;
+  }
+  const int* rowPins;
+  int rows;
+  const int* colPins;
+  int cols;
+  bool diodes;
+  uint32_t colLow = 0;
+  uint32_t shifter = 0;
+  uint8_t reg = 0;
+};
+
+static MatrixModel* registerModel = NULL;
+
+// Io for RegisterGpioBackend that goes to registerModel, reading the banks the rows need
+template<uint64_t Mask>
+class ModelGpioRegisters {
+public:
+  void init(){}
+  void setLow(uint32_t mask){ registerModel->registerWrite(mask, true); }
+  void setHigh(uint32_t mask){ registerModel->registerWrite(mask, false); }
+  uint64_t read(){ return registerModel->registerRead(((Mask & 0xFFFFFFFFull) != 0) + ((Mask >> 32) != 0)); }
+  void settle(){ registerModel->settles++; }
+};
+
+template<typename Matrix>
+static void bench(const char* backend, MatrixModel* model){
+  Matrix matrix;
+  replay_io() = model;
+  registerModel = model;
+  matrix.init();
+  model->pinWrites = model->pinReads = model->i2cTransactions = model->i2cBits = 0;
+  model->regWrites = model->regReads = model->settles = 0;
+  bool ok = true;
+  srand(1);
+  for (int n = 0; n < SAMPLES; n++){
+    // Mostly single keys, with some chords; a diode matrix reads any combination
+    model->held = 0;
+    for (int keys = rand() % 4; keys > 0; keys--){
+      model->held |= (MatrixBits)1 << (rand() % Matrix::keys);
+    }
+    ok = matrix.sample() == model->held && ok;
+  }
+  replay_io() = NULL;
+  registerModel = NULL;
+  checkLine(ok, "\"backend\":\"%s\",\"rows\":%d,\"cols\":%d,\"pin_writes\":%.1f,\"pin_reads\":%.1f,"
+            "\"reg_writes\":%.1f,\"reg_reads\":%.1f,\"i2c_transactions\":%.1f,\"scan_us\":%.2f",
+            backend, Matrix::rows, Matrix::cols,
+            (double)model->pinWrites / SAMPLES, (double)model->pinReads / SAMPLES,
+            (double)model->regWrites / SAMPLES, (double)model->regReads / SAMPLES,
+            (double)model->i2cTransactions / SAMPLES, model->costNs() / 1000.0 / SAMPLES);
+}
+
+typedef MatrixPins<32, 33, 25, 26> Rows4;
+typedef MatrixPins<23, 14, 12> Cols3;
+typedef RegisterGpioBackend<Rows4, Cols3, ModelGpioRegisters<MatrixPinMask<Rows4>::value>> Register4x3;
+
+// Every row state, each under many random values of the other input bits
+static void registerCheck(){
+  long wrong = 0, checked = 0;
+  srand(2);
+  for (uint32_t rows = 0; rows < 16; rows++){
+    for (int n = 0; n < 4096; n++){
+      uint64_t in = (uint64_t)rand() << 32 ^ (uint64_t)rand() << 16 ^ rand();
+      for (int j = 0; j < 4; j++){
+        uint64_t pin = (uint64_t)1 << Rows4::pins[j];
+        in = rows & 1u << j ? in & ~pin : in | pin;
+      }
+      wrong += Register4x3::rowBits(in) != rows;
+      checked++;
+    }
+  }
+  checkLine(wrong == 0, "\"row_extraction_checked\":%ld,\"wrong\":%ld", checked, wrong);
+}
+typedef KeyboardMatrix<4, 3, GpioMatrixBackend<Rows4, Cols3>, false> GhostMatrix;
+
+#define GHOST_KEYS 12
+#define GHOST_STATES (1 << GHOST_KEYS)
+#define GHOST_SETTLE (MATRIX_DEBOUNCE_VALUE + 2) //Scans of one state, enough for the debounce to fire
+
+// Scans one state until it settles, applying its events to pressed; false on a phantom press
+static bool settle(GhostMatrix* matrix, MatrixBits observed, MatrixBits real, MatrixBits* pressed, bool* blocked){
+  bool ok = true;
+  for (int n = 0; n < GHOST_SETTLE; n++){
+    int buff[GHOST_KEYS] = {};
+    matrix->process(observed, buff);
+    *blocked = *blocked || matrix->blocked() != 0;
+    for (int k = 0; k < GHOST_KEYS; k++){
+      if (buff[k] == KEY_PRESS_EVENT){
+        ok = ok && (real & (MatrixBits)1 << k);
+        *pressed |= (MatrixBits)1 << k;
+      } else if (buff[k] == KEY_UNPRESS_EVENT){
+        *pressed &= ~((MatrixBits)1 << k);
+      }
+    }
+  }
+  return ok;
+}
+
+static void ghostCheck(){
+  static MatrixBits observed[GHOST_STATES];
+  MatrixModel board(Rows4::pins, 4, Cols3::pins, 3, false);
+  GhostMatrix scanner;
+  replay_io() = &board;
+  scanner.init();
+  int ghosting = 0;
+  for (int state = 0; state < GHOST_STATES; state++){
+    board.held = state;
+    observed[state] = scanner.sample();
+    ghosting += observed[state] != (MatrixBits)state;
+  }
+  replay_io() = NULL;
+
+  auto started = std::chrono::steady_clock::now();
+  volatile MatrixBits sink = 0;
+  for (int state = 0; state < GHOST_STATES; state++){
+    sink ^= matrixAmbiguous<4, 3>(observed[state]);
+  }
+  double filterNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / GHOST_STATES;
+
+  long phantoms = 0, wrong = 0, ambiguous = 0, steps = 0;
+  for (int from = 0; from < GHOST_STATES; from++){
+    GhostMatrix base;
+    MatrixBits basePressed = 0;
+    bool blocked = false;
+    phantoms += !settle(&base, observed[from], from, &basePressed, &blocked);
+    for (int to = 0; to < GHOST_STATES; to++){
+      GhostMatrix matrix = base;
+      MatrixBits pressed = basePressed;
+      blocked = false;
+      phantoms += !settle(&matrix, observed[to], to, &pressed, &blocked);
+      if (matrixAmbiguous<4, 3>(observed[to]) == 0){
+        wrong += pressed != (MatrixBits)to;
+      } else {
+        ambiguous++;
+      }
+      steps++;
+    }
+  }
+  bool ok = phantoms == 0 && wrong == 0;
+  checkLine(ok, "\"ghost_states\":%d,\"ghosting_states\":%d,\"transitions\":%ld,\"ambiguous_transitions\":%ld,"
+            "\"phantom_presses\":%ld,\"misreported\":%ld,\"filter_ns\":%.1f",
+            GHOST_STATES, ghosting, steps, ambiguous, phantoms, wrong, filterNs);
+}
+
+typedef MatrixPins<32, 33, 25, 26, 27> Rows5;
+typedef MatrixPins<23, 14, 12, 13, 15> Cols5;
+typedef RegisterGpioBackend<Rows5, Cols5, ModelGpioRegisters<MatrixPinMask<Rows5>::value>> Register5x5;
+
+int main(int argc, char** argv){
+  {
+    MatrixModel m(Rows4::pins, 4, Cols3::pins, 3);
+    bench<KeyboardMatrix<4, 3, GpioMatrixBackend<Rows4, Cols3>>>("gpio", &m);
+  }
+  {
+    MatrixModel m(Rows4::pins, 4, Cols3::pins, 3);
+    bench<KeyboardMatrix<4, 3, Register4x3>>("gpio_register", &m);
+  }
+  {
+    MatrixModel m(Rows5::pins, 5, Cols5::pins, 5);
+    bench<KeyboardMatrix<5, 5, GpioMatrixBackend<Rows5, Cols5>>>("gpio", &m);
+  }
+  {
+    MatrixModel m(Rows5::pins, 5, Cols5::pins, 5);
+    bench<KeyboardMatrix<5, 5, Register5x5>>("gpio_register", &m);
+  }
+  {
+    MatrixModel m(NULL, 4, Cols3::pins, 3);
+    bench<KeyboardMatrix<4, 3, ShiftRegisterBackend<4, LOAD_PIN, CLOCK_PIN, DATA_PIN, Cols3>>>("74hc165", &m);
+  }
+  {
+    MatrixModel m(NULL, 5, Cols5::pins, 5);
+    bench<KeyboardMatrix<5, 5, ShiftRegisterBackend<5, LOAD_PIN, CLOCK_PIN, DATA_PIN, Cols5>>>("74hc165", &m);
+  }
+  {
+    MatrixModel m(NULL, 4, NULL, 3);
+    bench<KeyboardMatrix<4, 3, I2cExpanderBackend<EXPANDER_ADDRESS, 4, 3>>>("mcp23017", &m);
+  }
+  {
+    MatrixModel m(NULL, 5, NULL, 5);
+    bench<KeyboardMatrix<5, 5, I2cExpanderBackend<EXPANDER_ADDRESS, 5, 5>>>("mcp23017", &m);
+  }
+  registerCheck();
+  ghostCheck();
+  return checkStatus();
+}
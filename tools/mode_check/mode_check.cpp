@@ -0,0 +1,262 @@
+// Host check of the key-held dial modes. Turns the dial through InputPipeline while mode keys
+// go down and up at random, mid-unit and while other mode keys are held, and decodes what a host
+// would see: Surface Dial rotation, key taps, wheel notches and volume presses. Checks that the
+// active mode follows the keys, that each output came to the steps turned in its mode within one
+// unit of scaling, that only the mode with detents vibrated, and that turning every mode back by
+// exactly what was turned in it leaves every output at zero, so no step was lost or counted in
+// another mode. A fast spin in the tap mode, let go of halfway, checks that no step is lost
+// while taps carry over well past the spin. Prints one JSON line per run.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "BluedroidHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "matrix.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define USAGE_FORWARD 0x30 // ']'
+#define USAGE_REVERSE 0x2F // '['
+#define MODE_TAPS 0
+#define MODE_WHEEL 1
+#define MODE_VOLUME 2
+#define MODE_RADIAL 3
+
+static KeyReport lastKeys;
+static MediaKeyReport lastMedia;
+static long radial;
+static long taps;
+static long wheel;
+static long volume;
+
+// Rotation and wheel are relative and add up; a key or volume bit that is new in a report is a
+// press
+static bool linkNotify(BLECharacteristic* characteristic){
+  if (characteristic->kind != 'I'){
+    return true;
+  }
+  if (characteristic->reportId == RADIAL_ID){
+    radial += (int16_t)((const RadialReport*)characteristic->getData())->rotation;
+  } else if (characteristic->reportId == WHEEL_ID){
+    wheel += ((const WheelReport*)characteristic->getData())->wheel;
+  } else if (characteristic->reportId == MEDIA_KEYS_ID){
+    const uint8_t* media = characteristic->getData();
+    uint8_t pressed = media[0] & ~lastMedia[0];
+    if (pressed & KEY_MEDIA_VOLUME_UP[0]) volume++;
+    if (pressed & KEY_MEDIA_VOLUME_DOWN[0]) volume--;
+    lastMedia[0] = media[0];
+    lastMedia[1] = media[1];
+  } else if (characteristic->reportId == KEYBOARD_ID){
+    const KeyReport* report = (const KeyReport*)characteristic->getData();
+    for (int i = 0; i < 6; i++){
+      uint8_t k = report->keys[i];
+      bool held = false;
+      for (int j = 0; j < 6; j++){
+        held = held || (k != 0 && lastKeys.keys[j] == k);
+      }
+      if (held) continue;
+      if (k == USAGE_FORWARD) taps++;
+      if (k == USAGE_REVERSE) taps--;
+    }
+    lastKeys = *report;
+  }
+  return true;
+}
+
+class FakeHaptics : public HapticBackend {
+public:
+  void vibrate(bool on){
+    if (on) this->starts++;
+  }
+  int starts = 0;
+};
+
+static BleKeyboard* connect(){
+  BluedroidHidTransport* transport = new BluedroidHidTransport();
+  BleKeyboard* keyboard = new BleKeyboard(transport, "Bench", "Bench", 100);
+  keyboard->begin();
+  esp_ble_gatts_cb_param_t param = {};
+  param.connect.conn_params.interval = 12;
+  transport->server()->callbacks->onConnect(transport->server());
+  transport->server()->callbacks->onConnect(transport->server(), &param);
+  return keyboard;
+}
+
+static void step(BleKeyboard* keyboard, TimerWheel* timers){
+  replay_clock_us += 1000;
+  timers->advance(replay_clock_us / 1000);
+  keyboard->update();
+}
+
+// Key 0 taps ']' / '[' every 2 steps, key 1 scrolls a notch every 4, key 2 steps the volume
+// every 3 and key 3 turns the Surface Dial every 2 with a detent every 2. The default mode
+// turns the Surface Dial every step.
+static void configure(InputPipeline* pipeline){
+  DialModeConfig& config = pipeline->dial_modes.config;
+  config.modes[MODE_TAPS].key = MODE_TAPS;
+  config.modes[MODE_TAPS].output = DIAL_MODE_KEYS;
+  config.modes[MODE_TAPS].stepsPerUnit = 2;
+  config.modes[MODE_TAPS].forward.key = ']';
+  config.modes[MODE_TAPS].reverse.key = '[';
+  config.modes[MODE_WHEEL].key = MODE_WHEEL;
+  config.modes[MODE_WHEEL].output = DIAL_MODE_WHEEL;
+  config.modes[MODE_WHEEL].stepsPerUnit = 4;
+  config.modes[MODE_VOLUME].key = MODE_VOLUME;
+  config.modes[MODE_VOLUME].output = DIAL_MODE_VOLUME;
+  config.modes[MODE_VOLUME].stepsPerUnit = 3;
+  config.modes[MODE_RADIAL].key = MODE_RADIAL;
+  config.modes[MODE_RADIAL].output = DIAL_MODE_RADIAL;
+  config.modes[MODE_RADIAL].stepsPerUnit = 2;
+  config.modes[MODE_RADIAL].detentSteps = 2;
+  config.modes[MODE_RADIAL].detentMs = 15;
+  pipeline->dial_modes.configure();
+}
+
+// Units an output shows for steps turned in a mode with stepsPerUnit scaling: within one unit,
+// rounded toward zero or one short of it after turning back
+static bool within(long units, long steps, int stepsPerUnit){
+  long left = steps - units * stepsPerUnit;
+  return left > -stepsPerUnit && left < stepsPerUnit;
+}
+
+static void run(const char* name, unsigned seed, uint32_t runMs, int maxDelta, int switchEvery){
+  BleKeyboard* keyboard = connect();
+  keyboard->dial_interval = 1; // So the default mode's own scaling carries nothing
+  TimerWheel timers;
+  FakeHaptics haptics;
+  InputPipeline pipeline(keyboard, &timers, &haptics);
+  configure(&pipeline);
+  replay_clock_us = 0;
+  timers.start(0);
+  lastKeys = KeyReport();
+  lastMedia[0] = lastMedia[1] = 0;
+  radial = taps = wheel = volume = 0;
+  replay_notify = linkNotify;
+  srand(seed);
+
+  bool held[DIAL_MODES] = {};
+  int active = -1;
+  long steps[DIAL_MODES + 1] = {}; // Default mode first
+  int switches = 0;
+  bool follows = true;
+  bool quiet = true;
+  for (uint32_t ms = 0; ms < runMs; ms++){
+    uint32_t now = replay_clock_us / 1000;
+    if (rand() % switchEvery == 0){
+      int m = rand() % DIAL_MODES;
+      held[m] = !held[m];
+      pipeline.key(m, held[m] ? KEY_PRESS_EVENT : KEY_UNPRESS_EVENT, now);
+      if (held[m]){
+        active = m;
+      } else if (active == m){
+        active = -1;
+      }
+      switches++;
+    }
+    follows = follows && pipeline.dial_modes.active() == active;
+    int delta = rand() % (2 * maxDelta + 1) - maxDelta;
+    if (delta != 0){
+      int starts = haptics.starts;
+      // The pipeline applies DIAL_ROTATION_DIRECTION, so undo it to turn by delta
+      pipeline.dial(delta * DIAL_ROTATION_DIRECTION, now);
+      steps[active + 1] += delta;
+      quiet = quiet && (haptics.starts == starts || active == MODE_RADIAL);
+    }
+    step(keyboard, &timers);
+  }
+  for (int m = 0; m < DIAL_MODES; m++){
+    if (held[m]) pipeline.key(m, KEY_UNPRESS_EVENT, replay_clock_us / 1000);
+  }
+  for (int ms = 0; ms < 5000; ms++){
+    step(keyboard, &timers);
+  }
+  // The default mode and the radial mode share the Surface Dial; the default mode's steps are exact
+  long shown[4] = {radial, taps, -wheel, volume};
+  bool close = within(taps, steps[MODE_TAPS + 1], 2) && within(-wheel, steps[MODE_WHEEL + 1], 4) &&
+               within(volume, steps[MODE_VOLUME + 1], 3) && within(radial - steps[0], steps[MODE_RADIAL + 1], 2);
+  int detents = haptics.starts;
+
+  // Turn each mode back by what was turned in it, one step at a time, the default mode last
+  for (int m = 0; m <= DIAL_MODES; m++){
+    int mode = m < DIAL_MODES ? m : -1;
+    long back = -steps[mode + 1];
+    if (mode >= 0) pipeline.key(mode, KEY_PRESS_EVENT, replay_clock_us / 1000);
+    for (; back != 0; back += back > 0 ? -1 : 1){
+      int delta = back > 0 ? 1 : -1;
+      pipeline.dial(delta * DIAL_ROTATION_DIRECTION, replay_clock_us / 1000);
+      step(keyboard, &timers);
+    }
+    // Let go, and the very next step is the default mode's again
+    if (mode >= 0) pipeline.key(mode, KEY_UNPRESS_EVENT, replay_clock_us / 1000);
+    follows = follows && pipeline.dial_modes.active() == -1;
+  }
+  for (int ms = 0; ms < 5000; ms++){
+    step(keyboard, &timers);
+  }
+  bool undone = radial == 0 && taps == 0 && wheel == 0 && volume == 0;
+
+  bool ok = follows && close && quiet && detents > 0 && undone;
+  checkLine(ok, "\"run\":\"%s\",\"ms\":%u,\"switches\":%d,\"steps\":[%ld,%ld,%ld,%ld,%ld],\"radial\":%ld,\"taps\":%ld,\"notches\":%ld,\"volume\":%ld,"
+            "\"detents\":%d,\"follows_keys\":%s,\"within_a_unit\":%s,\"undone\":%s",
+            name, runMs, switches, steps[0], steps[1], steps[2], steps[3], steps[4],
+            shown[0], shown[1], shown[2], shown[3], detents, jsonBool(follows), jsonBool(close), jsonBool(undone));
+  replay_notify = NULL;
+}
+
+// Holds the tap mode and spins stepsPerSecond for spinMs, letting go of the mode key halfway. The
+// tap mode's carry pays out at its rate cap long after the spin; every step must still come out,
+// as taps up to the release and as Surface Dial rotation after it.
+static void spinTaps(const char* name, int stepsPerSecond, uint32_t spinMs){
+  BleKeyboard* keyboard = connect();
+  keyboard->dial_interval = 1;
+  TimerWheel timers;
+  FakeHaptics haptics;
+  InputPipeline pipeline(keyboard, &timers, &haptics);
+  configure(&pipeline);
+  replay_clock_us = 0;
+  timers.start(0);
+  lastKeys = KeyReport();
+  lastMedia[0] = lastMedia[1] = 0;
+  radial = taps = wheel = volume = 0;
+  replay_notify = linkNotify;
+
+  pipeline.key(MODE_TAPS, KEY_PRESS_EVENT, 0);
+  long steps[2] = {}; // Tap mode, then the default mode
+  long turned = 0;
+  for (uint32_t ms = 0; ms < spinMs; ms++){
+    uint32_t now = replay_clock_us / 1000;
+    if (ms == spinMs / 2) pipeline.key(MODE_TAPS, KEY_UNPRESS_EVENT, now);
+    long due = (long)(ms + 1) * stepsPerSecond / 1000;
+    for (; turned < due; turned++){
+      pipeline.dial(DIAL_ROTATION_DIRECTION, now);
+      steps[ms >= spinMs / 2]++;
+    }
+    step(keyboard, &timers);
+  }
+  uint32_t drainMs = 0;
+  for (; drainMs < 120000 && pipeline.dial_modes.keys[MODE_TAPS].pending() != 0; drainMs++){
+    step(keyboard, &timers);
+  }
+  for (int ms = 0; ms < 1000; ms++){
+    step(keyboard, &timers);
+  }
+  long dropped = pipeline.dial_modes.keys[MODE_TAPS].dropped();
+  bool ok = dropped == 0 && taps == steps[0] / 2 && radial == steps[1];
+  checkLine(ok, "\"run\":\"%s\",\"steps_per_s\":%d,\"ms\":%u,\"tap_steps\":%ld,\"taps\":%ld,\"default_steps\":%ld,\"radial\":%ld,"
+            "\"dropped\":%ld,\"drain_ms\":%u",
+            name, stepsPerSecond, spinMs, steps[0], taps, steps[1], radial, dropped, drainMs);
+  replay_notify = NULL;
+}
+
+int main(int argc, char** argv){
+  run("slow", 1, 20000, 1, 200);     // A step at a time, keys change every 200 ms or so
+  run("fast", 2, 20000, 3, 50);      // Several steps per delta, keys change often
+  run("chatter", 3, 5000, 2, 3);     // Keys change nearly every step
+  spinTaps("fast_taps", 1000, 1000); // Far past the tap mode's rate cap
+  return checkStatus();
+}
@@ -0,0 +1,245 @@
+// Host check and throughput model of the BLE firmware update. A simulated client streams an
+// image through FirmwareUpdate over a modelled link into a simulated flash, and each scenario
+// prints one JSON line with the transfer rate in KB/s and whether it ended the way it should:
+// clean transfers at the common MTUs, a dropped link resumed, a lost chunk rewound, a corrupt
+// image, a flash failure and a reboot mid-transfer. Only a verified image may ever be activated.
+//
+// Link: the client sends write commands in every connection event, as many as fit in
+// LINK_PACKETS_PER_EVENT link layer packets, and no more than the window ahead of the last
+// acknowledgement. A notification reaches the client in the first event after it is sent.
+// Flash: chunks are written in order, each sector erased when the image first reaches it.
+// The costs are estimates, good for comparing MTUs and window sizes; the device prints the
+// real rate when an update finishes.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+#include "FirmwareUpdate.h"
+#include "check.h"
+
+#define IMAGE_SIZE 1000000
+#define PARTITION_SIZE 0x1E0000 //app0/app1 of the default partition table
+#define FLASH_SECTOR 4096
+#define FLASH_ERASE_US 45000 //One sector
+#define FLASH_PROGRAM_NS_PER_BYTE 2700 //Page program, 256 bytes in about 0.7 ms
+#define LINK_PACKETS_PER_EVENT 6 //Central to peripheral packets per connection event
+#define LINK_RECONNECT_US 2000000 //Link dropped until the client is back
+#define L2CAP_HEADER 4
+
+// Flash that keeps the image in memory, fails a write on request and records what was activated
+class SimFlash : public FlashBackend {
+public:
+  bool begin(uint32_t size){
+    if (size > PARTITION_SIZE) return false;
+    this->image.clear();
+    this->open = true;
+    this->erased = 0;
+    return true;
+  }
+  bool write(const uint8_t* data, size_t len){
+    if (!this->open || (this->failAt != 0 && this->image.size() + len > this->failAt)) return false;
+    // Sequential writes erase each sector as the image reaches it
+    size_t end = this->image.size() + len;
+    while (this->erased < end){
+      this->erased += FLASH_SECTOR;
+      this->costUs += FLASH_ERASE_US;
+    }
+    this->costUs += (uint64_t)len * FLASH_PROGRAM_NS_PER_BYTE / 1000;
+    this->image.insert(this->image.end(), data, data + len);
+    return true;
+  }
+  bool finish(){
+    bool ok = this->open;
+    this->open = false;
+    return ok;
+  }
+  bool activate(){
+    this->activated = this->image;
+    return true;
+  }
+  void abort(){
+    this->open = false;
+    this->aborts++;
+  }
+  std::vector<uint8_t> image;
+  std::vector<uint8_t> activated;
+  size_t failAt = 0;
+  size_t erased = 0;
+  uint64_t costUs = 0; // Flash time so far; the caller reads it before and after a write
+  int aborts = 0;
+  bool open = false;
+};
+
+struct Scenario {
+  const char* name;
+  uint16_t mtu;
+  uint16_t llPayload;     // 27 without data length extension, 251 with
+  uint32_t intervalUs;
+  uint32_t dropAt;        // Image offset at which the link drops, 0 for never
+  uint32_t loseChunk;     // Chunk number lost once on the air, 0 for none
+  bool corrupt;           // Client sends a hash that doesn't match the image
+  uint32_t failAt;        // Flash write fails past this offset, 0 for never
+  uint32_t rebootAt;      // Device restarts at this offset, losing the session
+  FirmwareUpdateResult expect;
+};
+
+struct Reply {
+  uint64_t at;
+  uint8_t data[FIRMWARE_UPDATE_REPLY_SIZE];
+};
+
+static std::vector<uint8_t> image;
+static uint8_t imageHash[32];
+
+static uint32_t readU32(const uint8_t* p){
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static size_t startRequest(uint8_t* request, bool corrupt){
+  request[0] = FW_OP_START;
+  for (int i = 0; i < 4; i++) request[1 + i] = (uint8_t)(IMAGE_SIZE >> (i * 8));
+  memcpy(request + 5, imageHash, 32);
+  if (corrupt) request[5] ^= 1;
+  return 37;
+}
+
+static void run(const Scenario& s){
+  SimFlash flash;
+  flash.failAt = s.failAt;
+  FirmwareUpdate* update = new FirmwareUpdate(&flash);
+  std::deque<Reply> replies;
+  uint64_t now = 0;
+  uint64_t deviceFree = 0; // The device handles one write at a time, in arrival order
+  uint32_t next = 0, acked = 0, sent = 0, chunkNumber = 0;
+  uint16_t chunk = 0;
+  int window = 0;
+  bool started = false, dropped = false, rebooted = false, lost = false;
+  uint8_t last[FIRMWARE_UPDATE_REPLY_SIZE] = {};
+
+  // The device takes a write once it is free, so its replies can't overtake earlier writes
+  auto deliver = [&](bool control, const uint8_t* data, size_t len){
+    uint64_t begin = deviceFree > now ? deviceFree : now;
+    uint64_t flashBefore = flash.costUs;
+    Reply reply;
+    size_t n = control ? update->control(data, len, begin / 1000, reply.data)
+                       : update->data(data, len, begin / 1000, reply.data);
+    deviceFree = begin + (flash.costUs - flashBefore);
+    if (n > 0){
+      reply.at = deviceFree;
+      replies.push_back(reply);
+    }
+  };
+
+  update->setMtu(s.mtu);
+  uint8_t request[37];
+  deliver(true, request, startRequest(request, s.corrupt));
+  for (int events = 0; events < 10000000; events++, now += s.intervalUs){
+    // Notifications sent since the last event, up to the first one that ends the transfer
+    bool finished = false;
+    while (!finished && !replies.empty() && replies.front().at <= now){
+      const uint8_t* r = replies.front().data;
+      memcpy(last, r, sizeof(last));
+      finished = r[1] == FW_STATE_DONE || (r[0] != FW_RESULT_OK && r[0] != FW_RESULT_OUT_OF_ORDER);
+      if (!finished){
+        acked = readU32(r + 2);
+        chunk = r[6] | r[7] << 8;
+        window = r[8];
+        started = true;
+        if (r[0] == FW_RESULT_OUT_OF_ORDER || next < acked) next = acked;
+      }
+      replies.pop_front();
+    }
+    if (finished){
+      break;
+    }
+    if (!started){
+      continue;
+    }
+    if (s.dropAt != 0 && !dropped && next >= s.dropAt){
+      // Everything in flight is lost; the client reconnects and asks to resume
+      dropped = true;
+      replies.clear();
+      now += LINK_RECONNECT_US;
+      started = false;
+      deliver(true, request, startRequest(request, s.corrupt));
+      continue;
+    }
+    if (s.rebootAt != 0 && !rebooted && next >= s.rebootAt){
+      // A restart loses the session, and the half written image with it
+      rebooted = true;
+      replies.clear();
+      delete update;
+      flash.abort();
+      update = new FirmwareUpdate(&flash);
+      update->setMtu(s.mtu);
+      now += LINK_RECONNECT_US;
+      deviceFree = now;
+      started = false;
+      next = acked = 0;
+      deliver(true, request, startRequest(request, s.corrupt));
+      continue;
+    }
+    int packets = LINK_PACKETS_PER_EVENT;
+    while (next < IMAGE_SIZE && (next - acked) < (uint32_t)window * chunk){
+      uint32_t len = IMAGE_SIZE - next < chunk ? IMAGE_SIZE - next : chunk;
+      int cost = (L2CAP_HEADER + FIRMWARE_UPDATE_ATT_HEADER + FIRMWARE_UPDATE_CHUNK_HEADER + len + s.llPayload - 1) / s.llPayload;
+      if (cost > packets) break;
+      packets -= cost;
+      uint8_t write[FIRMWARE_UPDATE_CHUNK_HEADER + 512];
+      for (int i = 0; i < 4; i++) write[i] = (uint8_t)(next >> (i * 8));
+      memcpy(write + FIRMWARE_UPDATE_CHUNK_HEADER, image.data() + next, len);
+      chunkNumber++;
+      if (s.loseChunk != 0 && !lost && chunkNumber == s.loseChunk){
+        lost = true;
+      } else {
+        deliver(false, write, FIRMWARE_UPDATE_CHUNK_HEADER + len);
+      }
+      next += len;
+      sent++;
+    }
+  }
+
+  const FirmwareUpdateStats& stats = update->stats();
+  bool activated = !flash.activated.empty();
+  bool imageOk = flash.activated == image;
+  FirmwareUpdateResult result = (FirmwareUpdateResult)last[0];
+  bool ok = result == s.expect && (s.expect == FW_RESULT_OK ? imageOk : !activated);
+  uint32_t rate = stats.bytesPerSecond();
+  checkLine(ok, "\"scenario\":\"%s\",\"mtu\":%u,\"chunk\":%u,\"interval_ms\":%.1f,\"result\":%d,\"state\":%d,"
+            "\"bytes\":%u,\"writes\":%u,\"rewinds\":%u,\"resumes\":%u,\"ms\":%u,\"kb_per_s\":%.1f,"
+            "\"activated\":%s",
+            s.name, s.mtu, chunk, s.intervalUs / 1000.0, result, last[1],
+            stats.bytes, sent, stats.rewinds, stats.resumes, stats.finishedAt - stats.startedAt,
+            rate / 1024.0, jsonBool(activated));
+  delete update;
+}
+
+int main(int argc, char** argv){
+  srand(1);
+  image.resize(IMAGE_SIZE);
+  for (size_t i = 0; i < image.size(); i++) image[i] = rand();
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+  mbedtls_sha256_update_ret(&sha, image.data(), image.size());
+  mbedtls_sha256_finish_ret(&sha, imageHash);
+
+  static const Scenario scenarios[] = {
+    {"mtu23", 23, 27, 15000, 0, 0, false, 0, 0, FW_RESULT_OK},
+    {"mtu185", 185, 251, 15000, 0, 0, false, 0, 0, FW_RESULT_OK},
+    {"mtu247", 247, 251, 15000, 0, 0, false, 0, 0, FW_RESULT_OK},
+    {"mtu247_7.5ms", 247, 251, 7500, 0, 0, false, 0, 0, FW_RESULT_OK},
+    {"mtu517_7.5ms", 517, 251, 7500, 0, 0, false, 0, 0, FW_RESULT_OK},
+    {"link_drop_resume", 247, 251, 15000, 400000, 0, false, 0, 0, FW_RESULT_OK},
+    {"lost_chunk_rewind", 247, 251, 15000, 0, 1000, false, 0, 0, FW_RESULT_OK},
+    {"reboot_restart", 247, 251, 15000, 0, 0, false, 0, 300000, FW_RESULT_OK},
+    {"bad_hash", 247, 251, 15000, 0, 0, true, 0, 0, FW_RESULT_HASH_MISMATCH},
+    {"flash_error", 247, 251, 15000, 0, 0, false, 500000, 0, FW_RESULT_FLASH_ERROR},
+  };
+  for (const Scenario& s : scenarios){
+    run(s);
+  }
+  return checkStatus();
+}
@@ -0,0 +1,179 @@
+// Host check of ReconnectManager against a fake AdvertisingBackend. update() runs on the HID
+// task's idle period; the link callbacks post from "the stack" between updates. Checks the
+// directed -> fast -> slow schedule with and without a bonded host, the reconnect histogram for
+// known disconnect-to-reconnect times, that changes posted between two updates are applied in
+// order, and that the manager follows the link after more changes than it can hold. Prints one
+// JSON line per check.
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ReconnectManager.h"
+#include "check.h"
+
+#define STEP_MS 5 //HID_TASK_IDLE_MS
+
+// What the radio was told to do, and when
+struct Call {
+  char kind; // 'D' directed, 'U' undirected, 'S' stop
+  uint32_t at;
+  uint16_t minInterval;
+};
+
+class FakeAdvertising : public AdvertisingBackend {
+public:
+  bool startDirected(){
+    if (this->bonded) this->calls.push_back({'D', this->now, 0});
+    return this->bonded;
+  }
+  void startUndirected(uint16_t minInterval, uint16_t maxInterval){
+    this->calls.push_back({'U', this->now, minInterval});
+  }
+  void stop(){
+    this->calls.push_back({'S', this->now, 0});
+  }
+  // The last start, stops left out
+  const Call* last() const {
+    for (size_t i = this->calls.size(); i > 0; i--){
+      if (this->calls[i - 1].kind != 'S') return &this->calls[i - 1];
+    }
+    return NULL;
+  }
+  std::vector<Call> calls;
+  bool bonded = true;
+  uint32_t now = 0;
+};
+
+static void run(ReconnectManager* manager, FakeAdvertising* advertising, uint32_t from, uint32_t to){
+  for (uint32_t t = from; t <= to; t += STEP_MS){
+    advertising->now = t;
+    manager->update(t);
+  }
+}
+
+static uint32_t entered(const FakeAdvertising& advertising, char kind, uint16_t minInterval){
+  for (const Call& call : advertising.calls){
+    if (call.kind == kind && call.minInterval == minInterval) return call.at;
+  }
+  return UINT32_MAX;
+}
+
+// Directed for RECONNECT_DIRECTED_MS, fast for RECONNECT_FAST_MS, then slow until a host connects;
+// without a bonded host the directed phase is skipped
+static void runSchedule(const char* name, bool bonded){
+  FakeAdvertising advertising;
+  advertising.bonded = bonded;
+  ReconnectManager manager(&advertising);
+  manager.start(0);
+  bool first = manager.phase() == (bonded ? RECONNECT_DIRECTED : RECONNECT_FAST);
+  run(&manager, &advertising, 0, 2 * RECONNECT_FAST_MS);
+  uint32_t fastAt = entered(advertising, 'U', RECONNECT_FAST_INTERVAL_MIN);
+  uint32_t slowAt = entered(advertising, 'U', RECONNECT_SLOW_INTERVAL_MIN);
+  uint32_t directedMs = bonded ? RECONNECT_DIRECTED_MS : 0;
+  // Fast and slow start on the first update at or past their time
+  bool onTime = fastAt >= directedMs && fastAt < directedMs + STEP_MS &&
+                slowAt >= fastAt + RECONNECT_FAST_MS && slowAt < fastAt + RECONNECT_FAST_MS + STEP_MS;
+  bool slow = manager.phase() == RECONNECT_SLOW && advertising.last()->minInterval == RECONNECT_SLOW_INTERVAL_MIN;
+  size_t starts = 0;
+  for (const Call& call : advertising.calls) starts += call.kind != 'S';
+  bool ok = first && onTime && slow && starts == (bonded ? 3u : 2u);
+  checkLine(ok, "\"check\":\"schedule\",\"run\":\"%s\",\"fast_at_ms\":%u,\"slow_at_ms\":%u,\"starts\":%zu",
+            name, fastAt, slowAt, starts);
+}
+
+// Each drop is timed to the next connection; a drop into pairing is not
+static void runHistogram(){
+  static const uint32_t gaps[] = {40, 100, 180, 700, 1280, 4000, 9000, 25000, 45000, 90000};
+  static const uint32_t expect[RECONNECT_HISTOGRAM_BUCKETS] = {2, 1, 0, 1, 1, 1, 1, 1, 1, 1};
+  FakeAdvertising advertising;
+  ReconnectManager manager(&advertising);
+  manager.start(0);
+  manager.onConnected(500);
+  uint32_t t = 1000;
+  for (uint32_t gap : gaps){
+    manager.onDisconnected(t);
+    run(&manager, &advertising, t, t + gap - 1);
+    manager.onConnected(t + gap);
+    run(&manager, &advertising, t + gap, t + gap + 1000);
+    t += gap + 2000;
+  }
+  manager.pair(t);
+  manager.onDisconnected(t);
+  run(&manager, &advertising, t, t + 3000);
+  manager.onConnected(t + 3000);
+  run(&manager, &advertising, t + 3000, t + 3005);
+
+  const ReconnectHistogram& histogram = manager.histogram();
+  bool buckets = true;
+  char counts[RECONNECT_HISTOGRAM_BUCKETS * 12] = "";
+  size_t length = 0;
+  for (int i = 0; i < RECONNECT_HISTOGRAM_BUCKETS; i++){
+    buckets = buckets && histogram.buckets[i] == expect[i];
+    length += snprintf(counts + length, sizeof(counts) - length, i == 0 ? "%u" : ",%u", histogram.buckets[i]);
+  }
+  bool ok = buckets && histogram.count == 10 && histogram.min == 40 && histogram.max == 90000 &&
+            histogram.last == 90000 && manager.phase() == RECONNECT_IDLE;
+  checkLine(ok, "\"check\":\"histogram\",\"count\":%u,\"min\":%u,\"max\":%u,\"last\":%u,\"buckets\":[%s]",
+            histogram.count, histogram.min, histogram.max, histogram.last, counts);
+}
+
+// A drop and a reconnect posted before the HID task runs are both applied, in order; a drop
+// stamped after update() read the clock doesn't cut the directed phase short
+static void runPosted(){
+  FakeAdvertising advertising;
+  ReconnectManager manager(&advertising);
+  manager.start(0);
+  manager.onConnected(100);
+  manager.update(100);
+  manager.onDisconnected(2000);
+  manager.onConnected(2030);
+  bool deferred = manager.phase() == RECONNECT_IDLE && advertising.calls.size() == 2;
+  advertising.now = 2035;
+  manager.update(2035);
+  bool inOrder = manager.phase() == RECONNECT_IDLE && manager.histogram().count == 1 &&
+                 manager.histogram().last == 30 && advertising.last()->kind == 'D';
+  manager.onDisconnected(5003);
+  manager.update(5000);
+  bool early = manager.phase() == RECONNECT_DIRECTED;
+  manager.update(5005);
+  early = early && manager.phase() == RECONNECT_DIRECTED;
+  bool ok = deferred && inOrder && early;
+  checkLine(ok, "\"check\":\"posted\",\"applied_by_update\":%s,\"in_order\":%s,\"late_stamp\":%s",
+            jsonBool(deferred), jsonBool(inOrder), jsonBool(early));
+}
+
+// More changes than RECONNECT_EVENTS between two updates: the ones that fit are applied and the
+// manager ends up following the link, advertising while it is down and idle while it is up
+static void runOverflow(){
+  for (int up = 0; up < 2; up++){
+    FakeAdvertising advertising;
+    ReconnectManager manager(&advertising);
+    manager.start(0);
+    manager.onConnected(100);
+    manager.update(100);
+    int changes = 3 * RECONNECT_EVENTS + 1 - up; // Odd ends on a drop
+    for (int i = 0; i < changes; i++){
+      if (i % 2 == 0){
+        manager.onDisconnected(200 + i);
+      } else {
+        manager.onConnected(200 + i);
+      }
+    }
+    advertising.now = 300;
+    manager.update(300);
+    bool follows = up ? manager.phase() == RECONNECT_IDLE : manager.phase() != RECONNECT_IDLE;
+    manager.update(305);
+    bool settled = follows && (up ? manager.phase() == RECONNECT_IDLE : manager.phase() == RECONNECT_DIRECTED);
+    checkLine(settled, "\"check\":\"overflow\",\"changes\":%d,\"link\":\"%s\",\"follows_link\":%s",
+              changes, up ? "up" : "down", jsonBool(follows));
+  }
+}
+
+int main(int argc, char** argv){
+  runSchedule("bonded", true);
+  runSchedule("no_bond", false);
+  runHistogram();
+  runPosted();
+  runOverflow();
+  return checkStatus();
+}
@@ -0,0 +1,151 @@
+// Replays input traces recorded by InputTraceBuffer through the firmware's own debounce,
+// keymap dispatch, dial scaling and report building, and prints the HID reports it sends:
+//
+//   <time us> <I|O|F><report id> <hex bytes>
+//
+// Traces are either the raw snapshot or the TRACE-BEGIN/TRACE-END hex dump printed on serial.
+// Each trace runs against a fresh BleKeyboard on LoopbackHidTransport whose bonded host has
+// already subscribed, so the output only depends on the trace. Lines starting with # are the
+// trace name and the loopback host's connection events.
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "BleKeyboard.h"
+#include "LoopbackHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "InputTrace.h"
+#include "matrix.h"
+#include "encoder.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+static bool readFile(const char* path, std::vector<uint8_t>* out){
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) return false;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0){
+    out->insert(out->end(), chunk, chunk + n);
+  }
+  fclose(f);
+  return true;
+}
+
+// Pulls the hex between TRACE-BEGIN and TRACE-END out of a serial log
+static bool unhex(const std::vector<uint8_t>& text, std::vector<uint8_t>* out){
+  std::string s(text.begin(), text.end());
+  size_t begin = s.find("TRACE-BEGIN");
+  size_t end = s.find("TRACE-END", begin);
+  if (begin == std::string::npos || end == std::string::npos) return false;
+  begin = s.find('\n', begin);
+  int high = -1;
+  for (size_t i = begin; i < end; i++){
+    char c = s[i];
+    int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    if (v < 0) continue;
+    if (high < 0){
+      high = v;
+    } else {
+      out->push_back(high << 4 | v);
+      high = -1;
+    }
+  }
+  return true;
+}
+
+class Replay {
+public:
+  Replay() : transport(stdout), keyboard(&this->transport, "Replay", "Replay", 100), pipeline(&this->keyboard, &this->timers) {
+    this->keyboard.begin();
+    this->transport.connect(true, BLE_DEFAULT_INTERVAL_US);
+  }
+
+  void run(InputTraceReader* reader){
+    TraceState start = reader->start();
+    uint64_t matrixUs = start.timeUs;
+    uint32_t raw = start.raw;
+    this->encoder.delta(start.count);
+    this->tick(start.timeUs);
+    TraceRecord record;
+    while (reader->next(&record)){
+      if (record.type == TRACE_RECORD_MATRIX){
+        // The unchanged samples were taken on the scan period between the two records
+        for (uint32_t i = 1; i <= record.run; i++){
+          this->scan(raw, matrixUs + (record.timeUs - matrixUs) * i / (record.run + 1));
+        }
+        this->scan(record.raw, record.timeUs);
+        raw = record.raw;
+        matrixUs = record.timeUs;
+      } else {
+        int16_t d = this->encoder.delta(record.count);
+        if (d != 0){
+          this->pipeline.dial(d, record.timeUs / 1000);
+        }
+        this->tick(record.timeUs);
+      }
+    }
+  }
+
+private:
+  void scan(MatrixBits raw, uint64_t timeUs){
+    replay_clock_us = timeUs;
+    int changes_buff[PadMatrix::keys] = {};
+    this->matrix.process(raw, changes_buff);
+    for (int k = 0; k < PadMatrix::keys; k++){
+      if (changes_buff[k] != 0){
+        this->pipeline.key(k, changes_buff[k], timeUs / 1000);
+      }
+    }
+    this->tick(timeUs);
+  }
+
+  // What the HID task does after draining the queue
+  void tick(uint64_t timeUs){
+    replay_clock_us = timeUs;
+    this->keyboard.update();
+    this->timers.advance(timeUs / 1000);
+  }
+
+  LoopbackHidTransport transport;
+  BleKeyboard keyboard;
+  TimerWheel timers;
+  InputPipeline pipeline;
+  PadMatrix matrix;
+  RotaryEncoder encoder;
+};
+
+int main(int argc, char** argv){
+  if (argc < 2){
+    fprintf(stderr, "usage: %s trace...\n", argv[0]);
+    return 2;
+  }
+  int failed = 0;
+  for (int i = 1; i < argc; i++){
+    std::vector<uint8_t> data;
+    if (!readFile(argv[i], &data)){
+      fprintf(stderr, "%s: cannot read\n", argv[i]);
+      failed++;
+      continue;
+    }
+    std::vector<uint8_t> decoded;
+    if (unhex(data, &decoded)){
+      data.swap(decoded);
+    }
+    InputTraceReader reader(data.data(), data.size());
+    if (!reader.valid()){
+      fprintf(stderr, "%s: not an input trace\n", argv[i]);
+      failed++;
+      continue;
+    }
+    printf("# %s\n", argv[i]);
+    replay_clock_us = 0;
+    Replay replay;
+    replay.run(&reader);
+  }
+  return failed == 0 ? 0 : 1;
+}
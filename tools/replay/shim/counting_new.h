@@ -0,0 +1,26 @@
+// Replaces every form of operator new and delete with malloc and free, counting each
+// allocation in replay_allocations. Include it in the one file of a host tool that has main().
+#ifndef COUNTING_NEW_H
+#define COUNTING_NEW_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+
+static uint64_t replay_allocations = 0;
+
+static void* replay_counted(size_t size){
+  replay_allocations++;
+  void* p = malloc(size != 0 ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size){ return replay_counted(size); }
+void* operator new[](size_t size){ return replay_counted(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t size) noexcept { free(p); }
+void operator delete[](void* p, size_t size) noexcept { free(p); }
+
+#endif // COUNTING_NEW_H
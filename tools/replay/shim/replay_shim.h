@@ -0,0 +1,395 @@
+// Host stand-ins for the Arduino core and the ESP32 BLE library, just enough to run the
+// firmware's report path off target. Notifications go to replay_notify instead of a radio,
+// and the clock is whatever the replay says it is. replay_tick, if set, runs whenever the
+// firmware waits, so a fake link can drain its buffer or clear congestion meanwhile.
+#ifndef REPLAY_SHIM_H
+#define REPLAY_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define CONFIG_BT_ENABLED 1
+#define IRAM_ATTR
+#define PROGMEM
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 1
+#define OUTPUT 2
+#define INPUT_PULLUP 3
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+#define ESP_LOGI(tag, ...) ((void)tag)
+#define ESP_LOGW(tag, ...) ((void)tag)
+#define ESP_LOGE(tag, ...) ((void)tag)
+#define ESP_LOGD(tag, ...) ((void)tag)
+
+extern uint64_t replay_clock_us;
+extern void (*replay_tick)(void);
+
+inline unsigned long millis(){ return replay_clock_us / 1000; }
+inline unsigned long micros(){ return replay_clock_us; }
+inline int64_t esp_timer_get_time(){ return (int64_t)replay_clock_us; }
+inline void delay(uint32_t ms){ replay_clock_us += (uint64_t)ms * 1000; if (replay_tick) replay_tick(); }
+inline void delayMicroseconds(uint32_t us){ replay_clock_us += us; if (replay_tick) replay_tick(); }
+inline uint32_t getCpuFrequencyMhz(){ return 240; }
+// Pin and I2C traffic goes to replay_io() when a tool installs one, so it can model the
+// hardware behind the pins and what each call costs
+class ReplayIo {
+public:
+  virtual ~ReplayIo(){}
+  virtual void pinWrite(int pin, int value){}
+  virtual int pinRead(int pin){ return HIGH; }
+  virtual void i2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop){}
+  virtual size_t i2cRead(uint8_t address, uint8_t* data, size_t len){ return 0; }
+};
+
+inline ReplayIo*& replay_io(){
+  static ReplayIo* io = NULL;
+  return io;
+}
+
+inline void pinMode(int pin, int mode){}
+inline void digitalWrite(int pin, int value){ if (replay_io()) replay_io()->pinWrite(pin, value); }
+inline int digitalRead(int pin){ return replay_io() ? replay_io()->pinRead(pin) : HIGH; }
+
+class TwoWire {
+public:
+  void begin(){}
+  void setClock(uint32_t hz){}
+  void beginTransmission(uint8_t address){ this->address = address; this->len = 0; }
+  size_t write(uint8_t value){
+    if (this->len < sizeof(this->buffer)) this->buffer[this->len++] = value;
+    return 1;
+  }
+  uint8_t endTransmission(bool stop = true){
+    if (replay_io()) replay_io()->i2cWrite(this->address, this->buffer, this->len, stop);
+    return 0;
+  }
+  uint8_t requestFrom(uint8_t address, uint8_t len){
+    this->len = len < sizeof(this->buffer) ? len : sizeof(this->buffer);
+    this->len = replay_io() ? replay_io()->i2cRead(address, this->buffer, this->len) : 0;
+    this->pos = 0;
+    return this->len;
+  }
+  int available(){ return this->len - this->pos; }
+  int read(){ return this->pos < this->len ? this->buffer[this->pos++] : -1; }
+private:
+  uint8_t address = 0;
+  uint8_t buffer[32];
+  size_t len = 0;
+  size_t pos = 0;
+};
+
+static TwoWire Wire;
+
+// The GPIO register block as plain memory, and a 240 MHz cycle counter that moves the replay
+// clock on as it is polled, so a busy-wait ends; tools that model the pins use their own Io
+typedef struct {
+  uint32_t out_w1ts;
+  uint32_t out_w1tc;
+  uint32_t in;
+  struct { uint32_t data; } in1;
+} gpio_dev_t;
+
+inline gpio_dev_t& replay_gpio(){
+  static gpio_dev_t gpio;
+  return gpio;
+}
+#define GPIO replay_gpio()
+
+inline uint32_t xthal_get_ccount(){
+  replay_clock_us++;
+  return (uint32_t)(replay_clock_us * 240);
+}
+
+// Serial output is discarded so it cannot mix with the report stream on stdout
+class Print {
+public:
+  virtual ~Print(){}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size){ return size; }
+  void setWriteError(int err = 1){}
+  size_t print(const char* s){ return 0; }
+  size_t print(char c){ return 0; }
+  size_t print(int n, int base = DEC){ return 0; }
+  size_t print(unsigned n, int base = DEC){ return 0; }
+  size_t print(long n, int base = DEC){ return 0; }
+  size_t print(unsigned long n, int base = DEC){ return 0; }
+  size_t print(double n, int digits = 2){ return 0; }
+  size_t println(const char* s){ return 0; }
+  size_t println(int n, int base = DEC){ return 0; }
+  size_t println(unsigned n, int base = DEC){ return 0; }
+  size_t println(long n, int base = DEC){ return 0; }
+  size_t println(unsigned long n, int base = DEC){ return 0; }
+  size_t println(double n, int digits = 2){ return 0; }
+  size_t println(){ return 0; }
+  size_t printf(const char* format, ...){ return 0; }
+};
+
+class HardwareSerial : public Print {
+public:
+  size_t write(uint8_t c){ return 1; }
+  void begin(int baud){}
+  int available(){ return 0; }
+  int read(){ return -1; }
+};
+
+extern HardwareSerial Serial;
+
+typedef uint8_t esp_bd_addr_t[6];
+typedef int esp_err_t;
+typedef int esp_gatt_if_t;
+typedef uint16_t esp_gatt_perm_t;
+#define ESP_GATT_PERM_READ 0x01
+#define ESP_GATT_PERM_WRITE 0x10
+#define ESP_GATT_PERM_WRITE_ENCRYPTED 0x20
+#define ESP_OK 0
+#define ESP_BLE_ID_KEY_MASK (1 << 1)
+typedef enum { BLE_ADDR_TYPE_PUBLIC = 0, BLE_ADDR_TYPE_RANDOM, BLE_ADDR_TYPE_RPA_PUBLIC, BLE_ADDR_TYPE_RPA_RANDOM } esp_ble_addr_type_t;
+typedef enum { ADV_TYPE_IND = 0, ADV_TYPE_DIRECT_IND_HIGH, ADV_TYPE_SCAN_IND, ADV_TYPE_NONCONN_IND, ADV_TYPE_DIRECT_IND_LOW } esp_ble_adv_type_t;
+typedef enum { ADV_CHNL_ALL = 7 } esp_ble_adv_channel_t;
+typedef enum { ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0 } esp_ble_adv_filter_t;
+typedef enum { ESP_LE_AUTH_BOND = 1 } esp_ble_auth_req_t;
+typedef struct {
+  uint16_t adv_int_min, adv_int_max;
+  esp_ble_adv_type_t adv_type;
+  esp_ble_addr_type_t own_addr_type;
+  esp_bd_addr_t peer_addr;
+  esp_ble_addr_type_t peer_addr_type;
+  esp_ble_adv_channel_t channel_map;
+  esp_ble_adv_filter_t adv_filter_policy;
+} esp_ble_adv_params_t;
+typedef enum { ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT = 20 } esp_gap_ble_cb_event_t;
+typedef enum { ESP_BT_STATUS_SUCCESS = 0 } esp_bt_status_t;
+typedef union {
+  struct { esp_bt_status_t status; esp_bd_addr_t bda; uint16_t min_int, max_int, latency, conn_int, timeout; } update_conn_params;
+} esp_ble_gap_cb_param_t;
+typedef struct { uint8_t irk[16]; esp_ble_addr_type_t addr_type; esp_bd_addr_t static_addr; } esp_ble_pid_keys_t;
+typedef struct { esp_ble_pid_keys_t pid_key; uint8_t key_mask; } esp_ble_bond_key_info_t;
+typedef struct { esp_bd_addr_t bd_addr; esp_ble_bond_key_info_t bond_key; } esp_ble_bond_dev_t;
+
+inline esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t* params){ return ESP_OK; }
+inline esp_err_t esp_ble_gap_stop_advertising(){ return ESP_OK; }
+// One bonded host at the all zero address, so connecting restores every CCCD like a reconnect
+inline int esp_ble_get_bond_device_num(){ return 1; }
+inline esp_err_t esp_ble_get_bond_device_list(int* count, esp_ble_bond_dev_t* list){
+  memset(list, 0, sizeof(esp_ble_bond_dev_t));
+  *count = 1;
+  return ESP_OK;
+}
+
+typedef union {
+  struct { uint16_t conn_id; esp_bd_addr_t remote_bda; struct { uint16_t interval, latency, timeout; } conn_params; } connect;
+  struct { uint16_t conn_id; esp_bd_addr_t remote_bda; int reason; } disconnect;
+  struct { uint16_t conn_id; bool congested; } congest;
+  struct { uint16_t conn_id; uint16_t mtu; } mtu;
+} esp_ble_gatts_cb_param_t;
+typedef enum { ESP_GATTS_CONNECT_EVT, ESP_GATTS_DISCONNECT_EVT, ESP_GATTS_CONGEST_EVT, ESP_GATTS_MTU_EVT, ESP_GATTS_CONF_EVT } esp_gatts_cb_event_t;
+
+class BLEUUID {
+public:
+  BLEUUID(){}
+  BLEUUID(uint16_t uuid){}
+  BLEUUID(const char* uuid){}
+  std::string toString(){ return ""; }
+};
+
+class BLEDescriptor;
+class BLECharacteristic;
+class BLEServer;
+
+class BLEDescriptorCallbacks {
+public:
+  virtual ~BLEDescriptorCallbacks(){}
+  virtual void onRead(BLEDescriptor* descriptor){}
+  virtual void onWrite(BLEDescriptor* descriptor){}
+};
+
+class BLEDescriptor {
+public:
+  BLEDescriptor(BLEUUID uuid){}
+  virtual ~BLEDescriptor(){}
+  void setCallbacks(BLEDescriptorCallbacks* callbacks){ this->callbacks = callbacks; }
+  uint8_t* getValue(){ return this->value; }
+  size_t getLength(){ return 2; }
+  void setValue(uint8_t* data, size_t size){ memcpy(this->value, data, size < 2 ? size : 2); }
+  BLEUUID getUUID(){ return BLEUUID(); }
+  BLEDescriptorCallbacks* callbacks = NULL;
+  uint8_t value[2] = {0, 0};
+};
+
+class BLE2902 : public BLEDescriptor {
+public:
+  BLE2902() : BLEDescriptor(BLEUUID((uint16_t)0x2902)){}
+  bool getNotifications(){ return this->value[0] & 1; }
+  bool getIndications(){ return this->value[0] & 2; }
+  void setNotifications(bool on){ this->value[0] = on ? (this->value[0] | 1) : (this->value[0] & ~1); }
+  void setIndications(bool on){ this->value[0] = on ? (this->value[0] | 2) : (this->value[0] & ~2); }
+};
+
+class BLECharacteristicCallbacks {
+public:
+  typedef enum { SUCCESS_INDICATE, SUCCESS_NOTIFY, ERROR_INDICATE_DISABLED, ERROR_NOTIFY_DISABLED, ERROR_GATT, ERROR_NO_CLIENT, ERROR_INDICATE_TIMEOUT, ERROR_INDICATE_FAILURE } Status;
+  virtual ~BLECharacteristicCallbacks(){}
+  virtual void onRead(BLECharacteristic* characteristic){}
+  virtual void onWrite(BLECharacteristic* characteristic){}
+  virtual void onNotify(BLECharacteristic* characteristic){}
+  virtual void onStatus(BLECharacteristic* characteristic, Status s, uint32_t code){}
+};
+
+// Returns false to make the notification fail the way a full stack buffer does
+extern bool (*replay_notify)(BLECharacteristic* characteristic);
+
+class BLECharacteristic {
+public:
+  static const uint32_t PROPERTY_READ = 1, PROPERTY_WRITE = 2, PROPERTY_NOTIFY = 4, PROPERTY_WRITE_NR = 8, PROPERTY_INDICATE = 16;
+  BLECharacteristic(BLEUUID uuid, uint32_t properties = 0){}
+  void setValue(uint8_t* data, size_t size){ this->value.assign((const char*)data, size); }
+  void setValue(std::string data){ this->value = data; }
+  void setValue(uint16_t& data){ this->value.assign((const char*)&data, 2); }
+  std::string getValue(){ return this->value; }
+  uint8_t* getData(){ return (uint8_t*)this->value.data(); }
+  size_t getLength(){ return this->value.size(); }
+  void notify(bool is_notification = true){
+    bool ok = replay_notify == NULL || replay_notify(this);
+    if (this->callbacks != NULL){
+      this->callbacks->onStatus(this, ok ? BLECharacteristicCallbacks::SUCCESS_NOTIFY : BLECharacteristicCallbacks::ERROR_GATT, 0);
+    }
+  }
+  void indicate(){}
+  void setCallbacks(BLECharacteristicCallbacks* callbacks){ this->callbacks = callbacks; }
+  void setAccessPermissions(esp_gatt_perm_t perm){}
+  BLEDescriptor* getDescriptorByUUID(BLEUUID uuid){ return this->descriptors.empty() ? NULL : this->descriptors[0]; }
+  void addDescriptor(BLEDescriptor* descriptor){ this->descriptors.push_back(descriptor); }
+  BLEUUID getUUID(){ return BLEUUID(); }
+  uint16_t getHandle(){ return 0; }
+  std::string value;
+  BLECharacteristicCallbacks* callbacks = NULL;
+  std::vector<BLEDescriptor*> descriptors;
+  char kind = 0; // 'I', 'O' or 'F' for HID reports
+  uint8_t reportId = 0;
+};
+
+// Every characteristic the stack stand-ins created, so a tool can write to one the way a host would
+inline std::vector<BLECharacteristic*>& replay_characteristics(){
+  static std::vector<BLECharacteristic*> created;
+  return created;
+}
+
+class BLEService {
+public:
+  BLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties){ return this->created(new BLECharacteristic(BLEUUID(uuid), properties)); }
+  BLECharacteristic* createCharacteristic(BLEUUID uuid, uint32_t properties){ return this->created(new BLECharacteristic(uuid, properties)); }
+  void start(){}
+  void addCharacteristic(BLECharacteristic* characteristic){}
+  BLEUUID getUUID(){ return BLEUUID(); }
+private:
+  BLECharacteristic* created(BLECharacteristic* characteristic){
+    replay_characteristics().push_back(characteristic);
+    return characteristic;
+  }
+};
+
+class BLEAdvertising {
+public:
+  void start(){}
+  void stop(){}
+  void setAppearance(uint16_t appearance){}
+  void addServiceUUID(BLEUUID uuid){}
+  void setScanResponse(bool on){}
+  void setMinInterval(uint16_t interval){}
+  void setMaxInterval(uint16_t interval){}
+  void setMinPreferred(uint16_t interval){}
+  void setMaxPreferred(uint16_t interval){}
+};
+
+class BLEServerCallbacks {
+public:
+  virtual ~BLEServerCallbacks(){}
+  virtual void onConnect(BLEServer* server){}
+  virtual void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param){}
+  virtual void onDisconnect(BLEServer* server){}
+};
+
+class BLEServer {
+public:
+  void setCallbacks(BLEServerCallbacks* callbacks){ this->callbacks = callbacks; }
+  BLEService* createService(const char* uuid){ return new BLEService(); }
+  BLEService* createService(BLEUUID uuid, uint32_t handles = 15, uint8_t instance = 0){ return new BLEService(); }
+  BLEAdvertising* getAdvertising(){ return &this->advertising; }
+  uint16_t getConnId(){ return 0; }
+  uint32_t getConnectedCount(){ return 1; }
+  void updateConnParams(esp_bd_addr_t addr, uint16_t min, uint16_t max, uint16_t latency, uint16_t timeout){}
+  uint16_t getPeerMTU(uint16_t conn_id){ return 23; }
+  void disconnect(uint16_t conn_id){}
+  void startAdvertising(){}
+  BLEServerCallbacks* callbacks = NULL;
+  BLEAdvertising advertising;
+};
+
+class BLESecurity {
+public:
+  void setAuthenticationMode(esp_ble_auth_req_t mode){}
+  void setCapability(int capability){}
+  void setInitEncryptionKey(uint8_t key){}
+  void setRespEncryptionKey(uint8_t key){}
+};
+
+class BLEDevice {
+public:
+  static void init(std::string name){}
+  static BLEServer* createServer(){ return new BLEServer(); }
+  static BLEAdvertising* getAdvertising(){ static BLEAdvertising advertising; return &advertising; }
+  static void startAdvertising(){}
+  static void setMTU(uint16_t mtu){}
+  static uint16_t getMTU(){ return 23; }
+  static void setCustomGattsHandler(void (*handler)(esp_gatts_cb_event_t, esp_gatt_if_t, esp_ble_gatts_cb_param_t*)){}
+  static void setCustomGapHandler(void (*handler)(esp_gap_ble_cb_event_t, esp_ble_gap_cb_param_t*)){}
+  static void deinit(bool release = false){}
+};
+
+class BLEHIDDevice {
+public:
+  BLEHIDDevice(BLEServer* server){}
+  BLECharacteristic* inputReport(uint8_t id){ return this->report('I', id); }
+  BLECharacteristic* outputReport(uint8_t id){ return this->report('O', id); }
+  BLECharacteristic* featureReport(uint8_t id){ return this->report('F', id); }
+  BLECharacteristic* manufacturer(){ return &this->other; }
+  void manufacturer(std::string name){}
+  void pnp(uint8_t sig, uint16_t vid, uint16_t pid, uint16_t version){}
+  void hidInfo(uint8_t country, uint8_t flags){}
+  void reportMap(uint8_t* map, uint16_t size){}
+  void startServices(){}
+  void setBatteryLevel(uint8_t level){}
+  BLEService* hidService(){ return &this->service; }
+  BLEService* deviceInfo(){ return &this->service; }
+  BLEService* batteryService(){ return &this->service; }
+  BLECharacteristic* hidControl(){ return &this->other; }
+  BLECharacteristic* protocolMode(){ return &this->other; }
+private:
+  BLECharacteristic* report(char kind, uint8_t id){
+    BLECharacteristic* characteristic = new BLECharacteristic(BLEUUID((uint16_t)0x2a4d));
+    characteristic->kind = kind;
+    characteristic->reportId = id;
+    if (kind == 'I'){
+      characteristic->addDescriptor(new BLE2902());
+    }
+    replay_characteristics().push_back(characteristic);
+    return characteristic;
+  }
+  BLEService service;
+  BLECharacteristic other = BLECharacteristic(BLEUUID());
+};
+
+#define HID_KEYBOARD 0x03C1
+
+#endif // REPLAY_SHIM_H
@@ -0,0 +1 @@
+#include "../replay_shim.h"
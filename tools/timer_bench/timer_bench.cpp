@@ -0,0 +1,214 @@
+// Host check of the timer wheel and the 64-bit time base. First the wheel on its own: timers
+// fire at their deadline and not before, cancel and reschedule, deadlines more than a turn of
+// the wheel out, a clock jump that runs everything overdue at once, and the cost of schedule()
+// and cancel() with few and with many timers pending. Then InputPipeline's vibration and long
+// press run on the faked esp_timer clock across each point where a narrower clock wraps: millis()
+// passing INT32_MAX and UINT32_MAX, and micros() passing UINT32_MAX. One JSON line per check.
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#include "LoopbackHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "MonotonicClock.h"
+#include "matrix.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define DIAL_KEY 11 //KEY_DIAL in the default keymap
+#define MANY_TIMERS 10000
+
+static void report(const char* check, bool ok){
+  checkLine(ok, "\"check\":\"%s\"", check);
+}
+
+// Counts firings and keeps the times they fired at; every period ms it schedules itself again
+class Recorder : public TimerCallbacks {
+public:
+  Recorder(TimerWheel* wheel, uint32_t period = 0) : wheel(wheel), period(period) {}
+  void onTimer(WheelTimer* timer, uint64_t now){
+    this->fired.push_back(now);
+    if (this->period != 0){
+      this->wheel->after(timer, this->period);
+    }
+  }
+  TimerWheel* wheel;
+  uint32_t period;
+  std::vector<uint64_t> fired;
+};
+
+class FakeHaptics : public HapticBackend {
+public:
+  void vibrate(bool on){
+    this->on = on;
+    if (on) this->starts++;
+  }
+  bool on = false;
+  int starts = 0;
+};
+
+static void runWheel(){
+  TimerWheel wheel;
+  Recorder recorder(&wheel);
+  wheel.start(1000);
+  WheelTimer a(&recorder);
+  WheelTimer b(&recorder);
+  WheelTimer c(&recorder);
+  wheel.schedule(&a, 1010);
+  wheel.schedule(&b, 1010 + TIMER_WHEEL_SLOTS * 3); // Same slot, three turns later
+  wheel.schedule(&c, 1020);
+  wheel.advance(1009);
+  bool early = recorder.fired.empty() && wheel.pending() == 3;
+  wheel.advance(1010);
+  bool onTime = recorder.fired.size() == 1 && recorder.fired[0] == 1010 && !a.pending() && b.pending();
+  wheel.cancel(&c);
+  wheel.schedule(&a, 1015);
+  wheel.schedule(&a, 1030); // Moves it
+  wheel.advance(1029);
+  bool moved = recorder.fired.size() == 1 && wheel.pending() == 2;
+  wheel.advance(1030);
+  bool rounds = recorder.fired.size() == 2;
+  for (uint64_t t = 1031; t < 1010 + TIMER_WHEEL_SLOTS * 3; t++){
+    wheel.advance(t);
+  }
+  rounds = rounds && recorder.fired.size() == 2;
+  wheel.advance(1010 + TIMER_WHEEL_SLOTS * 3);
+  rounds = rounds && recorder.fired.size() == 3 && wheel.pending() == 0;
+  report("fires_at_deadline", early && onTime);
+  report("cancel_and_reschedule", moved && !c.pending());
+  report("deadlines_past_one_turn", rounds);
+
+  // A timer scheduled for now or earlier runs on the next advance(), even at the same time
+  wheel.schedule(&a, 100);
+  wheel.advance(wheel.now());
+  report("overdue_runs_next_advance", recorder.fired.size() == 4 && recorder.fired[3] == wheel.now());
+
+  // An hour with nothing advancing the wheel: each timer due fires once, the periodic one
+  // once rather than for every period it missed, and the rest stay put
+  Recorder periodic(&wheel, 10);
+  WheelTimer tick(&periodic);
+  wheel.after(&tick, 10);
+  uint64_t from = wheel.now();
+  std::vector<WheelTimer*> spread;
+  for (int i = 0; i < 1000; i++){
+    WheelTimer* timer = new WheelTimer(&recorder);
+    wheel.schedule(timer, from + 1 + i * 7);
+    spread.push_back(timer);
+  }
+  WheelTimer later(&recorder);
+  wheel.schedule(&later, from + 3600000 + 1);
+  size_t before = recorder.fired.size();
+  wheel.advance(from + 3600000);
+  bool jumped = recorder.fired.size() - before == 1000 && periodic.fired.size() == 1 && later.pending() &&
+                tick.deadline() == from + 3600000 + 10;
+  report("jump_runs_overdue_once", jumped);
+  for (WheelTimer* timer : spread) delete timer;
+}
+
+static double scheduleCancelNs(TimerWheel* wheel, int pending){
+  Recorder recorder(wheel);
+  std::vector<WheelTimer> timers(pending, WheelTimer(&recorder));
+  for (int i = 0; i < pending; i++){
+    wheel->after(&timers[i], 1 + i % 5000);
+  }
+  WheelTimer probe(&recorder);
+  const int rounds = 1000000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++){
+    wheel->after(&probe, 1 + i % 5000);
+    wheel->cancel(&probe);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  for (WheelTimer& timer : timers) wheel->cancel(&timer);
+  return elapsed.count() / rounds;
+}
+
+static void runCost(){
+  TimerWheel wheel;
+  double few = scheduleCancelNs(&wheel, 1);
+  double many = scheduleCancelNs(&wheel, MANY_TIMERS);
+  printf("{\"check\":\"cost\",\"pending\":[1,%d],\"schedule_cancel_ns\":[%.1f,%.1f]}\n", MANY_TIMERS, few, many);
+}
+
+// Runs the wheel from the faked esp_timer clock, the way the HID task does
+static void runUntil(TimerWheel* wheel, uint64_t ms){
+  while (monotonicMs() < ms){
+    replay_clock_us += 1000;
+    wheel->advance(monotonicMs());
+  }
+}
+
+// A detent's vibration and a long press on the dial button, starting 50 ms before the wrap;
+// then the clock moves on 24.8 days with no input, where comparing 32-bit times goes wrong
+static void runWrap(const char* name, uint64_t wrapMs){
+  FILE* sink = fopen("/dev/null", "w");
+  LoopbackHidTransport transport(sink);
+  BleKeyboard keyboard(&transport, "Bench", "Bench", 100);
+  keyboard.begin();
+  transport.connect(true, BLE_DEFAULT_INTERVAL_US);
+  keyboard.dial_vibrate = 1;
+  keyboard.dial_interval = 1;
+  TimerWheel wheel;
+  FakeHaptics haptics;
+  InputPipeline pipeline(&keyboard, &wheel, &haptics);
+  uint32_t strength = (uint32_t)pipeline.vibe_strength;
+
+  uint64_t start = wrapMs - 50;
+  replay_clock_us = start * 1000;
+  wheel.start(monotonicMs());
+  pipeline.dial(1, (uint32_t)monotonicMs());
+  bool started = haptics.on;
+  runUntil(&wheel, start + strength - 1);
+  bool held = haptics.on;
+  runUntil(&wheel, start + strength);
+  bool stopped = !haptics.on && !pipeline.vibrating();
+
+  uint64_t pressed = monotonicMs();
+  pipeline.key(DIAL_KEY, KEY_PRESS_EVENT, (uint32_t)pressed);
+  runUntil(&wheel, pressed + DIAL_LONGPRESS_DELAY - 1);
+  bool notYet = haptics.starts == 1;
+  runUntil(&wheel, pressed + DIAL_LONGPRESS_DELAY);
+  bool longPress = haptics.starts == 2 && haptics.on;
+  pipeline.key(DIAL_KEY, KEY_UNPRESS_EVENT, (uint32_t)monotonicMs());
+  runUntil(&wheel, pressed + DIAL_LONGPRESS_DELAY + strength);
+  bool quiet = !haptics.on && wheel.pending() == 0;
+
+  // The old check, (int32_t)(vibe_until - now) > 0 on millis(), turns back on half a wrap later
+  uint32_t vibeUntil = (uint32_t)(pressed + DIAL_LONGPRESS_DELAY + strength);
+  replay_clock_us += ((uint64_t)INT32_MAX + 1000) * 1000;
+  wheel.advance(monotonicMs());
+  bool oldCheck = (int32_t)(vibeUntil - (uint32_t)monotonicMs()) > 0;
+  bool staysOff = !haptics.on && haptics.starts == 2;
+
+  bool ok = started && held && stopped && notYet && longPress && quiet && staysOff;
+  checkLine(ok, "\"check\":\"wrap\",\"at\":\"%s\",\"start_ms\":%llu,\"vibration_ms\":%u,\"long_press\":%s,"
+            "\"old_check_vibrates_later\":%s,\"stays_off\":%s",
+            name, (unsigned long long)start, strength, jsonBool(notYet && longPress), jsonBool(oldCheck), jsonBool(staysOff));
+  fclose(sink);
+}
+
+static void runWiden(){
+  uint64_t wrap = (uint64_t)1 << 32;
+  bool ok = widenMs((uint32_t)(wrap + 5), wrap - 5) == wrap + 5 &&
+            widenMs((uint32_t)(wrap - 5), wrap + 5) == wrap - 5 &&
+            widenMs(7, 3) == 7 &&
+            widenMs((uint32_t)(3 * wrap + 100), 3 * wrap + 100) == 3 * wrap + 100;
+  report("widen_across_wrap", ok);
+}
+
+int main(int argc, char** argv){
+  runWheel();
+  runCost();
+  runWiden();
+  runWrap("boot", 50);
+  runWrap("micros_wrap", ((uint64_t)1 << 32) / 1000);
+  runWrap("millis_int32_max", (uint64_t)INT32_MAX + 1);
+  runWrap("millis_wrap", (uint64_t)1 << 32);
+  return checkStatus();
+}
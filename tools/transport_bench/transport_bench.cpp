@@ -0,0 +1,237 @@
+// Host check that BleKeyboard sends the same reports whatever HidTransport it sits on. One
+// scripted session (typing, key presses, dial spins, the host writing the LED output report and
+// both feature reports, a disconnect and reconnect) runs once on BluedroidHidTransport over the
+// replay shim and once on LoopbackHidTransport, and the two report streams must match line for
+// line. Each transport then prints one JSON line with its size, the allocations its begin() makes
+// and the host time of one notify.
+//
+// NimbleHidTransport needs the NimBLE host and can't run here; its RAM and flash are in the size
+// summary of `pio run -e nimble`, and its notify time in the sketch's "notify us" line on serial.
+// The host notify times only compare the transport layers, not the stacks behind them.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <chrono>
+
+#include "BluedroidHidTransport.h"
+#include "LoopbackHidTransport.h"
+#include "InputPipeline.h"
+#include "TimerWheel.h"
+#include "matrix.h"
+#include "keymap.h"
+#include "counting_new.h"
+#include "check.h"
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+#define SESSION_MS 600000
+#define STEP_MS 10
+#define KEY_EVERY_MS 700
+#define KEY_HOLD_MS 90
+#define DIAL_EVERY_MS 3000
+#define DIAL_STEPS 9
+#define TYPE_EVERY_MS 120000
+#define LED_EVERY_MS 45000
+#define FEATURE_EVERY_MS 200000
+#define RECONNECT_AT_MS 300000
+#define RECONNECT_GAP_MS 2000
+#define NOTIFY_RUNS 1000000
+
+// The host side of one transport
+class Host {
+public:
+  virtual ~Host() {}
+  virtual HidTransport* transport() = 0;
+  virtual void connect() = 0;
+  virtual void disconnect() = 0;
+  virtual void write(uint8_t id, HidReportType type, const void* data, size_t len) = 0;
+  virtual std::string reports() = 0;
+};
+
+static std::string bluedroidReports;
+
+// The same line format LoopbackHidTransport writes
+static bool recordNotify(BLECharacteristic* characteristic){
+  char line[32];
+  snprintf(line, sizeof(line), "%llu %c%u", (unsigned long long)replay_clock_us, characteristic->kind, characteristic->reportId);
+  bluedroidReports += line;
+  for (size_t i = 0; i < characteristic->value.size(); i++){
+    snprintf(line, sizeof(line), i == 0 ? " %02x" : "%02x", (uint8_t)characteristic->value[i]);
+    bluedroidReports += line;
+  }
+  bluedroidReports += "\n";
+  return true;
+}
+
+static bool acceptNotify(BLECharacteristic* characteristic){
+  return true;
+}
+
+class BluedroidHost : public Host {
+public:
+  HidTransport* transport() { return &this->stack; }
+  void connect(){
+    esp_ble_gatts_cb_param_t param = {};
+    param.connect.conn_params.interval = 12;
+    this->stack.server()->callbacks->onConnect(this->stack.server());
+    this->stack.server()->callbacks->onConnect(this->stack.server(), &param);
+  }
+  void disconnect(){
+    this->stack.server()->callbacks->onDisconnect(this->stack.server());
+  }
+  // The stack stores what the host wrote, then calls the characteristic's callbacks
+  void write(uint8_t id, HidReportType type, const void* data, size_t len){
+    char kind = type == HID_OUTPUT_REPORT ? 'O' : 'F';
+    for (BLECharacteristic* characteristic : replay_characteristics()){
+      if (characteristic->kind == kind && characteristic->reportId == id){
+        characteristic->value.assign((const char*)data, len);
+        characteristic->callbacks->onWrite(characteristic);
+      }
+    }
+  }
+  std::string reports() { return bluedroidReports; }
+  BluedroidHidTransport stack;
+};
+
+class LoopbackHost : public Host {
+public:
+  LoopbackHost() : out(open_memstream(&this->buffer, &this->size)), stack(this->out) {}
+  ~LoopbackHost() { fclose(this->out); free(this->buffer); }
+  HidTransport* transport() { return &this->stack; }
+  void connect() { this->stack.connect(true, 12 * 1250); }
+  void disconnect() { this->stack.disconnect(); }
+  void write(uint8_t id, HidReportType type, const void* data, size_t len){
+    this->stack.write(this->stack.find(id, type), (const uint8_t*)data, len);
+  }
+  // Reports only; the # lines are the loopback host's own events
+  std::string reports(){
+    fflush(this->out);
+    std::string all(this->buffer, this->size), lines;
+    size_t at = 0;
+    while (at < all.size()){
+      size_t end = all.find('\n', at);
+      end = end == std::string::npos ? all.size() : end + 1;
+      if (all[at] != '#') lines.append(all, at, end - at);
+      at = end;
+    }
+    return lines;
+  }
+  char* buffer = NULL;
+  size_t size = 0;
+  FILE* out;
+  LoopbackHidTransport stack;
+};
+
+struct Result {
+  std::string reports;
+  uint64_t beginAllocations;
+};
+
+static Result session(Host* host){
+  Result result;
+  replay_clock_us = 0;
+  BleKeyboard* keyboard = new BleKeyboard(host->transport(), "Bench", "Bench", 100);
+  uint64_t before = replay_allocations;
+  keyboard->begin();
+  result.beginAllocations = replay_allocations - before;
+  TimerWheel* timers = new TimerWheel();
+  InputPipeline* pipeline = new InputPipeline(keyboard, timers);
+  host->connect();
+
+  int key = 0;
+  for (uint64_t ms = 0; ms < SESSION_MS; ms += STEP_MS){
+    replay_clock_us = ms * 1000;
+    uint32_t now = (uint32_t)ms;
+    if (ms % KEY_EVERY_MS == 0){
+      pipeline->key(key, KEY_PRESS_EVENT, now);
+    } else if (ms % KEY_EVERY_MS == KEY_HOLD_MS){
+      pipeline->key(key, KEY_UNPRESS_EVENT, now);
+      key = (key + 1) % (KEYMAP_SIZE - 1); // The last key is the dial button
+    }
+    if (ms % DIAL_EVERY_MS == 0){
+      for (int i = 0; i < DIAL_STEPS; i++){
+        pipeline->dial(ms % (2 * DIAL_EVERY_MS) == 0 ? 1 : -1, now);
+      }
+    }
+    if (ms % TYPE_EVERY_MS == TYPE_EVERY_MS / 2){
+      keyboard->print("Layer 2, 50% Opacity!");
+    }
+    if (ms % LED_EVERY_MS == 0){
+      uint8_t leds = (ms / LED_EVERY_MS) & 0x07;
+      host->write(KEYBOARD_ID, HID_OUTPUT_REPORT, &leds, 1);
+    }
+    if (ms % FEATURE_EVERY_MS == FEATURE_EVERY_MS / 2){
+      RadialFeatureReport feature = {};
+      feature.vibration_amount = (ms / FEATURE_EVERY_MS) % 2 ? 25 : 100;
+      feature.enabled = 1;
+      host->write(RADIAL_ID, HID_FEATURE_REPORT, &feature, sizeof(feature));
+      WheelFeatureReport wheel = {};
+      wheel.wheel_multiplier = (ms / FEATURE_EVERY_MS) % 2;
+      host->write(WHEEL_ID, HID_FEATURE_REPORT, &wheel, sizeof(wheel));
+    }
+    if (ms == RECONNECT_AT_MS){
+      host->disconnect();
+    } else if (ms == RECONNECT_AT_MS + RECONNECT_GAP_MS){
+      host->connect();
+    }
+    timers->advance(ms);
+    keyboard->update();
+  }
+  result.reports = host->reports();
+  delete pipeline;
+  delete timers;
+  delete keyboard;
+  return result;
+}
+
+// Handles are handed out in the order BleKeyboard adds its reports, the same on every transport
+static double notifyNs(HidTransport* transport, uint8_t handle){
+  uint8_t report[8] = {0, 0, 0x04};
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NOTIFY_RUNS; i++){
+    report[7] = i;
+    transport->notify(handle, report, sizeof(report));
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / NOTIFY_RUNS;
+}
+
+static size_t countLines(const std::string& s){
+  size_t n = 0;
+  for (char c : s) n += c == '\n';
+  return n;
+}
+
+static void printTransport(const char* name, size_t size, const Result& result, double ns){
+  printf("{\"transport\":\"%s\",\"sizeof\":%zu,\"begin_allocations\":%llu,\"reports\":%zu,\"host_ns_per_notify\":%.1f}\n",
+         name, size, (unsigned long long)result.beginAllocations, countLines(result.reports), ns);
+}
+
+int main(int argc, char** argv){
+  replay_notify = recordNotify;
+  BluedroidHost* bluedroid = new BluedroidHost();
+  Result bluedroidResult = session(bluedroid);
+  LoopbackHost* loopback = new LoopbackHost();
+  Result loopbackResult = session(loopback);
+
+  uint8_t handle = loopback->stack.find(KEYBOARD_ID, HID_INPUT_REPORT);
+  replay_notify = acceptNotify;
+  double bluedroidNs = notifyNs(bluedroid->transport(), handle);
+  FILE* null = fopen("/dev/null", "w");
+  LoopbackHidTransport* sink = new LoopbackHidTransport(null);
+  BleConnectionStatus status;
+  HidDeviceInfo info = {"Bench", "Bench", NULL, 0, 0, 0, 0, 100};
+  sink->begin(info, &status);
+  for (uint8_t i = 0; i <= handle; i++) sink->addReport(KEYBOARD_ID, HID_INPUT_REPORT);
+  double loopbackNs = notifyNs(sink, handle);
+  fclose(null);
+
+  printTransport("bluedroid", sizeof(BluedroidHidTransport), bluedroidResult, bluedroidNs);
+  printTransport("loopback", sizeof(LoopbackHidTransport), loopbackResult, loopbackNs);
+  bool same = !bluedroidResult.reports.empty() && bluedroidResult.reports == loopbackResult.reports;
+  checkLine(same, "\"reports_match\":%s", jsonBool(same));
+  return checkStatus();
+}
@@ -0,0 +1,303 @@
+// Host benchmark for BleKeyboard::write. Runs the firmware's typing path against a simulated
+// link and reports characters per second on the simulated clock, reports per character, and
+// the host CPU cost of building the reports. The report stream is decoded back into text the
+// way a host would, so a run that drops or merges a keystroke fails.
+//
+// Link model: the stack buffers up to LINK_BUFFER notifications and the radio sends up to
+// perEvent of them each connection interval; a notify into a full buffer is refused. A link
+// sending fewer per interval than the typing path queues exercises the retry path. With
+// congestion signalling on, the link also raises the stack's congestion event when its buffer
+// fills and clears it once it drains, as Bluedroid does.
+//
+// The key run presses and releases one key per millisecond through press() and release(), far
+// faster than a slow link carries, and checks every keystroke still reaches the host in order:
+// a full report queue makes the sender wait instead of overwriting a press or a release.
+//
+// The dial run sends a burst of single detents into a congested link and checks that the
+// rotation the host receives adds up, which exercises the report queue's coalescing. The wheel
+// run does the same in high-resolution wheel mode and also checks that no more than one wheel
+// report goes out per connection interval; a second wheel run spins faster than a report holds
+// while keys compete for the link, and checks no notch is lost. The switch run checks that a
+// resolution or output change keeps what the wheel carries.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <chrono>
+
+#include "BleKeyboard.h"
+#include "BluedroidHidTransport.h"
+#include "check.h"
+
+#define LINK_BUFFER 10
+
+uint64_t replay_clock_us = 0;
+bool (*replay_notify)(BLECharacteristic* characteristic) = NULL;
+void (*replay_tick)(void) = NULL;
+HardwareSerial Serial;
+
+extern const uint8_t _asciimap[128];
+
+static const char* SAMPLE =
+  "The quick brown fox jumps over the lazy dog. Mississippi, 1100 balloons & 22 APPLES!\n"
+  "Shift runs: HELLO WORLD, double letters: aabbccdd, symbols: {}[]()<>?!@#$%^&*_+|~\n";
+
+static uint32_t intervalUs;
+static int perEvent;
+static uint64_t drainedAt;
+static int queued;
+static unsigned long reports, refused;
+static bool signalCongestion, congested;
+static KeyReport last;
+static std::string decoded;
+static long rotation;
+static long wheel;
+static unsigned long wheelReports;
+
+static void congest(bool on){
+  esp_ble_gatts_cb_param_t param = {};
+  param.congest.congested = on;
+  congested = on;
+  BluedroidHidTransport::handleGatts(ESP_GATTS_CONGEST_EVT, 0, &param);
+}
+
+static void drain(){
+  uint64_t events = (replay_clock_us - drainedAt) / intervalUs;
+  if (events > 0){
+    queued -= events * perEvent < (uint64_t)queued ? events * perEvent : queued;
+    drainedAt += events * intervalUs;
+  }
+}
+
+static void tick(){
+  drain();
+  if (congested && queued < LINK_BUFFER){
+    congest(false);
+  }
+}
+
+// A key that is in this report but not the previous one is a keystroke
+static void decode(const KeyReport* report){
+  for (int i = 0; i < 6; i++){
+    uint8_t k = report->keys[i];
+    bool held = false;
+    for (int j = 0; j < 6; j++){
+      held = held || (k != 0 && last.keys[j] == k);
+    }
+    if (k == 0 || held) continue;
+    uint8_t want = k | ((report->modifiers & 0x02) ? 0x80 : 0);
+    for (int c = 0; c < 128; c++){
+      if (_asciimap[c] == want){
+        decoded += (char)c;
+        break;
+      }
+    }
+  }
+  last = *report;
+}
+
+static bool linkNotify(BLECharacteristic* characteristic){
+  drain();
+  if (queued >= LINK_BUFFER){
+    refused++;
+    return false;
+  }
+  queued++;
+  reports++;
+  if (characteristic->reportId == KEYBOARD_ID && characteristic->kind == 'I'){
+    decode((const KeyReport*)characteristic->getData());
+  }
+  if (characteristic->reportId == RADIAL_ID && characteristic->kind == 'I'){
+    rotation += (int16_t)((const RadialReport*)characteristic->getData())->rotation;
+  }
+  if (characteristic->reportId == WHEEL_ID && characteristic->kind == 'I'){
+    wheel += ((const WheelReport*)characteristic->getData())->wheel;
+    wheelReports++;
+  }
+  if (signalCongestion && queued >= LINK_BUFFER){
+    congest(true);
+  }
+  return true;
+}
+
+static BleKeyboard* connect(uint16_t interval){
+  BluedroidHidTransport* transport = new BluedroidHidTransport();
+  BleKeyboard* keyboard = new BleKeyboard(transport, "Bench", "Bench", 100);
+  keyboard->begin();
+  esp_ble_gatts_cb_param_t param = {};
+  param.connect.conn_params.interval = interval;
+  transport->server()->callbacks->onConnect(transport->server());
+  transport->server()->callbacks->onConnect(transport->server(), &param);
+  return keyboard;
+}
+
+static BleKeyboard* start(uint16_t interval, int linkPerEvent, bool signal){
+  BleKeyboard* keyboard = connect(interval);
+  intervalUs = interval * 1250;
+  perEvent = linkPerEvent;
+  signalCongestion = signal;
+  congested = false;
+  replay_clock_us = 0;
+  drainedAt = 0;
+  queued = 0;
+  reports = refused = 0;
+  last = KeyReport();
+  decoded.clear();
+  rotation = 0;
+  wheel = 0;
+  wheelReports = 0;
+  replay_notify = linkNotify;
+  replay_tick = tick;
+  return keyboard;
+}
+
+// Lets the main loop pump whatever is still queued
+static void flush(BleKeyboard* keyboard){
+  for (int i = 0; i < 1000 && keyboard->queueStats().depth > 0; i++){
+    delay(1);
+    keyboard->update();
+  }
+}
+
+static void stop(){
+  replay_notify = NULL;
+  replay_tick = NULL;
+  congest(false);
+}
+
+static std::string queueFields(const HidQueueStats& stats){
+  char fields[192];
+  snprintf(fields, sizeof(fields), "\"queue_max_depth\":%u,\"queue_merged\":%u,\"queue_stalled\":%u,\"queue_dropped\":%u,"
+           "\"queue_retried\":%u,\"queue_congested\":%u", stats.maxDepth, stats.merged, stats.stalled, stats.dropped,
+           stats.retried, stats.congested);
+  return fields;
+}
+
+static void run(uint16_t interval, int linkPerEvent, bool signal, const std::string& text){
+  BleKeyboard* keyboard = start(interval, linkPerEvent, signal);
+
+  auto started = std::chrono::steady_clock::now();
+  size_t typed = keyboard->write((const uint8_t*)text.data(), text.size());
+  double cpuNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+  flush(keyboard);
+  // Time until the last report is on air
+  uint64_t elapsedUs = replay_clock_us + (queued + perEvent - 1) / perEvent * intervalUs;
+
+  bool ok = typed == text.size() && decoded == text;
+  if (!ok){
+    size_t at = 0;
+    while (at < decoded.size() && decoded[at] == text[at]) at++;
+    fprintf(stderr, "typed %zu of %zu, host saw a different character at %zu\n", typed, text.size(), at);
+  }
+  checkLine(ok, "\"interval_ms\":%.2f,\"link_per_event\":%d,\"congestion_signal\":%s,\"chars\":%zu,\"reports\":%lu,"
+            "\"reports_per_char\":%.3f,\"refused\":%lu,%s,\"chars_per_s\":%.1f,\"press_release_per_char_chars_per_s\":%.1f,"
+            "\"cpu_ns_per_char\":%.1f",
+            intervalUs / 1000.0, perEvent, jsonBool(signal), text.size(), reports, (double)reports / text.size(), refused,
+            queueFields(keyboard->queueStats()).c_str(), text.size() * 1e6 / elapsedUs, perEvent * 1e6 / intervalUs / 2,
+            cpuNs / text.size());
+  stop();
+}
+
+static void keyRun(uint16_t interval, int linkPerEvent, const std::string& text){
+  BleKeyboard* keyboard = start(interval, linkPerEvent, true);
+  for (size_t i = 0; i < text.size(); i++){
+    keyboard->press(text[i]);
+    keyboard->release(text[i]);
+    delay(1);
+    keyboard->update();
+  }
+  flush(keyboard);
+  bool ok = decoded == text;
+  checkLine(ok, "\"key_interval_ms\":%.2f,\"link_per_event\":%d,\"keystrokes\":%zu,\"decoded\":%zu,\"reports\":%lu,%s",
+            intervalUs / 1000.0, perEvent, text.size(), decoded.size(), reports, queueFields(keyboard->queueStats()).c_str());
+  stop();
+}
+
+// A fast spin: one detent per millisecond, far more reports than the link carries
+static void dialRun(uint16_t interval, int linkPerEvent, int detents){
+  BleKeyboard* keyboard = start(interval, linkPerEvent, true);
+  for (int i = 0; i < detents; i++){
+    keyboard->rotate(1);
+    delay(1);
+    keyboard->update();
+  }
+  flush(keyboard);
+  bool ok = rotation == detents;
+  checkLine(ok, "\"dial_interval_ms\":%.2f,\"link_per_event\":%d,\"detents\":%d,\"rotation_received\":%ld,\"reports\":%lu,%s",
+            intervalUs / 1000.0, perEvent, detents, rotation, reports, queueFields(keyboard->queueStats()).c_str());
+  stop();
+}
+
+// With typing, key reports compete for the link, so a wheel report can still be waiting when
+// the next interval's notches are due
+static void wheelRun(uint16_t interval, int linkPerEvent, bool signal, int detents, int stepsPerMs, bool typing){
+  BleKeyboard* keyboard = start(interval, linkPerEvent, signal);
+  WheelFeatureReport feature = {};
+  feature.wheel_multiplier = 1;
+  keyboard->applyWheelFeatureReport(&feature);
+  keyboard->setDialOutput(DIAL_OUTPUT_WHEEL);
+  for (int i = 0; i < detents; i++){
+    keyboard->rotate(-stepsPerMs);
+    if (typing){
+      keyboard->press('a');
+      keyboard->release('a');
+    }
+    delay(1);
+    keyboard->update();
+  }
+  flush(keyboard);
+  for (int i = 0; i < interval * 40 || keyboard->queueStats().depth > 0; i++){
+    delay(1);
+    keyboard->update();
+  }
+  long expected = (long)detents * stepsPerMs * WHEEL_RESOLUTION / WHEEL_STEPS_PER_NOTCH;
+  unsigned long maxReports = replay_clock_us / intervalUs + 1;
+  bool ok = wheel == expected && wheelReports <= maxReports;
+  checkLine(ok, "\"wheel_interval_ms\":%.2f,\"link_per_event\":%d,\"typing\":%s,\"steps\":%d,\"wheel_units\":%ld,"
+            "\"expected_units\":%ld,\"reports\":%lu,\"max_reports\":%lu",
+            intervalUs / 1000.0, perEvent, jsonBool(typing), detents * stepsPerMs, wheel, expected, wheelReports, maxReports);
+  stop();
+}
+
+// What the wheel carries survives the host switching resolution and the user switching output:
+// half a notch at low resolution is half a notch at high, and whole notches still carried go out
+// before the dial leaves the wheel
+static void switchRun(){
+  BleKeyboard* keyboard = start(12, 4, false);
+  keyboard->setDialOutput(DIAL_OUTPUT_WHEEL);
+  keyboard->rotate(-WHEEL_STEPS_PER_NOTCH / 2);
+  WheelFeatureReport feature = {};
+  feature.wheel_multiplier = 1;
+  keyboard->applyWheelFeatureReport(&feature);
+  for (int i = 0; i < 100; i++){
+    delay(1);
+    keyboard->update();
+  }
+  long rescaled = wheel;
+  keyboard->rotate(-WHEEL_STEPS_PER_NOTCH * 3);
+  keyboard->setDialOutput(DIAL_OUTPUT_RADIAL);
+  flush(keyboard);
+  long switched = wheel - rescaled;
+  bool ok = rescaled == WHEEL_RESOLUTION / 2 && switched == 3 * WHEEL_RESOLUTION;
+  checkLine(ok, "\"rescaled_units\":%ld,\"expected_rescaled\":%d,\"flushed_units\":%ld,\"expected_flushed\":%d",
+            rescaled, WHEEL_RESOLUTION / 2, switched, 3 * WHEEL_RESOLUTION);
+  stop();
+}
+
+int main(int argc, char** argv){
+  std::string text;
+  int repeat = argc > 1 ? atoi(argv[1]) : 20;
+  for (int i = 0; i < repeat; i++){
+    text += SAMPLE;
+  }
+  run(6, 4, false, text);  // 7.5 ms
+  run(12, 4, false, text); // 15 ms
+  run(24, 4, false, text); // 30 ms
+  run(12, 2, false, text); // 15 ms, refusing
+  run(12, 2, true, text);  // 15 ms, congestion events
+  keyRun(12, 1, SAMPLE);
+  dialRun(12, 2, 500);
+  wheelRun(12, 4, true, 501, 1, false);
+  wheelRun(12, 2, true, 501, 8, true); // Full wheel reports behind key reports
+  switchRun();
+  return checkStatus();
+}